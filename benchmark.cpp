@@ -2,7 +2,12 @@
 #include <fstream>
 #include <sstream>
 #include <cstdlib>
+#include <clocale>
 #include <ctime>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <new>
 #if defined(_WIN32)
     #if !defined(NOMINMAX)
         #define NOMINMAX
@@ -12,6 +17,68 @@
     #include <mach/mach_time.h>
 #endif
 #include "evaluator/evaluator.h"
+#include "evaluator/evaluator_xyz.h"
+
+// Counter of allocations, see alloc_test()
+static std::size_t allocations_num = 0;
+
+// Replaced operator new uses malloc(), GCC doesn't see that after inlining
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+    #pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+#if __cplusplus < 201103L
+void * operator new(std::size_t size) throw(std::bad_alloc)
+#else
+void * operator new(std::size_t size)
+#endif
+{
+    allocations_num++;
+    void * ptr = std::malloc(size ? size : 1);
+    if(!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+#if __cplusplus < 201103L
+void * operator new [] (std::size_t size) throw(std::bad_alloc)
+#else
+void * operator new [] (std::size_t size)
+#endif
+{
+    return operator new(size);
+}
+
+#if __cplusplus < 201103L
+void operator delete(void * ptr) throw()
+#else
+void operator delete(void * ptr) noexcept
+#endif
+{
+    std::free(ptr);
+}
+
+#if __cplusplus < 201103L
+void operator delete [] (void * ptr) throw()
+#else
+void operator delete [] (void * ptr) noexcept
+#endif
+{
+    std::free(ptr);
+}
+
+// Sized deallocation of C++14 is used instead of unsized one if it is not replaced too
+#if defined(__cpp_sized_deallocation)
+void operator delete(void * ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete [] (void * ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+#endif
 
 namespace {
 
@@ -46,7 +113,23 @@ unsigned long mtime();
 double rand_uniform(double a, double b);
 void types_test(teestream & tee);
 void self_test(teestream & tee);
+void literals_test(teestream & tee);
+void batch_test(teestream & tee);
+void reorder_test(teestream & tee);
+void canonical_test(teestream & tee);
+void cse_test(teestream & tee);
+void strength_test(teestream & tee);
+void arena_test(teestream & tee);
+void reentrant_test(teestream & tee);
+void handles_test(teestream & tee);
+void objects_test(teestream & tee);
+void alloc_test(teestream & tee);
+void kernels_test(teestream & tee);
+void dispatch_test(std::size_t num_tests, teestream & tee);
+void parse_test(std::size_t num_tests, teestream & tee);
 void benchmark1(std::size_t num_tests, teestream & tee);
+void benchmark_strength(std::size_t num_tests, teestream & tee);
+void benchmark_kernels(std::size_t num_tests, teestream & tee);
 
 } // namespace
 
@@ -103,8 +186,40 @@ int main(int argc, char * argv[])
     types_test(tee);
     tee << "\n================================" << std::endl;
     self_test(tee);
+    tee << "\n================================" << std::endl;
+    literals_test(tee);
+    tee << "\n================================" << std::endl;
+    batch_test(tee);
+    tee << "\n================================" << std::endl;
+    reorder_test(tee);
+    tee << "\n================================" << std::endl;
+    canonical_test(tee);
+    tee << "\n================================" << std::endl;
+    cse_test(tee);
+    tee << "\n================================" << std::endl;
+    strength_test(tee);
+    tee << "\n================================" << std::endl;
+    arena_test(tee);
+    tee << "\n================================" << std::endl;
+    reentrant_test(tee);
+    tee << "\n================================" << std::endl;
+    handles_test(tee);
+    tee << "\n================================" << std::endl;
+    objects_test(tee);
+    tee << "\n================================" << std::endl;
+    alloc_test(tee);
+    tee << "\n================================" << std::endl;
+    kernels_test(tee);
+    tee  << "\n================================" << std::endl;
+    dispatch_test(num_tests, tee);
+    tee  << "\n================================" << std::endl;
+    parse_test(num_tests, tee);
     tee  << "\n================================" << std::endl;
     benchmark1(num_tests, tee);
+    tee  << "\n================================" << std::endl;
+    benchmark_strength(num_tests, tee);
+    tee  << "\n================================" << std::endl;
+    benchmark_kernels(num_tests, tee);
 
 #if defined(_WIN32)
     system("pause");
@@ -145,6 +260,24 @@ void get_all_exprs(std::vector<std::string> & exprs)
     exprs.push_back("sqrt(x) ");
 }
 
+// Time of 'num_tests' evaluations by calculate_batch() with blocks of 'block_size' points
+template<typename T>
+unsigned long benchmark_batch(evaluator<T> & p, std::size_t num_tests, const T & x, const T & y)
+{
+    const std::size_t block_size = 1000;
+    std::vector<T> xs(block_size, x), ys(block_size, y), rs(block_size);
+    std::map<std::string, const T *> bindings;
+    bindings["x"] = &xs[0];
+    bindings["y"] = &ys[0];
+    // Expression may have no 'y', unknown names are rejected by calculate_batch()
+    p.set_var("x", x);
+    p.set_var("y", y);
+    unsigned long t = mtime();
+    for(std::size_t k = 0; k < num_tests; k += block_size)
+        p.calculate_batch(std::min(block_size, num_tests - k), bindings, &rs[0]);
+    return mtime() - t;
+}
+
 void benchmark1(std::size_t num_tests, teestream & tee)
 {
     std::vector<std::string> exprs;
@@ -193,6 +326,33 @@ void benchmark1(std::size_t num_tests, teestream & tee)
         pcd.set_var("x", xcd);
         pcd.set_var("y", ycd);
 
+        tee << "--- Interpreter: ---" << std::endl;
+
+        for(std::size_t j = 0; j < 3; j++)
+        {
+            unsigned long t;
+            t = mtime();
+            for(std::size_t k = 0; k < num_tests; k++)
+                pf.calculate(rf);
+            t = mtime() - t;
+            tee << t << "\t";
+            t = mtime();
+            for(std::size_t k = 0; k < num_tests; k++)
+                pd.calculate(rd);
+            t = mtime() - t;
+            tee << t << "\t";
+            t = mtime();
+            for(std::size_t k = 0; k < num_tests; k++)
+                pcf.calculate(rcf);
+            t = mtime() - t;
+            tee << t << "\t";
+            t = mtime();
+            for(std::size_t k = 0; k < num_tests; k++)
+                pcd.calculate(rcd);
+            t = mtime() - t;
+            tee << t << std::endl;
+        }
+
         tee << "--- Extcall: ---" << std::endl;
 
         if(!pf.compile_extcall())  std::cout << pf.get_error() << std::endl;
@@ -257,10 +417,117 @@ void benchmark1(std::size_t num_tests, teestream & tee)
             tee << t << std::endl;
         }
 
+        tee << "--- SSE2: ---" << std::endl;
+
+        if(!pf.compile_sse2())  std::cout << pf.get_error() << std::endl;
+        if(!pd.compile_sse2())  std::cout << pd.get_error() << std::endl;
+
+        for(std::size_t j = 0; j < 3; j++)
+        {
+            unsigned long t;
+            t = mtime();
+            for(std::size_t k = 0; k < num_tests; k++)
+                pf.calculate(rf);
+            t = mtime() - t;
+            tee << t << "\t";
+            t = mtime();
+            for(std::size_t k = 0; k < num_tests; k++)
+                pd.calculate(rd);
+            t = mtime() - t;
+            tee << t << "\t-\t-" << std::endl;
+        }
+
+        tee << "--- Batch inline: ---" << std::endl;
+
+        if(!pf.compile_inline(true))  std::cout << pf.get_error() << std::endl;
+        if(!pd.compile_inline(true))  std::cout << pd.get_error() << std::endl;
+        if(!pcf.compile_inline(true)) std::cout << pcf.get_error() << std::endl;
+        if(!pcd.compile_inline(true)) std::cout << pcd.get_error() << std::endl;
+
+        for(std::size_t j = 0; j < 3; j++)
+        {
+            tee << benchmark_batch(pf, num_tests, xf, yf) << "\t";
+            tee << benchmark_batch(pd, num_tests, xd, yd) << "\t";
+            tee << benchmark_batch(pcf, num_tests, xcf, ycf) << "\t";
+            tee << benchmark_batch(pcd, num_tests, xcd, ycd) << std::endl;
+        }
+
+        tee << "--- Batch SSE2: ---" << std::endl;
+
+        if(!pf.compile_sse2(true))  std::cout << pf.get_error() << std::endl;
+        if(!pd.compile_sse2(true))  std::cout << pd.get_error() << std::endl;
+
+        for(std::size_t j = 0; j < 3; j++)
+        {
+            tee << benchmark_batch(pf, num_tests, xf, yf) << "\t";
+            tee << benchmark_batch(pd, num_tests, xd, yd) << "\t-\t-" << std::endl;
+        }
+
+        tee << "--- Batch SIMD: ---" << std::endl;
+
+        if(!pf.compile_simd())  std::cout << pf.get_error() << std::endl;
+        if(!pd.compile_simd())  std::cout << pd.get_error() << std::endl;
+
+        for(std::size_t j = 0; j < 3; j++)
+        {
+            tee << benchmark_batch(pf, num_tests, xf, yf) << "\t";
+            tee << benchmark_batch(pd, num_tests, xd, yd) << "\t-\t-" << std::endl;
+        }
+
         tee << "\n--------------------------------" << std::endl;
     }
 }
 
+// Time of 'num_tests' calculations of 'p' in milliseconds
+template<typename T>
+unsigned long benchmark_calculate(evaluator<T> & p, std::size_t num_tests)
+{
+    T r;
+    unsigned long t = mtime();
+    for(std::size_t k = 0; k < num_tests; k++)
+        p.calculate(r);
+    return mtime() - t;
+}
+
+// Times of formula 'expr' in milliseconds: parsed formula and formula after simplify()
+template<typename T>
+void benchmark_strength_row(const std::string & expr, std::size_t num_tests, teestream & tee)
+{
+    evaluator<T> p, q;
+    if(!p.parse(expr) || !q.parse(expr) || !q.simplify())
+        std::cout << q.get_error() << std::endl;
+    p.set_var("x", static_cast<T>(0.75));
+    p.set_var("y", static_cast<T>(0.25));
+    q.set_var("x", static_cast<T>(0.75));
+    q.set_var("y", static_cast<T>(0.25));
+    tee << expr << "\t" << evaluator_internal::get_type_name<T>() << "\t"
+        << benchmark_calculate(p, num_tests) << "\t" << benchmark_calculate(q, num_tests);
+#if !defined(EVALUATOR_JIT_DISABLE)
+    if(!p.compile_inline()) std::cout << p.get_error() << std::endl;
+    if(!q.compile_inline()) std::cout << q.get_error() << std::endl;
+    tee << "\t" << benchmark_calculate(p, num_tests) << "\t" << benchmark_calculate(q, num_tests);
+#endif
+    tee << std::endl;
+}
+
+void benchmark_strength(std::size_t num_tests, teestream & tee)
+{
+    std::vector<std::string> exprs;
+    exprs.push_back("x^2");
+    exprs.push_back("x^3");
+    exprs.push_back("x^8");
+    exprs.push_back("(x+y)^4");
+    exprs.push_back("x^(-1)");
+    exprs.push_back("x^(-2)");
+    exprs.push_back("x/4");
+
+    tee << "Strength-Reduction\ttype\tinterp\treduced\tinline\treduced" << std::endl;
+    for(std::size_t i = 0; i < exprs.size(); i++)
+        benchmark_strength_row<double>(exprs[i], num_tests, tee);
+    // Only complex x^0.5 becomes sqrt(x), see simplify()
+    benchmark_strength_row<std::complex<double> >("x^0.5", num_tests, tee);
+}
+
 void types_test(teestream & tee)
 {
     tee << "Type detection checks:" << std::endl;
@@ -323,8 +590,8 @@ void self_test(teestream & tee)
         if(!pcf.parse(exprs[i])) std::cerr << pcf.get_error() << std::endl;
         if(!pcd.parse(exprs[i])) std::cerr << pcd.get_error() << std::endl;
 
-        double xd, yd, rd, sumsd = 0, sumid = 0, sumed = 0;
-        float xf, yf, rf, sumsf = 0, sumif = 0, sumef = 0;
+        double xd, yd, rd, sumsd = 0, sumid = 0, sumed = 0, sumvd = 0, sumwd = 0;
+        float xf, yf, rf, sumsf = 0, sumif = 0, sumef = 0, sumvf = 0, sumwf = 0;
         std::complex<float> xcf, ycf, rcf, sumscf = 0, sumicf = 0, sumecf = 0;
         std::complex<double> xcd, ycd, rcd, sumscd = 0, sumicd = 0, sumecd = 0;
 
@@ -456,10 +723,73 @@ void self_test(teestream & tee)
             sumecf += rcf;
         }
 
+        if(!pf.compile_sse2())  std::cerr << pf.get_error() << std::endl;
+        if(!pd.compile_sse2())  std::cerr << pd.get_error() << std::endl;
+
+        srand(1);
+        for(std::size_t j = 0; j < num_tests; j++)
+        {
+            xd = rand_uniform(0, 1);
+            xf = static_cast<float>(xd);
+            yd = rand_uniform(0, 1);
+            yf = static_cast<float>(yd);
+
+            if(exprs[i] == "acosh(x)")
+            {
+                xd += 1.0;
+                xf += 1.0f;
+            }
+
+            pf.set_var("x", xf);
+            pf.set_var("y", yf);
+            pd.set_var("x", xd);
+            pd.set_var("y", yd);
+
+            pf.calculate(rf);
+            pd.calculate(rd);
+
+            sumvd += rd;
+            sumvf += rf;
+        }
+
+        // Vector code is not available on all CPUs, interpreter is used instead
+        if(!pf.compile_simd())  pf.parse(exprs[i]);
+        if(!pd.compile_simd())  pd.parse(exprs[i]);
+
+        srand(1);
+        for(std::size_t j = 0; j < num_tests; j++)
+        {
+            xd = rand_uniform(0, 1);
+            xf = static_cast<float>(xd);
+            yd = rand_uniform(0, 1);
+            yf = static_cast<float>(yd);
+
+            if(exprs[i] == "acosh(x)")
+            {
+                xd += 1.0;
+                xf += 1.0f;
+            }
+
+            pf.set_var("x", xf);
+            pf.set_var("y", yf);
+            pd.set_var("x", xd);
+            pd.set_var("y", yd);
+
+            pf.calculate(rf);
+            pd.calculate(rd);
+
+            sumwd += rd;
+            sumwf += rf;
+        }
+
         if(((std::abs((sumif - sumsf) / ((sumif + sumsf) / 2.0f)) < eps_f) ||
             (std::abs(sumif) < eps_f && std::abs(sumsf) < eps_f)) &&
            ((std::abs((sumef - sumsf) / ((sumef + sumsf) / 2.0f)) < eps_f) ||
-            (std::abs(sumef) < eps_f && std::abs(sumsf) < eps_f)))
+            (std::abs(sumef) < eps_f && std::abs(sumsf) < eps_f)) &&
+           ((std::abs((sumvf - sumsf) / ((sumvf + sumsf) / 2.0f)) < eps_f) ||
+            (std::abs(sumvf) < eps_f && std::abs(sumsf) < eps_f)) &&
+           ((std::abs((sumwf - sumsf) / ((sumwf + sumsf) / 2.0f)) < eps_f) ||
+            (std::abs(sumwf) < eps_f && std::abs(sumsf) < eps_f)))
         {
             tee << "OK\t";
         }
@@ -471,7 +801,11 @@ void self_test(teestream & tee)
         if(((std::abs((sumid - sumsd) / ((sumid + sumsd) / 2.0)) < eps_d) ||
             (std::abs(sumid) < eps_d && std::abs(sumsd) < eps_d)) &&
            ((std::abs((sumed - sumsd) / ((sumed + sumsd) / 2.0)) < eps_d) ||
-            (std::abs(sumed) < eps_d && std::abs(sumsd) < eps_d)))
+            (std::abs(sumed) < eps_d && std::abs(sumsd) < eps_d)) &&
+           ((std::abs((sumvd - sumsd) / ((sumvd + sumsd) / 2.0)) < eps_d) ||
+            (std::abs(sumvd) < eps_d && std::abs(sumsd) < eps_d)) &&
+           ((std::abs((sumwd - sumsd) / ((sumwd + sumsd) / 2.0)) < eps_d) ||
+            (std::abs(sumwd) < eps_d && std::abs(sumsd) < eps_d)))
         {
             tee << "OK\t";
         }
@@ -508,6 +842,1610 @@ void self_test(teestream & tee)
     }
 }
 
+template<typename T>
+T make_value(double re, double im)
+{
+    (void)im;
+    return static_cast<T>(re);
+}
+
+template<>
+std::complex<float> make_value<std::complex<float> >(double re, double im)
+{
+    return std::complex<float>(static_cast<float>(re), static_cast<float>(im));
+}
+
+template<>
+std::complex<double> make_value<std::complex<double> >(double re, double im)
+{
+    return std::complex<double>(re, im);
+}
+
+// Compare calculate_batch() with calculate() for current compilation mode
+template<typename T>
+bool batch_check(evaluator<T> & p, const std::string & expr)
+{
+    const std::size_t num_tests = 50;
+    std::vector<T> xs(num_tests), ys(num_tests), rb(num_tests), rs(num_tests);
+    srand(1);
+    for(std::size_t j = 0; j < num_tests; j++)
+    {
+        double xd = rand_uniform(0, 1);
+        double yd = rand_uniform(0, 1);
+        xs[j] = make_value<T>(xd, yd);
+        ys[j] = make_value<T>(yd, xd);
+        if(expr == "acosh(x)")
+            xs[j] += static_cast<T>(1);
+    }
+
+    std::map<std::string, const T *> bindings;
+    bindings["x"] = &xs[0];
+    bindings["y"] = &ys[0];
+    // Expression may have no 'y', unknown names are rejected by calculate_batch()
+    p.set_var("x", xs[0]);
+    p.set_var("y", ys[0]);
+    if(!p.calculate_batch(num_tests, bindings, &rb[0]))
+        return false;
+
+    for(std::size_t j = 0; j < num_tests; j++)
+    {
+        p.set_var("x", xs[j]);
+        p.set_var("y", ys[j]);
+        if(!p.calculate(rs[j]))
+            return false;
+        if(rb[j] != rs[j] && (rb[j] == rb[j] || rs[j] == rs[j]))
+            return false;
+    }
+    return true;
+}
+
+template<typename T>
+bool batch_check_all(const std::string & expr)
+{
+    evaluator<T> p;
+    if(!p.parse(expr))
+        return false;
+    if(!batch_check(p, expr))
+        return false;
+#if !defined(EVALUATOR_JIT_DISABLE)
+    if(!p.compile_inline() || !batch_check(p, expr))
+        return false;
+    if(!p.compile_extcall() || !batch_check(p, expr))
+        return false;
+    if(!p.compile_inline(true) || !batch_check(p, expr))
+        return false;
+    if(!p.compile_extcall(true) || !batch_check(p, expr))
+        return false;
+    if(evaluator_internal::is_floating<T>())
+    {
+        if(!p.compile_sse2() || !batch_check(p, expr))
+            return false;
+        if(!p.compile_sse2(true) || !batch_check(p, expr))
+            return false;
+#if defined(EVALUATOR_JIT_X64)
+        if(!p.compile_kernel() || !batch_check(p, expr))
+            return false;
+#endif
+        if(evaluator_internal_jit::cpu_has_avx2() && (!p.compile_simd(false) || !batch_check(p, expr)))
+            return false;
+        if(evaluator_internal_jit::cpu_has_avx512f() && (!p.compile_simd(true) || !batch_check(p, expr)))
+            return false;
+    }
+#endif
+    return true;
+}
+
+void batch_test(teestream & tee)
+{
+    std::vector<std::string> exprs;
+    get_all_exprs(exprs);
+
+    tee << "Batch-Checks\tfloat\tdouble\tcfoat\tcdouble" << std::endl;
+    for(std::size_t i = 0; i < exprs.size(); i++)
+    {
+        tee << exprs[i] << "\t";
+        tee << (batch_check_all<float>(exprs[i])                 ? "OK\t" : "FAIL\t");
+        tee << (batch_check_all<double>(exprs[i])                ? "OK\t" : "FAIL\t");
+        tee << (batch_check_all<std::complex<float> >(exprs[i])  ? "OK\t" : "FAIL\t");
+        tee << (batch_check_all<std::complex<double> >(exprs[i]) ? "OK\t" : "FAIL\t");
+        tee << std::endl;
+    }
+}
+
+// Formula 'expr' without variables has value 'value', signs of zero parts are compared too
+template<typename T>
+bool literal_check(const std::string & expr, const T & value)
+{
+    evaluator<T> p;
+    T r;
+    if(!p.parse(expr) || !p.calculate(r) || r != value)
+        return false;
+    // Zero parts have the same sign if their reciprocals are the same infinities
+    const std::complex<double> rc(r), vc(value);
+    return (rc.real() != 0.0 || 1.0 / rc.real() == 1.0 / vc.real()) &&
+           (rc.imag() != 0.0 || 1.0 / rc.imag() == 1.0 / vc.imag());
+}
+
+// Formulas 'expr' and 'reference' without variables have the same value
+template<typename T>
+bool literal_same(const std::string & expr, const std::string & reference)
+{
+    evaluator<T> p;
+    T r;
+    return p.parse(reference) && p.calculate(r) && literal_check(expr, r);
+}
+
+// Malformed number 'expr' is not parsed
+template<typename T>
+bool malformed_check(const std::string & expr)
+{
+    evaluator<T> p;
+    return !p.parse(expr);
+}
+
+// Random decimal literals are parsed to the same values as by stream with classic locale,
+// also after C locale with decimal comma is set, if the system has one
+bool decimals_check()
+{
+    static const char * const locales[] = { "de_DE.UTF-8", "de_DE", "ru_RU.UTF-8", "fr_FR.UTF-8", "German" };
+    bool result = true;
+    for(std::size_t k = 0; k <= sizeof(locales) / sizeof(locales[0]); k++)
+    {
+        if(k > 0 && !std::setlocale(LC_NUMERIC, locales[k - 1]))
+            continue;
+        srand(1);
+        for(std::size_t j = 0; j < 2000 && result; j++)
+        {
+            std::stringstream sst;
+            sst << (rand() % 100000) << "." << (rand() % 100000000) << "e" << (rand() % 90 - 45);
+            if(j % 4 == 0)
+                sst.str(sst.str().substr(0, sst.str().find('e')));
+            std::istringstream ref(sst.str());
+            ref.imbue(std::locale::classic());
+            double value;
+            ref >> value;
+            evaluator<double> p;
+            double r;
+            result = p.parse(sst.str()) && p.calculate(r) && r == value;
+        }
+        std::setlocale(LC_NUMERIC, "C");
+    }
+    return result;
+}
+
+void literals_test(teestream & tee)
+{
+    const std::complex<double> i(0.0, 1.0);
+    const std::complex<float> i_f(0.0f, 1.0f);
+    tee << "Literal-Checks\tfloat\tdouble\tcfoat\tcdouble" << std::endl;
+    tee << "sqrt(-1)\t-\t-\t";
+    tee << (literal_check<std::complex<float> >("sqrt(-1)", i_f)  ? "OK\t" : "FAIL\t");
+    tee << (literal_check<std::complex<double> >("sqrt(-1)", i)   ? "OK\t" : "FAIL\t");
+    tee << std::endl;
+    tee << "-2^2\t";
+    tee << (literal_check<float>("-2^2", 4.0f)                                         ? "OK\t" : "FAIL\t");
+    tee << (literal_check<double>("-2^2", 4.0)                                         ? "OK\t" : "FAIL\t");
+    // Complex power of (-2,+0) has imaginary part about -1e-15, its sign depends on sign of zero
+    tee << (literal_same<std::complex<float> >("-2^2", "(0-2)^2")                      ? "OK\t" : "FAIL\t");
+    tee << (literal_same<std::complex<double> >("-2^2", "(0-2)^2")                     ? "OK\t" : "FAIL\t");
+    tee << std::endl;
+    tee << "-0\t";
+    tee << (literal_check<float>("-0", -0.0f)                                          ? "OK\t" : "FAIL\t");
+    tee << (literal_check<double>("-0", -0.0)                                          ? "OK\t" : "FAIL\t");
+    tee << (literal_check<std::complex<float> >("-0", std::complex<float>(-0.0f))      ? "OK\t" : "FAIL\t");
+    tee << (literal_check<std::complex<double> >("-0", std::complex<double>(-0.0))     ? "OK\t" : "FAIL\t");
+    tee << std::endl;
+    tee << "2,5E-1+1d2\t";
+    tee << (literal_check<float>("2,5E-1+1d2", 100.25f)                                      ? "OK\t" : "FAIL\t");
+    tee << (literal_check<double>("2,5E-1+1d2", 100.25)                                      ? "OK\t" : "FAIL\t");
+    tee << (literal_check<std::complex<float> >("2,5E-1+1d2", std::complex<float>(100.25f))  ? "OK\t" : "FAIL\t");
+    tee << (literal_check<std::complex<double> >("2,5E-1+1d2", std::complex<double>(100.25)) ? "OK\t" : "FAIL\t");
+    tee << std::endl;
+
+    tee << "decimals\t-\t" << (decimals_check() ? "OK\t" : "FAIL\t") << "-\t-\t" << std::endl;
+
+    static const char * const malformed[] = { "1e", "1e+", "2*1E-", "1.5d+x" };
+    for(std::size_t j = 0; j < sizeof(malformed) / sizeof(malformed[0]); j++)
+    {
+        tee << malformed[j] << "\t";
+        tee << (malformed_check<float>(malformed[j])                  ? "OK\t" : "FAIL\t");
+        tee << (malformed_check<double>(malformed[j])                 ? "OK\t" : "FAIL\t");
+        tee << (malformed_check<std::complex<float> >(malformed[j])   ? "OK\t" : "FAIL\t");
+        tee << (malformed_check<std::complex<double> >(malformed[j])  ? "OK\t" : "FAIL\t");
+        tee << std::endl;
+    }
+}
+
+// Compare calculate() after minimize_stack() with calculate() in source order
+template<typename T>
+bool reorder_check(const std::string & expr, std::size_t & depth_before, std::size_t & depth_after)
+{
+    evaluator<T> p, q;
+    if(!p.parse(expr) || !q.parse(expr))
+        return false;
+    depth_before = q.stack_depth();
+    if(!q.minimize_stack())
+        return false;
+    depth_after = q.stack_depth();
+
+    srand(1);
+    for(std::size_t j = 0; j < 50; j++)
+    {
+        double xd = rand_uniform(0, 1);
+        double yd = rand_uniform(0, 1);
+        const T x = make_value<T>(xd, yd);
+        const T y = make_value<T>(yd, xd);
+        p.set_var("x", x);
+        p.set_var("y", y);
+        q.set_var("x", x);
+        q.set_var("y", y);
+        T rp, rq;
+        if(!p.calculate(rp) || !q.calculate(rq))
+            return false;
+        // Only operands of + and * are swapped, so real results are exactly the same,
+        // complex multiplication may differ in last bits if compiler uses FMA
+        if(rp != rq && (rp == rp || rq == rq) &&
+           (evaluator_internal::is_floating<T>() || std::abs(rp - rq) > std::abs(rp) * 1e-5))
+            return false;
+    }
+    return true;
+}
+
+void reorder_test(teestream & tee)
+{
+    std::vector<std::string> exprs;
+    get_all_exprs(exprs);
+    exprs.push_back("x+y*(x-y*(x+sin(y)*(x/y+1)))");
+    exprs.push_back("1/(1+exp(-(x*2.5+y*0.5-3)))");
+    exprs.push_back("x*y+x*(y+x*(y+x*(y+x*(y+x*(y+x*(y+x*(y+x*(y+x))))))))");
+    exprs.push_back("((x+y)*(x-y))/((x*y+1)*(x/y-1))^2");
+
+    tee << "Reorder-Checks\tdepth\tfloat\tdouble\tcfoat\tcdouble" << std::endl;
+    for(std::size_t i = 0; i < exprs.size(); i++)
+    {
+        std::size_t depth_before = 0, depth_after = 0;
+        tee << exprs[i] << "\t";
+        const bool ok_f = reorder_check<float>(exprs[i], depth_before, depth_after);
+        tee << depth_before << "->" << depth_after << "\t";
+        tee << (ok_f                                                                        ? "OK\t" : "FAIL\t");
+        tee << (reorder_check<double>(exprs[i], depth_before, depth_after)                 ? "OK\t" : "FAIL\t");
+        tee << (reorder_check<std::complex<float> >(exprs[i], depth_before, depth_after)  ? "OK\t" : "FAIL\t");
+        tee << (reorder_check<std::complex<double> >(exprs[i], depth_before, depth_after) ? "OK\t" : "FAIL\t");
+        tee << std::endl;
+    }
+}
+
+// Formulas of group 'group', separated by ";", have the same structural hash, the same one after canonicalize(),
+// and the same results as before canonicalize(), the first formula of group 'other' has another hash
+template<typename T>
+bool canonical_check(const std::string & group, const std::string & other)
+{
+    std::vector<std::string> exprs;
+    std::stringstream sst(group);
+    std::string expr;
+    while(std::getline(sst, expr, ';'))
+        exprs.push_back(expr);
+    evaluator<T> o;
+    if(!o.parse(other.substr(0, other.find(';'))))
+        return false;
+    std::size_t hash = 0;
+    for(std::size_t i = 0; i < exprs.size(); i++)
+    {
+        evaluator<T> p, q;
+        if(!p.parse(exprs[i]) || !q.parse(exprs[i]))
+            return false;
+        const std::size_t h = q.structural_hash();
+        if(!q.canonicalize() || q.structural_hash() != h || (i > 0 && h != hash) || h == o.structural_hash())
+            return false;
+        hash = h;
+
+        srand(1);
+        for(std::size_t j = 0; j < 20; j++)
+        {
+            double xd = rand_uniform(0, 1);
+            double yd = rand_uniform(0, 1);
+            const T x = make_value<T>(xd, yd);
+            const T y = make_value<T>(yd, xd);
+            p.set_var("x", x);
+            p.set_var("y", y);
+            q.set_var("x", x);
+            q.set_var("y", y);
+            T rp, rq;
+            if(!p.calculate(rp) || !q.calculate(rq))
+                return false;
+            // Only operands of + and * are swapped, see reorder_check()
+            if(rp != rq && (rp == rp || rq == rq) &&
+               (evaluator_internal::is_floating<T>() || std::abs(rp - rq) > std::abs(rp) * 1e-5))
+                return false;
+        }
+    }
+
+    // Formulas of group share compiled kernel in cache of parse_cached(), if it is supported
+    evaluator<T> k, l;
+    if(!k.parse_cached(exprs.front(), false, true))
+        return !k.is_compiled();
+    return l.parse_cached(exprs.back(), false, true) && k.get_kernel() == l.get_kernel();
+}
+
+// Canonical forms of 'expr1' and 'expr2' are equal only if values of their constants are equal,
+// canonical form keeps values of constants
+template<typename T>
+bool canonical_precision_check(const std::string & expr1, const std::string & expr2)
+{
+    evaluator<T> p, q, pc, qc;
+    T rp, rq, rpc, rqc;
+    if(!p.parse(expr1) || !q.parse(expr2) || !pc.parse(expr1) || !qc.parse(expr2) ||
+       !pc.canonicalize() || !qc.canonicalize())
+        return false;
+    p.set_var("x", static_cast<T>(0));
+    q.set_var("x", static_cast<T>(0));
+    pc.set_var("x", static_cast<T>(0));
+    qc.set_var("x", static_cast<T>(0));
+    if(!p.calculate(rp) || !q.calculate(rq) || !pc.calculate(rpc) || !qc.calculate(rqc))
+        return false;
+    return rpc == rp && rqc == rq && (pc.structural_hash() == qc.structural_hash()) == (rp == rq);
+}
+
+void canonical_test(teestream & tee)
+{
+    // Groups of equivalent formulas, each of them differs from the next one
+    std::vector<std::string> groups;
+    groups.push_back("x+y;y+x;(x)+(y); y +  x ");
+    groups.push_back("x*y*2;2*(y*x);(y*x)*2.0");
+    groups.push_back("sin(x)+1;1.0+sin(x);1e0+sin((x))");
+    groups.push_back("x-y*pi;x-pi*y;x-3.141592653589793238*y");
+    groups.push_back("x-y;(x)-(y)");
+    groups.push_back("y-x;y - x");
+    groups.push_back("x/y+y/x;y/x+x/y");
+    groups.push_back("(x+y)+x;x+(y+x);(y+x)+x");
+    groups.push_back("x+(y+x)*x;x*(x+y)+x");
+    groups.push_back("-x*y;y*(-x)");
+
+    tee << "Canonical-Checks\tfloat\tdouble\tcfoat\tcdouble" << std::endl;
+    for(std::size_t i = 0; i < groups.size(); i++)
+    {
+        const std::string & other = groups[(i + 1) % groups.size()];
+        tee << groups[i] << "\t";
+        tee << (canonical_check<float>(groups[i], other)                  ? "OK\t" : "FAIL\t");
+        tee << (canonical_check<double>(groups[i], other)                 ? "OK\t" : "FAIL\t");
+        tee << (canonical_check<std::complex<float> >(groups[i], other)   ? "OK\t" : "FAIL\t");
+        tee << (canonical_check<std::complex<double> >(groups[i], other)  ? "OK\t" : "FAIL\t");
+        tee << std::endl;
+    }
+
+    // Constants which differ beyond 17 digits, they are equal if long double is the same as double
+    const std::string expr1 = "x+0.1", expr2 = "x+0.10000000000000000005";
+    tee << expr1 << ";" << expr2 << "\t";
+    tee << (canonical_precision_check<float>(expr1, expr2)                  ? "OK\t" : "FAIL\t");
+    tee << (canonical_precision_check<double>(expr1, expr2)                 ? "OK\t" : "FAIL\t");
+    tee << (canonical_precision_check<std::complex<float> >(expr1, expr2)   ? "OK\t" : "FAIL\t");
+    tee << (canonical_precision_check<std::complex<double> >(expr1, expr2)  ? "OK\t" : "FAIL\t");
+    tee << std::endl;
+    tee << "long double\t-\t";
+    tee << (canonical_precision_check<long double>(expr1, expr2)            ? "OK\t" : "FAIL\t");
+    tee << "-\t-\t" << std::endl;
+}
+
+// Results of 'p' and 'q' are close in 20 random points, simplify() folds constants,
+// compiled code keeps intermediate values of 'p' with extended precision
+template<typename T>
+bool cse_same(evaluator<T> & p, evaluator<T> & q)
+{
+    srand(1);
+    for(std::size_t j = 0; j < 20; j++)
+    {
+        double xd = rand_uniform(0, 1);
+        double yd = rand_uniform(0, 1);
+        const T x = make_value<T>(xd, yd);
+        const T y = make_value<T>(yd, xd);
+        p.set_var("x", x);
+        p.set_var("y", y);
+        q.set_var("x", x);
+        q.set_var("y", y);
+        T rp, rq;
+        if(!p.calculate(rp) || !q.calculate(rq))
+            return false;
+        if(rp != rq && (rp == rp || rq == rq) && std::abs(rp - rq) > std::abs(rp) * 1e-5)
+            return false;
+    }
+    return true;
+}
+
+// Common subexpressions of 'expr' are evaluated once after simplify(), 'removed' objects are not
+// evaluated, results are the same as without simplify() for interpreter and compiled code
+template<typename T>
+bool cse_check(const std::string & expr, std::size_t & removed)
+{
+    evaluator<T> p, q;
+    if(!p.parse(expr) || !q.parse(expr) || q.eliminated_size() != 0 || !q.simplify())
+        return false;
+    removed = q.eliminated_size();
+    evaluator<T> r(q);
+    if(!cse_same(p, q) || !cse_same(p, r) || !batch_check(q, expr))
+        return false;
+#if !defined(EVALUATOR_JIT_DISABLE)
+    for(int mode = 0; mode < 4; mode++)
+    {
+        const bool batch = (mode >= 2);
+        if(mode % 2 == 0 && (!p.compile_inline(batch) || !q.compile_inline(batch)))
+            return false;
+        if(mode % 2 == 1 && (!p.compile_extcall(batch) || !q.compile_extcall(batch)))
+            return false;
+        if(!cse_same(p, q) || !batch_check(q, expr))
+            return false;
+    }
+#endif
+    return true;
+}
+
+// Results of 'expr' at x = 'x' are exactly the same with and without simplify(),
+// 'removed' objects are not evaluated
+template<typename T>
+bool cse_exact_check(const std::string & expr, const T & x, std::size_t & removed)
+{
+    evaluator<T> p, q;
+    if(!p.parse(expr) || !q.parse(expr) || !q.simplify())
+        return false;
+    removed = q.eliminated_size();
+    p.set_var("x", x);
+    q.set_var("x", x);
+    T rp, rq;
+    return p.calculate(rp) && q.calculate(rq) && rp == rq;
+}
+
+void cse_test(teestream & tee)
+{
+    // Formulas and numbers of objects which are not evaluated
+    std::vector<std::pair<std::string, std::size_t> > exprs;
+    exprs.push_back(std::make_pair("x+y*(x-y)", 0));
+    exprs.push_back(std::make_pair("(x+y)*(y+x)", 2));
+    exprs.push_back(std::make_pair("exp(-(0.5-x)*(0.5-x)-(0.5-y)*(0.5-y))", 4));
+    exprs.push_back(std::make_pair("sin(x*y)+cos(x*y)*sin(x*y)", 5));
+    exprs.push_back(std::make_pair("(x+y)^2/(x+y)+(x+y)^2", 10));
+    exprs.push_back(std::make_pair("sqrt(x*x+y*y)/(1+sqrt(x*x+y*y))-log(x*x+y*y)", 13));
+    exprs.push_back(std::make_pair("real(x-y)*conj(x-y)+real(x-y)", 5));
+
+    tee << "CSE-Checks\tremoved\tfloat\tdouble\tcfoat\tcdouble" << std::endl;
+    for(std::size_t i = 0; i < exprs.size(); i++)
+    {
+        const std::string & expr = exprs[i].first;
+        std::size_t removed = 0;
+        tee << expr << "\t";
+        const bool ok_f = cse_check<float>(expr, removed) && removed == exprs[i].second;
+        tee << removed << "\t";
+        tee << (ok_f                                                                           ? "OK\t" : "FAIL\t");
+        tee << (cse_check<double>(expr, removed) && removed == exprs[i].second                ? "OK\t" : "FAIL\t");
+        tee << (cse_check<std::complex<float> >(expr, removed) && removed == exprs[i].second  ? "OK\t" : "FAIL\t");
+        tee << (cse_check<std::complex<double> >(expr, removed) && removed == exprs[i].second ? "OK\t" : "FAIL\t");
+        tee << std::endl;
+    }
+
+    // Constants which differ beyond digits of double are different subexpressions
+    const std::string expr = "x*(1/3)+x*(1/3+1e-19)";
+    std::size_t removed = 0;
+    const bool ok_ld = cse_exact_check<long double>(expr, 1e19L, removed) && removed == 0;
+    tee << expr << ", long double\t" << removed << "\t" << (ok_ld ? "OK\t" : "FAIL\t") << "-\t-\t-" << std::endl;
+}
+
+// Formula 'expr' after simplify() has the same structure as formula 'reduced',
+// results are the same as without simplify() for interpreter and compiled code
+template<typename T>
+bool strength_check(const std::string & expr, const std::string & reduced)
+{
+    evaluator<T> p, q, r;
+    if(!p.parse(expr) || !q.parse(expr) || !q.simplify() || !r.parse(reduced))
+        return false;
+    if(q.structural_hash() != r.structural_hash() || !cse_same(p, q))
+        return false;
+#if !defined(EVALUATOR_JIT_DISABLE)
+    if(!p.compile_inline() || !q.compile_inline() || !cse_same(p, q))
+        return false;
+#endif
+    return true;
+}
+
+void strength_test(teestream & tee)
+{
+    // Formulas and their forms after strength reduction
+    std::vector<std::pair<std::string, std::string> > exprs;
+    exprs.push_back(std::make_pair("x^1", "x"));
+    exprs.push_back(std::make_pair("x^2", "x*x"));
+    exprs.push_back(std::make_pair("x^3", "x*x*x"));
+    exprs.push_back(std::make_pair("x^4", "(x*x)*(x*x)"));
+    exprs.push_back(std::make_pair("x^16", "(((x*x)*(x*x))*((x*x)*(x*x)))*(((x*x)*(x*x))*((x*x)*(x*x)))"));
+    exprs.push_back(std::make_pair("x^17", "x^17"));
+    exprs.push_back(std::make_pair("x^2.5", "x^2.5"));
+    exprs.push_back(std::make_pair("(x+y)^3", "(x+y)*(x+y)*(x+y)"));
+    exprs.push_back(std::make_pair("x^(-1)", "1/x"));
+    exprs.push_back(std::make_pair("x^(-2)", "1/(x*x)"));
+    exprs.push_back(std::make_pair("x/4", "x*0.25"));
+    exprs.push_back(std::make_pair("(x-y)/0.125", "(x-y)*8"));
+    exprs.push_back(std::make_pair("x/3", "x/3"));
+    exprs.push_back(std::make_pair("x/0", "x/0"));
+
+    tee << "Strength-Checks\tfloat\tdouble\tcfoat\tcdouble" << std::endl;
+    for(std::size_t i = 0; i < exprs.size(); i++)
+    {
+        const std::string & expr = exprs[i].first, & reduced = exprs[i].second;
+        tee << expr << " -> " << reduced << "\t";
+        tee << (strength_check<float>(expr, reduced)                  ? "OK\t" : "FAIL\t");
+        tee << (strength_check<double>(expr, reduced)                 ? "OK\t" : "FAIL\t");
+        tee << (strength_check<std::complex<float> >(expr, reduced)   ? "OK\t" : "FAIL\t");
+        tee << (strength_check<std::complex<double> >(expr, reduced)  ? "OK\t" : "FAIL\t");
+        tee << std::endl;
+    }
+    // Real x^0.5 and sqrt(x) differ for -0 and -inf, so only complex x^0.5 is reduced
+    static const char * const sqrts[][3] = { { "x^0.5", "x^0.5", "sqrt(x)" }, { "(x-y)^0.5", "(x-y)^0.5", "sqrt(x-y)" } };
+    for(std::size_t i = 0; i < sizeof(sqrts) / sizeof(sqrts[0]); i++)
+    {
+        tee << sqrts[i][0] << " -> " << sqrts[i][1] << ", " << sqrts[i][2] << "\t";
+        tee << (strength_check<float>(sqrts[i][0], sqrts[i][1])                  ? "OK\t" : "FAIL\t");
+        tee << (strength_check<double>(sqrts[i][0], sqrts[i][1])                 ? "OK\t" : "FAIL\t");
+        tee << (strength_check<std::complex<float> >(sqrts[i][0], sqrts[i][2])   ? "OK\t" : "FAIL\t");
+        tee << (strength_check<std::complex<double> >(sqrts[i][0], sqrts[i][2])  ? "OK\t" : "FAIL\t");
+        tee << std::endl;
+    }
+}
+
+#if !defined(EVALUATOR_JIT_DISABLE)
+void print_arena_stats(teestream & tee, const char * name)
+{
+    const evaluator_internal_jit::code_arena_stats stats = evaluator_internal_jit::code_arena_get_stats();
+    tee << name << "\t" << stats.blocks << "\t" << stats.used << "\t" << stats.reserved << "\t"
+        << stats.free_blocks << "\t" << stats.fragmentation() << std::endl;
+}
+#endif
+
+// Compiled code of many evaluators in code arena
+void arena_test(teestream & tee)
+{
+#if !defined(EVALUATOR_JIT_DISABLE)
+    std::vector<std::string> exprs;
+    get_all_exprs(exprs);
+    const evaluator_internal_jit::code_arena_stats before = evaluator_internal_jit::code_arena_get_stats();
+
+    tee << "Code-Arena\tblocks\tused\treserved\tfree_blocks\tfragmentation" << std::endl;
+    print_arena_stats(tee, "initial");
+
+    const std::size_t num_evaluators = 10000;
+    std::vector<evaluator<double> *> evaluators(num_evaluators);
+    bool results_ok = true;
+    for(std::size_t i = 0; i < num_evaluators; i++)
+    {
+        evaluators[i] = new evaluator<double>;
+        evaluator<double> & p = * evaluators[i];
+        const std::string & expr = exprs[i % exprs.size()];
+        if(!p.parse(expr) || !p.compile_inline())
+            results_ok = false;
+        p.set_var("x", 0.5);
+        p.set_var("y", 0.25);
+    }
+    // Code of every evaluator is still valid after all compilations
+    for(std::size_t i = 0; i < exprs.size(); i++)
+    {
+        evaluator<double> q;
+        q.parse(exprs[i]);
+        q.set_var("x", 0.5);
+        q.set_var("y", 0.25);
+        double rc, ri;
+        if(!evaluators[i]->calculate(rc) || !q.calculate(ri) || std::fabs(rc - ri) > 5e-14 * std::fabs(ri))
+            results_ok = false;
+    }
+    print_arena_stats(tee, "compiled");
+
+    for(std::size_t i = 0; i < num_evaluators; i += 2)
+    {
+        delete evaluators[i];
+        evaluators[i] = NULL;
+    }
+    print_arena_stats(tee, "half freed");
+
+    for(std::size_t i = 0; i < num_evaluators; i++)
+        delete evaluators[i];
+    print_arena_stats(tee, "all freed");
+
+    // Assignment of derived evaluator releases code of the target, self-assignment keeps it
+    {
+        evaluator_xyz<double> a("x+y*z"), b("exp(-x*x)");
+        if(!a.compile_inline() || !b.compile_extcall())
+            results_ok = false;
+        a = b;
+        b = b;
+        b.set_x(0.5);
+        a.set_x(0.5);
+        double ra, rb;
+        if(!a.calculate(ra) || !b.calculate(rb) || ra != rb || !b.is_compiled())
+            results_ok = false;
+    }
+
+    const evaluator_internal_jit::code_arena_stats after = evaluator_internal_jit::code_arena_get_stats();
+    tee << "Results\t" << (results_ok ? "OK" : "FAIL") << std::endl;
+    tee << "Reclaimed\t" << (after.used == before.used && after.blocks == before.blocks ? "OK" : "FAIL") << std::endl;
+#else
+    tee << "Code-Arena\tJIT is disabled" << std::endl;
+#endif
+}
+
+// Result of kernel is close to result of interpreter in type T or in double,
+// software kernels of float functions are more accurate than float formulas of interpreter
+template<typename T>
+bool reentrant_same(T r, T q, double d)
+{
+    const T eps = static_cast<T>(sizeof(T) == 4 ? 5e-7 : 5e-14);
+    const T qd = static_cast<T>(d);
+    return r == q || (r != r && q != q) || std::fabs(r - q) <= eps * std::fabs(q) || std::fabs(r - qd) <= eps * std::fabs(qd);
+}
+
+// Call reentrant kernel directly for interleaved points with separate scratch memory
+// and compare with calculate() of another evaluator
+template<typename T>
+bool reentrant_check(const std::string & expr)
+{
+    evaluator<T> p, q;
+    evaluator<double> d;
+    if(!p.parse(expr) || !q.parse(expr) || !d.parse(expr) || !p.compile_kernel())
+        return false;
+    typename evaluator<T>::kernel_type kernel = p.get_kernel();
+    const std::vector<std::string> & names = p.get_kernel_vars();
+    if(!kernel)
+        return false;
+
+    const std::size_t num_tests = 50;
+    std::vector<T> scratch1(p.get_kernel_scratch_size()), scratch2(p.get_kernel_scratch_size());
+    std::vector<T> vars1(names.size()), vars2(names.size());
+    srand(1);
+    for(std::size_t j = 0; j < num_tests; j += 2)
+    {
+        const T x1 = static_cast<T>(rand_uniform(0, 1)), y1 = static_cast<T>(rand_uniform(0, 1));
+        const T x2 = static_cast<T>(rand_uniform(0, 1)), y2 = static_cast<T>(rand_uniform(0, 1));
+        for(std::size_t k = 0; k < names.size(); k++)
+        {
+            vars1[k] = (names[k] == "x") ? x1 : y1;
+            vars2[k] = (names[k] == "x") ? x2 : y2;
+        }
+        T r1, r2, q1, q2;
+        double d1, d2;
+        kernel(vars1.empty() ? NULL : & vars1[0], & scratch1[0], & r1);
+        kernel(vars2.empty() ? NULL : & vars2[0], & scratch2[0], & r2);
+        q.set_var("x", x1);
+        q.set_var("y", y1);
+        q.calculate(q1);
+        q.set_var("x", x2);
+        q.set_var("y", y2);
+        q.calculate(q2);
+        d.set_var("x", static_cast<double>(x1));
+        d.set_var("y", static_cast<double>(y1));
+        d.calculate(d1);
+        d.set_var("x", static_cast<double>(x2));
+        d.set_var("y", static_cast<double>(y2));
+        d.calculate(d2);
+        if(!reentrant_same(r1, q1, d1) || !reentrant_same(r2, q2, d2))
+            return false;
+    }
+
+    // Copy shares compiled kernel, has its own variables and outlives the original
+    evaluator<T> * original = new evaluator<T>(p);
+    evaluator<T> copy(* original);
+    if(!copy.is_compiled() || copy.get_kernel() != kernel)
+        return false;
+    original->set_var("x", static_cast<T>(0.1));
+    original->set_var("y", static_cast<T>(0.2));
+    delete original;
+    copy.set_var("x", static_cast<T>(0.3));
+    copy.set_var("y", static_cast<T>(0.4));
+    q.set_var("x", static_cast<T>(0.3));
+    q.set_var("y", static_cast<T>(0.4));
+    d.set_var("x", static_cast<double>(static_cast<T>(0.3)));
+    d.set_var("y", static_cast<double>(static_cast<T>(0.4)));
+    T rc, rq;
+    double rd;
+    if(!copy.calculate(rc) || !q.calculate(rq) || !d.calculate(rd))
+        return false;
+    return reentrant_same(rc, rq, rd);
+}
+
+// Copy of compiled evaluator is compiled by the same function, has its own variables
+// and outlives the original, 'mode' is 0 for inline, 1 for extcall, 2 for SSE2, 3 for SIMD
+template<typename T>
+bool copy_check(const std::string & expr, int mode)
+{
+    evaluator<T> * original = new evaluator<T>;
+    if(!original->parse(expr))
+        return false;
+    original->set_var("x", static_cast<T>(0.3));
+    original->set_var("y", static_cast<T>(0.4));
+    bool compiled = false;
+    switch(mode)
+    {
+    case 0: compiled = original->compile_inline();  break;
+    case 1: compiled = original->compile_extcall(); break;
+    case 2: compiled = original->compile_sse2();    break;
+    case 3: compiled = original->compile_simd();    break;
+    }
+    T r0, rc;
+    if(!compiled)
+    {
+        delete original;
+        // CPU may have no AVX2
+        return mode == 3;
+    }
+    evaluator<T> copy(* original);
+    if(!copy.is_compiled() || !original->calculate(r0))
+        return false;
+    original->set_var("x", static_cast<T>(0.1));
+    original->parse("x-y");
+    delete original;
+    if(!copy.calculate(rc))
+        return false;
+    return rc == r0 || (rc != rc && r0 != r0);
+}
+
+void reentrant_test(teestream & tee)
+{
+#if defined(EVALUATOR_JIT_X64)
+    std::vector<std::string> exprs;
+    get_all_exprs(exprs);
+    exprs.push_back("x*y+x*(y+x*(y+x*(y+x*(y+x*(y+x*(y+x*(y+x*(y+x))))))))");
+    exprs.push_back("exp(-(0.5-x)*(0.5-x)-(0.5-y)*(0.5-y))");
+    exprs.push_back("x+y*(x-y*(x+sin(y)*(x/y+1)))");
+
+    tee << "Reentrant-Checks\tfloat\tdouble" << std::endl;
+    for(std::size_t i = 0; i < exprs.size(); i++)
+    {
+        tee << exprs[i] << "\t";
+        tee << (reentrant_check<float>(exprs[i])  ? "OK\t" : "FAIL\t");
+        tee << (reentrant_check<double>(exprs[i]) ? "OK\t" : "FAIL\t");
+        tee << std::endl;
+    }
+
+    tee << "\nCopy-Checks\tinline\textcall\tsse2\tsimd" << std::endl;
+    for(std::size_t i = 0; i < exprs.size(); i++)
+    {
+        tee << exprs[i] << "\t";
+        for(int mode = 0; mode < 4; mode++)
+            tee << (copy_check<double>(exprs[i], mode) ? "OK\t" : "FAIL\t");
+        tee << std::endl;
+    }
+
+    // Copies of evaluator with compiled kernel share its code
+    const std::size_t num_copies = 10000;
+    evaluator<double> p;
+    p.parse("exp(-(0.5-x)*(0.5-x)-(0.5-y)*(0.5-y))");
+    unsigned long t_compile = mtime();
+    for(std::size_t i = 0; i < num_copies; i++)
+        p.compile_kernel();
+    t_compile = mtime() - t_compile;
+    unsigned long t_copy = mtime();
+    for(std::size_t i = 0; i < num_copies; i++)
+    {
+        evaluator<double> copy(p);
+        if(!copy.is_compiled())
+            tee << "Copy is not compiled: FAIL" << std::endl;
+    }
+    t_copy = mtime() - t_copy;
+    tee << "\nCopies\tcompile_kernel() ms\tcopy ms" << std::endl;
+    tee << num_copies << "\t" << t_compile << "\t" << t_copy << std::endl;
+#else
+    tee << "Reentrant-Checks\tx64 only" << std::endl;
+#endif
+}
+
+// Handles of variables stay valid after parse(), simplify(), reset_vars() and copying
+template<typename T>
+bool handles_check()
+{
+    evaluator<T> p;
+    const typename evaluator<T>::var_handle hx = p.get_var_handle("x");
+    p.set(hx, T(2));
+    if(!p.parse("x*y+z") || !p.simplify())
+        return false;
+    const typename evaluator<T>::var_handle hy = p.get_var_handle("y");
+    const typename evaluator<T>::var_handle hz = p.get_var_handle("z");
+    if(p.get_var_handle("x") != hx)
+        return false;
+    T r;
+    p.set(hy, T(3));
+    p.set(hz, T(4));
+    if(!p.calculate(r) || r != T(10))
+        return false;
+
+    p.reset_vars();
+    p.set(hx, T(5));
+    p.set(hy, T(6));
+    p.set(hz, T(7));
+    if(!p.calculate(r) || r != T(37))
+        return false;
+
+    // Copy has its own values with the same handles
+    evaluator<T> q(p);
+    q.set(hx, T(1));
+    if(!q.calculate(r) || r != T(13) || !p.calculate(r) || r != T(37))
+        return false;
+    if(!p.parse("x-z"))
+        return false;
+#if !defined(EVALUATOR_JIT_DISABLE)
+    if(!p.compile())
+        return false;
+#endif
+    if(!p.calculate(r) || r != T(-2))
+        return false;
+    q = p;
+    q.set(hz, T(1));
+    if(!q.calculate(r) || r != T(4))
+        return false;
+
+    // New variables may move slot table, handles and compiled batch code stay valid
+#if !defined(EVALUATOR_JIT_DISABLE)
+    if(!p.compile(true))
+        return false;
+#endif
+    for(std::size_t i = 0; i < 100; i++)
+    {
+        std::stringstream sst;
+        sst << "v" << i;
+        p.set_var(sst.str(), T(1));
+    }
+    p.set(hz, T(3));
+#if !defined(EVALUATOR_JIT_DISABLE)
+    if(!p.is_compiled())
+        return false;
+#endif
+    return p.calculate(r) && r == T(2);
+}
+
+// Variables without values are rejected by all modes of calculation, any value is accepted
+template<typename T>
+bool defined_check()
+{
+    evaluator<T> p;
+    const T big = static_cast<T>(std::numeric_limits<float>::max());
+    T r, x = T(1);
+    if(!p.parse("x+y"))
+        return false;
+    p.set_var("x", x);
+    if(p.calculate(r))
+        return false;
+    p.set_var("y", big);
+    if(!p.calculate(r) || r != x + big)
+        return false;
+
+    std::map<std::string, const T *> bindings;
+    bindings["x"] = & x;
+    for(int batch = 0; batch < 2; batch++)
+    {
+#if !defined(EVALUATOR_JIT_DISABLE)
+        if(!p.compile(batch != 0))
+            return false;
+#endif
+        p.reset_vars();
+        if(p.calculate(r) || p.calculate_batch(1, bindings, & r))
+            return false;
+        p.set_var("y", big);
+        if(!p.calculate_batch(1, bindings, & r) || r != x + big || !p.calculate(r) || r != x + big)
+            return false;
+    }
+
+    // Unknown names are rejected and are not added to variables
+    bindings["z"] = & x;
+    if(p.calculate_batch(1, bindings, & r) || p.get_error() != "Unknown variable `z`!")
+        return false;
+    if(p.calculate_batch(1, bindings, & r))
+        return false;
+    p.set_var("z", x);
+    if(!p.calculate_batch(1, bindings, & r) || r != x + big)
+        return false;
+    return true;
+}
+
+// Derived evaluator with customized builtins, see set_function() and set_constant()
+template<typename T> class custom_evaluator : public evaluator<T>
+{
+public:
+    using evaluator<T>::set_constant;
+
+    custom_evaluator()
+    {
+        evaluator<T>::set_function("Twice", twice);
+        evaluator<T>::set_constant("answer", static_cast<T>(42));
+    }
+
+private:
+    static T twice(const T & x)
+    {
+        return x + x;
+    }
+};
+
+// Customized builtins are used by interpreter, extcall code, copies and parse_cached(),
+// shared builtins of other evaluators are not changed
+template<typename T>
+bool custom_check()
+{
+    custom_evaluator<T> c;
+    T r1, r2, r3, r4;
+    if(!c.parse("twice(answer)+x"))
+        return false;
+    c.set_var("x", static_cast<T>(1));
+    custom_evaluator<T> copy(c);
+    if(!c.calculate(r1) || !copy.calculate(r2))
+        return false;
+    // JIT may be disabled
+    r3 = r1;
+    if(c.compile_extcall() && !c.calculate(r3))
+        return false;
+    if(!c.parse_cached("twice(x)") || !c.calculate(r4))
+        return false;
+    // Registered constants take free slots or rehash the table, all of them are found
+    for(int i = 0; i < 100; i++)
+    {
+        std::stringstream sst;
+        sst << "c" << i;
+        c.set_constant(sst.str(), static_cast<T>(i));
+    }
+    for(int i = 0; i < 100; i++)
+    {
+        std::stringstream sst;
+        sst << "C" << i;
+        T ri;
+        if(!c.parse(sst.str()) || !c.calculate(ri) || ri != static_cast<T>(i))
+            return false;
+    }
+    evaluator<T> p;
+    T r;
+    return r1 == static_cast<T>(85) && r2 == r1 && r3 == r1 && r4 == static_cast<T>(2) &&
+           !p.parse("twice(1)") && p.parse("answer") && !p.calculate(r);
+}
+
+void handles_test(teestream & tee)
+{
+    tee << "Handles-Checks\tfloat\tdouble\tcfoat\tcdouble" << std::endl;
+    tee << "handles\t";
+    tee << (handles_check<float>()                  ? "OK\t" : "FAIL\t");
+    tee << (handles_check<double>()                 ? "OK\t" : "FAIL\t");
+    tee << (handles_check<std::complex<float> >()   ? "OK\t" : "FAIL\t");
+    tee << (handles_check<std::complex<double> >()  ? "OK\t" : "FAIL\t");
+    tee << std::endl;
+    tee << "defined\t";
+    tee << (defined_check<float>()                  ? "OK\t" : "FAIL\t");
+    tee << (defined_check<double>()                 ? "OK\t" : "FAIL\t");
+    tee << (defined_check<std::complex<float> >()   ? "OK\t" : "FAIL\t");
+    tee << (defined_check<std::complex<double> >()  ? "OK\t" : "FAIL\t");
+    tee << std::endl;
+    tee << "custom\t";
+    tee << (custom_check<float>()                  ? "OK\t" : "FAIL\t");
+    tee << (custom_check<double>()                 ? "OK\t" : "FAIL\t");
+    tee << (custom_check<std::complex<float> >()   ? "OK\t" : "FAIL\t");
+    tee << (custom_check<std::complex<double> >()  ? "OK\t" : "FAIL\t");
+    tee << std::endl;
+
+    // Setting of 20 variables by names and by handles
+    const std::size_t num_vars = 20, num_sets = 200000;
+    std::vector<std::string> names;
+    std::string expr = "0";
+    for(std::size_t i = 0; i < num_vars; i++)
+    {
+        std::stringstream sst;
+        sst << "input_variable_" << i;
+        names.push_back(sst.str());
+        expr += "+" + sst.str();
+    }
+    evaluator<double> p;
+    p.parse(expr);
+    p.compile();
+    std::vector<evaluator<double>::var_handle> handles;
+    for(std::size_t i = 0; i < num_vars; i++)
+        handles.push_back(p.get_var_handle(names[i]));
+
+    double r_names = 0.0, r_handles = 0.0, r;
+    unsigned long t_names = mtime();
+    for(std::size_t k = 0; k < num_sets; k++)
+    {
+        for(std::size_t i = 0; i < num_vars; i++)
+            p.set_var(names[i], static_cast<double>(k + i));
+        p.calculate(r);
+        r_names += r;
+    }
+    t_names = mtime() - t_names;
+    unsigned long t_handles = mtime();
+    for(std::size_t k = 0; k < num_sets; k++)
+    {
+        for(std::size_t i = 0; i < num_vars; i++)
+            p.set(handles[i], static_cast<double>(k + i));
+        p.calculate(r);
+        r_handles += r;
+    }
+    t_handles = mtime() - t_handles;
+    tee << "\nSetting\tset_var() ms\tset() ms\tresults" << std::endl;
+    tee << num_vars << "x" << num_sets << "\t" << t_names << "\t" << t_handles << "\t"
+        << (r_names == r_handles ? "OK" : "FAIL") << std::endl;
+}
+
+// Size of objects of expression and time of copying and simplification of large expression
+void objects_test(teestream & tee)
+{
+    std::stringstream sst;
+    sst << "x";
+    const std::size_t num_terms = 20000;
+    for(std::size_t i = 1; i < num_terms; i++)
+        sst << "+sin(x*" << i % 7 << ")*(y-" << i % 5 << "*2)";
+    evaluator<double> p;
+    p.parse(sst.str());
+
+    const std::size_t num_copies = 100;
+    unsigned long t_copy = mtime();
+    for(std::size_t i = 0; i < num_copies; i++)
+    {
+        evaluator<double> q(p);
+        if(!q.is_parsed())
+            tee << "Copy is not parsed: FAIL" << std::endl;
+    }
+    t_copy = mtime() - t_copy;
+    unsigned long t_simplify = mtime();
+    p.simplify();
+    t_simplify = mtime() - t_simplify;
+
+    tee << "Objects\tsize\tcopy ms\tsimplify ms" << std::endl;
+    tee << "double\t" << sizeof(evaluator_internal::evaluator_object<double>) << "\t"
+        << t_copy << "\t" << t_simplify << std::endl;
+}
+
+// Interpreter doesn't allocate memory in calculate() of parsed expression
+template<typename T>
+bool alloc_check(const std::string & expr)
+{
+    evaluator<T> p;
+    if(!p.parse(expr))
+        return false;
+    p.set_var("x", static_cast<T>(0.5));
+    p.set_var("y", static_cast<T>(0.25));
+    T r;
+    bool result = true;
+    for(int step = 0; step < 3; step++)
+    {
+        if(step == 1)
+            p.simplify();
+        if(step == 2)
+            p.minimize_stack();
+        const std::size_t before = allocations_num;
+        for(std::size_t i = 0; i < 100; i++)
+            result = p.calculate(r) && result;
+        if(allocations_num != before)
+            return false;
+    }
+    return result;
+}
+
+// Construction and copying of unparsed evaluator don't allocate memory, builtins are shared
+template<typename T>
+bool construct_check()
+{
+    {
+        evaluator<T> p;
+    }
+    const std::size_t before = allocations_num;
+    {
+        evaluator<T> p;
+        evaluator<T> q(p);
+    }
+    return allocations_num == before;
+}
+
+void alloc_test(teestream & tee)
+{
+    std::vector<std::string> exprs;
+    get_all_exprs(exprs);
+    exprs.push_back("x*y+x*(y+x*(y+x*(y+x*(y+x*(y+x*(y+x*(y+x*(y+x))))))))");
+    exprs.push_back("((x+y)*(x-y))/((x*y+1)*(x/y-1))^2");
+
+    tee << "Alloc-Checks\tfloat\tdouble\tcfoat\tcdouble" << std::endl;
+    for(std::size_t i = 0; i < exprs.size(); i++)
+    {
+        tee << exprs[i] << "\t";
+        tee << (alloc_check<float>(exprs[i])                  ? "OK\t" : "FAIL\t");
+        tee << (alloc_check<double>(exprs[i])                 ? "OK\t" : "FAIL\t");
+        tee << (alloc_check<std::complex<float> >(exprs[i])   ? "OK\t" : "FAIL\t");
+        tee << (alloc_check<std::complex<double> >(exprs[i])  ? "OK\t" : "FAIL\t");
+        tee << std::endl;
+    }
+    tee << "evaluator()\t";
+    tee << (construct_check<float>()                  ? "OK\t" : "FAIL\t");
+    tee << (construct_check<double>()                 ? "OK\t" : "FAIL\t");
+    tee << (construct_check<std::complex<float> >()   ? "OK\t" : "FAIL\t");
+    tee << (construct_check<std::complex<double> >()  ? "OK\t" : "FAIL\t");
+    tee << std::endl;
+}
+
+// Number of dispatched instructions of interpreter before and after fusion of superinstructions,
+// time of one instruction, the same amount of work for each expression
+void dispatch_test(std::size_t num_tests, teestream & tee)
+{
+    std::vector<std::string> exprs;
+    get_all_exprs(exprs);
+    exprs.push_back("x*x*x*0.5-3*x*y+y*y/2-x/y+1");
+    exprs.push_back("((((0.1*x+0.2)*x+0.3)*x+0.4)*x+0.5)*x+0.6");
+    exprs.push_back("exp(-(x*x+y*y)/2)/6.283185");
+    exprs.push_back("sqrt((x-1)*(x-1)+(y-2)*(y-2))");
+    exprs.push_back("sin(x)*cos(y)+x*y-x/y");
+    exprs.push_back("(x*x+y*y-2*x*y+x-y)*(x+y)/(x*y+1)^2");
+    std::stringstream sst;
+    sst << "x";
+    for(std::size_t i = 1; i < 1000; i++)
+        sst << "+sin(x*" << i % 7 << ")*(y-" << i % 5 << "*2)";
+    exprs.push_back(sst.str());
+
+    std::size_t objects_all = 0, instrs_all = 0;
+    tee << "Dispatches\tobjects\tinstrs\tns/instr" << std::endl;
+    for(std::size_t i = 0; i < exprs.size(); i++)
+    {
+        evaluator<double> p;
+        p.parse(exprs[i]);
+        p.set_var("x", 0.5);
+        p.set_var("y", 0.25);
+        const std::size_t objects = p.expression_size(), instrs = p.bytecode_size();
+        objects_all += objects;
+        instrs_all += instrs;
+        const std::size_t num_evals = std::max(static_cast<std::size_t>(1), num_tests / objects);
+        double r;
+        unsigned long t = mtime();
+        for(std::size_t k = 0; k < num_evals; k++)
+            p.calculate(r);
+        t = mtime() - t;
+        tee << (exprs[i].size() > 40 ? exprs[i].substr(0, 37) + "..." : exprs[i]) << "\t"
+            << objects << "\t" << instrs << "\t"
+            << static_cast<double>(t) * 1e6 / static_cast<double>(num_evals * (instrs + 1)) << std::endl;
+    }
+    tee << "Total\t" << objects_all << "\t" << instrs_all << std::endl;
+}
+
+// Parsing speed in MB/s for 'num_bytes' bytes of formulas 'exprs'
+template<typename T>
+double parse_speed(const std::vector<std::string> & exprs, std::size_t num_bytes)
+{
+    evaluator<T> p;
+    std::size_t bytes = 0;
+    unsigned long t = mtime();
+    while(bytes < num_bytes)
+    {
+        for(std::size_t i = 0; i < exprs.size(); i++)
+        {
+            if(!p.parse(exprs[i]))
+                return 0.0;
+            bytes += exprs[i].size();
+        }
+    }
+    t = mtime() - t;
+    return static_cast<double>(bytes) / 1e3 / static_cast<double>(std::max(t, 1UL));
+}
+
+// Results of 'p' and 'q' are the same in 20 random points
+template<typename T>
+bool same_results(evaluator<T> & p, evaluator<T> & q)
+{
+    srand(1);
+    for(std::size_t j = 0; j < 20; j++)
+    {
+        double xd = rand_uniform(0, 1);
+        double yd = rand_uniform(0, 1);
+        const T x = make_value<T>(xd, yd);
+        const T y = make_value<T>(yd, xd);
+        p.set_var("x", x);
+        p.set_var("y", y);
+        q.set_var("x", x);
+        q.set_var("y", y);
+        T rp, rq;
+        if(!p.calculate(rp) || !q.calculate(rq))
+            return false;
+        // Cached expression is in canonical form, see reorder_check()
+        if(rp != rq && (rp == rp || rq == rq) &&
+           (evaluator_internal::is_floating<T>() || std::abs(rp - rq) > std::abs(rp) * 1e-5))
+            return false;
+    }
+    return true;
+}
+
+// Expression from cache of parse_cached() gives the same results as parsed one, also in evaluator
+// with other variables and with shared kernel, repeated expression with other spaces is a hit
+template<typename T>
+bool cache_check(const std::string & expr)
+{
+    const evaluator_internal::cache_stats before = evaluator<T>::get_parse_cache_stats();
+    evaluator<T> p, q, r;
+    r.set_var("w", static_cast<T>(1));
+    r.set_var("y", static_cast<T>(1));
+    if(!p.parse_cached(expr, true) || !q.parse_cached("  " + expr + " ", true) || !r.parse_cached(expr, true))
+        return false;
+    const evaluator_internal::cache_stats after = evaluator<T>::get_parse_cache_stats();
+    if(after.hits + after.misses != before.hits + before.misses + 3 || after.hits < before.hits + 2)
+        return false;
+
+    evaluator<T> s;
+    if(!s.parse(expr) || !s.simplify() || !same_results(p, s) || !same_results(q, s) || !same_results(r, s))
+        return false;
+
+    // Kernel is compiled once, if it is supported
+    evaluator<T> k, l;
+    l.set_var("y", static_cast<T>(1));
+    if(!k.parse_cached(expr, false, true))
+        return !k.is_compiled() && k.is_parsed();
+    if(!l.parse_cached(expr, false, true) || !l.is_compiled() || k.get_kernel() != l.get_kernel())
+        return false;
+    return same_results(k, l);
+}
+
+// Cache of parse_cached() keeps expressions within limit of memory, least recently used are removed
+template<typename T>
+bool cache_limit_check()
+{
+    evaluator<T>::clear_parse_cache();
+    evaluator<T> p;
+    bool result = p.parse_cached("x+1") && p.parse_cached("x+2") && p.parse_cached("x+3");
+    const evaluator_internal::cache_stats all = evaluator<T>::get_parse_cache_stats();
+    result = result && all.entries == 3 && all.misses == 3 && all.bytes <= all.max_bytes;
+
+    // Room for two expressions, "x+1" is used recently, so "x+2" is removed, then "x+1"
+    result = result && p.parse_cached("x+1");
+    evaluator<T>::set_parse_cache_limit(all.bytes * 2 / 3 + 1);
+    result = result && evaluator<T>::get_parse_cache_stats().entries == 2;
+    result = result && p.parse_cached("x+1") && p.parse_cached("x+3") && p.parse_cached("x+2");
+    const evaluator_internal::cache_stats limited = evaluator<T>::get_parse_cache_stats();
+    result = result && limited.hits == 3 && limited.misses == 4 && limited.evictions == 2;
+
+    // Failed expression is not cached
+    result = result && !p.parse_cached("x+") && !p.is_parsed() &&
+             evaluator<T>::get_parse_cache_stats().entries == limited.entries;
+
+    evaluator<T>::set_parse_cache_limit(all.max_bytes);
+    evaluator<T>::clear_parse_cache();
+    return result;
+}
+
+// Literals which differ only beyond 17 digits are not mixed up by cache, parse_cached() gives
+// the same result as cold parse, with and without simplify()
+template<typename T>
+bool cache_digits_check()
+{
+    static const char * const exprs[] =
+    {
+        "x+0.1", "x+0.10000000000000000005", "x*1", "x*1.00000000000000000006", "x*(1/3+1e-19)", "x*(1/3)"
+    };
+    evaluator<T>::clear_parse_cache();
+    bool result = true;
+    for(int simplify = 0; simplify < 2; simplify++)
+    {
+        for(std::size_t i = 0; i < sizeof(exprs) / sizeof(exprs[0]) && result; i++)
+        {
+            evaluator<T> p, q;
+            T rp, rq;
+            result = p.parse_cached(exprs[i], simplify != 0) && q.parse(exprs[i]) && (!simplify || q.simplify());
+            p.set_var("x", static_cast<T>(3));
+            q.set_var("x", static_cast<T>(3));
+            result = result && p.calculate(rp) && q.calculate(rq) && rp == rq;
+        }
+    }
+    evaluator<T>::clear_parse_cache();
+    return result;
+}
+
+// Average time of setup by parse_cached() in ns per formula, 'num_exprs' formulas from 'exprs',
+// the cache is filled before
+template<typename T>
+double parse_cached_latency(const std::vector<std::string> & exprs, std::size_t num_exprs)
+{
+    evaluator<T> p;
+    for(std::size_t i = 0; i < exprs.size(); i++)
+        p.parse_cached(exprs[i]);
+    unsigned long t = mtime();
+    for(std::size_t i = 0; i < num_exprs; i++)
+    {
+        evaluator<T> q;
+        if(!q.parse_cached(exprs[i % exprs.size()]))
+            return 0.0;
+    }
+    t = mtime() - t;
+    evaluator<T>::clear_parse_cache();
+    return static_cast<double>(t) * 1e6 / static_cast<double>(std::max(num_exprs, static_cast<std::size_t>(1)));
+}
+
+// Average time of parsing in ns per formula, 'num_exprs' formulas from 'exprs'
+template<typename T>
+double parse_latency(const std::vector<std::string> & exprs, std::size_t num_exprs)
+{
+    evaluator<T> p;
+    unsigned long t = mtime();
+    for(std::size_t i = 0; i < num_exprs; i++)
+    {
+        if(!p.parse(exprs[i % exprs.size()]))
+            return 0.0;
+    }
+    t = mtime() - t;
+    return static_cast<double>(t) * 1e6 / static_cast<double>(std::max(num_exprs, static_cast<std::size_t>(1)));
+}
+
+// Time of construction and destruction of evaluator in ns, 'num_tests' evaluators
+template<typename T>
+double construct_time(std::size_t num_tests)
+{
+    unsigned long t = mtime();
+    for(std::size_t i = 0; i < num_tests; i++)
+    {
+        evaluator<T> p;
+    }
+    t = mtime() - t;
+    return static_cast<double>(t) * 1e6 / static_cast<double>(std::max(num_tests, static_cast<std::size_t>(1)));
+}
+
+void parse_test(std::size_t num_tests, teestream & tee)
+{
+    std::vector<std::string> exprs;
+    get_all_exprs(exprs);
+    for(std::size_t i = 0; i < 100; i++)
+    {
+        std::stringstream sst;
+        sst << "sin(x*" << i % 7 << ".25)*(y-" << i % 5 << "*2.5e-1)+Pi*abs(z_" << i % 3
+            << "/3,5)-exp(-(x*x+y*y)/2)^2";
+        exprs.push_back(sst.str());
+    }
+
+    const std::size_t num_bytes = num_tests * 2;
+    tee << "Parse\tfloat\tdouble\tcfoat\tcdouble" << std::endl;
+    tee << "MB/s\t";
+    tee << parse_speed<float>(exprs, num_bytes) << "\t";
+    tee << parse_speed<double>(exprs, num_bytes) << "\t";
+    tee << parse_speed<std::complex<float> >(exprs, num_bytes) << "\t";
+    tee << parse_speed<std::complex<double> >(exprs, num_bytes) << std::endl;
+
+    // Corpus of formulas with all builtin functions and constants, mostly name lookups
+    static const char * const funcs[] = { "imag", "real", "conj", "arg", "sin", "cos", "tan", "asin",
+        "acos", "atan", "sinh", "cosh", "tanh", "asinh", "acosh", "atanh", "log", "log2", "log10",
+        "abs", "exp", "sqrt" };
+    static const char * const consts[] = { "pi", "e", "PI", "E" };
+    const std::size_t funcs_num = sizeof(funcs) / sizeof(funcs[0]);
+    const std::size_t consts_num = sizeof(consts) / sizeof(consts[0]);
+    std::vector<std::string> corpus;
+    for(std::size_t i = 0; i < 1000; i++)
+    {
+        std::stringstream sst;
+        sst << funcs[i % funcs_num] << "(x*" << consts[i % consts_num] << ")+"
+            << funcs[(i / funcs_num + i) % funcs_num] << "(" << funcs[(i * 7) % funcs_num] << "(y)-"
+            << consts[(i / consts_num) % consts_num] << ")*" << funcs[(i * 3) % funcs_num] << "(z_" << i % 10 << ")";
+        corpus.push_back(sst.str());
+    }
+    tee << "ns/expr\t";
+    tee << parse_latency<float>(corpus, num_tests) << "\t";
+    tee << parse_latency<double>(corpus, num_tests) << "\t";
+    tee << parse_latency<std::complex<float> >(corpus, num_tests) << "\t";
+    tee << parse_latency<std::complex<double> >(corpus, num_tests) << std::endl;
+    tee << "cached ns/expr\t";
+    tee << parse_cached_latency<float>(corpus, num_tests) << "\t";
+    tee << parse_cached_latency<double>(corpus, num_tests) << "\t";
+    tee << parse_cached_latency<std::complex<float> >(corpus, num_tests) << "\t";
+    tee << parse_cached_latency<std::complex<double> >(corpus, num_tests) << std::endl;
+    tee << "ctor ns\t";
+    tee << construct_time<float>(num_tests) << "\t";
+    tee << construct_time<double>(num_tests) << "\t";
+    tee << construct_time<std::complex<float> >(num_tests) << "\t";
+    tee << construct_time<std::complex<double> >(num_tests) << std::endl;
+
+    tee << "\nParse-Cache\tfloat\tdouble\tcfoat\tcdouble" << std::endl;
+    std::vector<std::string> all_exprs;
+    get_all_exprs(all_exprs);
+    all_exprs.push_back("x*y+x*(y+x*(y+x*(y+x*(y+x*(y+x*(y+x*(y+x*(y+x))))))))");
+    all_exprs.push_back("((x+y)*(x-y))/((x*y+1)*(x/y-1))^2");
+    for(std::size_t i = 0; i < all_exprs.size(); i++)
+    {
+        tee << all_exprs[i] << "\t";
+        tee << (cache_check<float>(all_exprs[i])                  ? "OK\t" : "FAIL\t");
+        tee << (cache_check<double>(all_exprs[i])                 ? "OK\t" : "FAIL\t");
+        tee << (cache_check<std::complex<float> >(all_exprs[i])   ? "OK\t" : "FAIL\t");
+        tee << (cache_check<std::complex<double> >(all_exprs[i])  ? "OK\t" : "FAIL\t");
+        tee << std::endl;
+    }
+    tee << "limit\t";
+    tee << (cache_limit_check<float>()                  ? "OK\t" : "FAIL\t");
+    tee << (cache_limit_check<double>()                 ? "OK\t" : "FAIL\t");
+    tee << (cache_limit_check<std::complex<float> >()   ? "OK\t" : "FAIL\t");
+    tee << (cache_limit_check<std::complex<double> >()  ? "OK\t" : "FAIL\t");
+    tee << std::endl;
+    tee << "digits\t";
+    tee << (cache_digits_check<float>()                  ? "OK\t" : "FAIL\t");
+    tee << (cache_digits_check<double>()                 ? "OK\t" : "FAIL\t");
+    tee << (cache_digits_check<std::complex<float> >()   ? "OK\t" : "FAIL\t");
+    tee << (cache_digits_check<std::complex<double> >()  ? "OK\t" : "FAIL\t");
+    tee << std::endl;
+    tee << "digits, long double\t-\t";
+    tee << (cache_digits_check<long double>()            ? "OK\t" : "FAIL\t");
+    tee << "-\t-\t" << std::endl;
+}
+
+// Vector kernel with function 'name', see vector_kernels.h
+template<typename T>
+void (EVALUATOR_JIT_CALL * get_kernel(const std::string & name))(T *, std::size_t)
+{
+    void (EVALUATOR_JIT_CALL * kernel)(T *, std::size_t) = NULL;
+    const void * address = evaluator_internal_jit::vector_func_kernel(name, T());
+    memcpy(& kernel, & address, sizeof(void *));
+    return kernel;
+}
+
+// Scalar SSE2 kernel with function 'name', see sse_kernels.h
+template<typename T>
+T (EVALUATOR_JIT_CALL * get_sse_kernel(const std::string & name))(T)
+{
+    T (EVALUATOR_JIT_CALL * kernel)(T) = NULL;
+    const void * address = evaluator_internal_jit::sse_func_kernel(name, T());
+    memcpy(& kernel, & address, sizeof(void *));
+    return kernel;
+}
+
+// Test domains of kernels: name, min |x|, max |x|, negative values, max ULP for float and double
+struct kernel_domain
+{
+    const char * name;
+    double min_abs, max_abs;
+    bool negative;
+    double ulp_f, ulp_d;
+};
+
+const kernel_domain kernel_domains[] =
+{
+    { "sin",   0.0,  100.0, true,  1.0, 2.0 },
+    { "cos",   0.0,  100.0, true,  1.0, 2.0 },
+    { "tan",   0.0,  100.0, true,  1.0, 3.0 },
+    { "asin",  0.0,  1.0,   true,  1.0, 5.0 },
+    { "acos",  0.0,  1.0,   true,  1.0, 5.0 },
+    { "atan",  0.0,  100.0, true,  1.0, 4.0 },
+    { "sinh",  0.0,  20.0,  true,  1.0, 4.0 },
+    { "cosh",  0.0,  20.0,  true,  1.0, 4.0 },
+    { "tanh",  0.0,  5.0,   true,  1.0, 3.0 },
+    { "asinh", 0.5,  100.0, true,  1.0, 2.0 },
+    { "acosh", 1.01, 100.0, false, 1.0, 2.0 },
+    { "atanh", 0.1,  0.99,  true,  1.0, 3.0 },
+    { "log",   0.0,  100.0, false, 1.0, 1.0 },
+    { "log2",  0.0,  100.0, false, 1.0, 2.0 },
+    { "log10", 0.0,  100.0, false, 1.0, 2.0 },
+    { "exp",   0.0,  50.0,  true,  1.0, 1.0 },
+    { "arg",   0.0,  1.0,   true,  1.0, 1.0 }
+};
+
+// Reference value in long double precision
+long double kernel_reference(const std::string & name, long double x)
+{
+    using namespace evaluator_internal;
+    typedef long double L;
+    if(name == "sin")   return std::sin(x);
+    if(name == "cos")   return std::cos(x);
+    if(name == "tan")   return std::tan(x);
+    if(name == "asin")  return std::asin(x);
+    if(name == "acos")  return std::acos(x);
+    if(name == "atan")  return std::atan(x);
+    if(name == "sinh")  return std::sinh(x);
+    if(name == "cosh")  return std::cosh(x);
+    if(name == "tanh")  return std::tanh(x);
+    if(name == "asinh") return eval_asinh<L>(x);
+    if(name == "acosh") return eval_acosh<L>(x);
+    if(name == "atanh") return eval_atanh<L>(x);
+    if(name == "log")   return std::log(x);
+    if(name == "log2")  return eval_log2<L>(x);
+    if(name == "log10") return std::log10(x);
+    if(name == "exp")   return std::exp(x);
+    if(name == "arg")   return eval_arg<L>(x);
+    return 0;
+}
+
+// Error of 'value' in ULP of type T
+template<typename T>
+double ulp_error(T value, long double reference)
+{
+    const T ref = static_cast<T>(reference);
+    if(value != value || ref != ref)
+        return (value != value && ref != ref) ? 0.0 : 1e30;
+    if(ref == 0)
+        return value == 0 ? 0.0 : 1e30;
+    int e;
+    std::frexp(static_cast<double>(ref), & e);
+    const double ulp = std::ldexp(1.0, e - std::numeric_limits<T>::digits);
+    return static_cast<double>(std::abs(static_cast<long double>(value) - reference) / ulp);
+}
+
+// Max error of vector kernel (or of scalar SSE2 kernel if 'sse' is true) in ULP for all points of 'domain'
+template<typename T>
+double kernel_max_ulp(const kernel_domain & domain, std::size_t num_points, bool sse)
+{
+    void (EVALUATOR_JIT_CALL * kernel)(T *, std::size_t) = get_kernel<T>(domain.name);
+    T (EVALUATOR_JIT_CALL * sse_kernel)(T) = get_sse_kernel<T>(domain.name);
+    if(sse ? !sse_kernel : !kernel)
+        return 1e30;
+    std::vector<T> xs(num_points), rs(num_points);
+    for(std::size_t i = 0; i < num_points; i++)
+    {
+        xs[i] = static_cast<T>(rand_uniform(domain.min_abs, domain.max_abs));
+        if(domain.negative && (i & 1))
+            xs[i] = -xs[i];
+    }
+    if(sse)
+    {
+        for(std::size_t i = 0; i < num_points; i++)
+            rs[i] = sse_kernel(xs[i]);
+    }
+    else
+    {
+        rs = xs;
+        kernel(& rs[0], num_points);
+    }
+    double max_ulp = 0;
+    for(std::size_t i = 0; i < num_points; i++)
+        max_ulp = std::max(max_ulp, ulp_error(rs[i], kernel_reference(domain.name, xs[i])));
+    return max_ulp;
+}
+
+void kernels_test(teestream & tee)
+{
+    const std::size_t num_points = 100000;
+    tee << "Kernel-Checks\tfloat\tdouble\tsse(f)\tsse(d)\tULP(f)\tULP(d)" << std::endl;
+    for(std::size_t i = 0; i < sizeof(kernel_domains) / sizeof(kernel_domains[0]); i++)
+    {
+        const kernel_domain & domain = kernel_domains[i];
+        srand(1);
+        const double ulp_f = kernel_max_ulp<float>(domain, num_points, false);
+        const double ulp_d = kernel_max_ulp<double>(domain, num_points, false);
+        srand(1);
+        const double sse_f = kernel_max_ulp<float>(domain, num_points, true);
+        const double sse_d = kernel_max_ulp<double>(domain, num_points, true);
+        tee << domain.name << "\t";
+        tee << (ulp_f <= domain.ulp_f ? "OK\t" : "FAIL\t");
+        tee << (ulp_d <= domain.ulp_d ? "OK\t" : "FAIL\t");
+        tee << (sse_f <= domain.ulp_f ? "OK\t" : "FAIL\t");
+        tee << (sse_d <= domain.ulp_d ? "OK\t" : "FAIL\t");
+        tee << std::max(ulp_f, sse_f) << "\t" << std::max(ulp_d, sse_d) << std::endl;
+    }
+}
+
+// Time of kernel and of interpreter function for 'num_tests' values
+template<typename T>
+void benchmark_kernel(const kernel_domain & domain, std::size_t num_tests, unsigned long & t_kernel, unsigned long & t_libm)
+{
+    const std::size_t block_size = 1000;
+    void (EVALUATOR_JIT_CALL * kernel)(T *, std::size_t) = get_kernel<T>(domain.name);
+    T(* func)(const T &) = evaluator_internal::registry<T>::shared().functions.find(domain.name)->value;
+
+    std::vector<T> xs(block_size), rs(block_size);
+    for(std::size_t i = 0; i < block_size; i++)
+        xs[i] = static_cast<T>(rand_uniform(domain.min_abs, domain.max_abs));
+
+    t_kernel = mtime();
+    for(std::size_t k = 0; k < num_tests; k += block_size)
+    {
+        rs = xs;
+        kernel(& rs[0], std::min(block_size, num_tests - k));
+    }
+    t_kernel = mtime() - t_kernel;
+
+    t_libm = mtime();
+    for(std::size_t k = 0; k < num_tests; k += block_size)
+    {
+        rs = xs;
+        for(std::size_t i = 0, i_end = std::min(block_size, num_tests - k); i < i_end; i++)
+            rs[i] = func(rs[i]);
+    }
+    t_libm = mtime() - t_libm;
+}
+
+void benchmark_kernels(std::size_t num_tests, teestream & tee)
+{
+    tee << "Kernels\tfloat\tlibm(f)\tdouble\tlibm(d)" << std::endl;
+    srand(1);
+    for(std::size_t i = 0; i < sizeof(kernel_domains) / sizeof(kernel_domains[0]); i++)
+    {
+        const kernel_domain & domain = kernel_domains[i];
+        unsigned long t_kernel, t_libm;
+        tee << domain.name << "\t";
+        benchmark_kernel<float>(domain, num_tests, t_kernel, t_libm);
+        tee << t_kernel << "\t" << t_libm << "\t";
+        benchmark_kernel<double>(domain, num_tests, t_kernel, t_libm);
+        tee << t_kernel << "\t" << t_libm << std::endl;
+    }
+}
+
 double rand_uniform(double a, double b)
 {
     double alpha1 = static_cast<double>(rand()) / static_cast<double>(RAND_MAX);
@@ -13,25 +13,66 @@ HEADERS += \
     evaluator/evaluator_operations.h \
     evaluator/evaluator_internal/type_detection.h \
     evaluator/evaluator_internal/evaluator_object.h \
-    evaluator/evaluator_internal/var_container.h \
+    evaluator/evaluator_internal/var_table.h \
+    evaluator/evaluator_internal/name_table.h \
+    evaluator/evaluator_internal/bytecode.h \
+    evaluator/evaluator_internal/cse.h \
+    evaluator/evaluator_internal/program.h \
+    evaluator/evaluator_internal/token.h \
+    evaluator/evaluator_internal/flat_table.h \
+    evaluator/evaluator_internal/lock.h \
+    evaluator/evaluator_internal/cow_ref.h \
+    evaluator/evaluator_internal/registry.h \
+    evaluator/evaluator_internal/lru_cache.h \
+    evaluator/evaluator_internal/parse_cache.h \
     evaluator/evaluator_internal/transition_table.h \
     evaluator/evaluator_internal/misc.h \
     evaluator/evaluator_internal/parse.h \
     evaluator/evaluator_internal/simplify.h \
+    evaluator/evaluator_internal/reorder.h \
+    evaluator/evaluator_internal/canonical.h \
     evaluator/evaluator_internal/calculate.h \
     evaluator/evaluator_internal/jit/common.h \
+    evaluator/evaluator_internal/jit/code_arena.h \
     evaluator/evaluator_internal/jit/opcodes.h \
+    evaluator/evaluator_internal/jit/opcodes_sse.h \
+    evaluator/evaluator_internal/jit/opcodes_avx.h \
     evaluator/evaluator_internal/jit/func_templates.h \
     evaluator/evaluator_internal/jit/oper_templates.h \
     evaluator/evaluator_internal/jit/real_templates.h \
+    evaluator/evaluator_internal/jit/sse_kernels.h \
+    evaluator/evaluator_internal/jit/vector_kernels.h \
+    evaluator/evaluator_internal/jit/approx_math.h \
     evaluator/evaluator_internal/jit/complex_templates.h \
+    evaluator/evaluator_internal/jit/reg_alloc.h \
     evaluator/evaluator_internal/jit/compile_inline.h \
-    evaluator/evaluator_internal/jit/compile_extcall.h
+    evaluator/evaluator_internal/jit/compile_extcall.h \
+    evaluator/evaluator_internal/jit/compile_batch.h \
+    evaluator/evaluator_internal/jit/compile_sse2.h \
+    evaluator/evaluator_internal/jit/compile_simd.h
 
 SOURCES += \
     evaluator/evaluator_internal/transition_table.cpp \
+    evaluator/evaluator_internal/lock.cpp \
     evaluator/evaluator_internal/jit/common.cpp \
+    evaluator/evaluator_internal/jit/code_arena.cpp \
     evaluator/evaluator_internal/jit/func_templates.cpp \
     evaluator/evaluator_internal/jit/oper_templates.cpp \
     evaluator/evaluator_internal/jit/real_templates.cpp \
+    evaluator/evaluator_internal/jit/sse_kernels.cpp \
     main.cpp
+
+VECTOR_SOURCES = evaluator/evaluator_internal/jit/vector_kernels.cpp
+
+# Vectorization of software kernels: sqrt without errno, branches without traps
+*g++*|*clang* {
+    vector_kernels.name = vector_kernels
+    vector_kernels.input = VECTOR_SOURCES
+    vector_kernels.dependency_type = TYPE_C
+    vector_kernels.variable_out = OBJECTS
+    vector_kernels.output = ${QMAKE_VAR_OBJECTS_DIR}${QMAKE_FILE_IN_BASE}$${first(QMAKE_EXT_OBJ)}
+    vector_kernels.commands = $${QMAKE_CXX} $(CXXFLAGS) -fno-math-errno -fno-trapping-math $(INCPATH) -c ${QMAKE_FILE_IN} -o ${QMAKE_FILE_OUT}
+    QMAKE_EXTRA_COMPILERS += vector_kernels
+} else {
+    SOURCES += $$VECTOR_SOURCES
+}
@@ -33,7 +33,13 @@
 
 #include "evaluator_operations.h"
 #include "evaluator_internal/evaluator_object.h"
-#include "evaluator_internal/var_container.h"
+#include "evaluator_internal/var_table.h"
+#include "evaluator_internal/name_table.h"
+#include "evaluator_internal/bytecode.h"
+#include "evaluator_internal/cse.h"
+#include "evaluator_internal/program.h"
+#include "evaluator_internal/registry.h"
+#include "evaluator_internal/lru_cache.h"
 #include "evaluator_internal/transition_table.h"
 #include "evaluator_internal/jit/common.h"
 #include "evaluator_internal/jit/opcodes.h"
@@ -58,18 +64,16 @@ public:
 
 protected:
 
-    // State transition table
-    std::vector<evaluator_internal::transition_table_record> m_transition_table;
-    // Expression, Reverse Polish notation
-    std::vector<evaluator_internal::evaluator_object<T> > m_expression;
-    // Container: [function name]->function pointer
-    std::map<std::string, func_type> m_functions;
-    // Container: [variable name]->pointer to var_container
-    std::map<std::string, evaluator_internal::var_container<T> > m_variables;
-    // Container: [constant name]->constant value
-    std::map<std::string, T> m_constants;
-    // Container: [operator name]->pair(priority, operator pointer)
-    std::map<char, std::pair<unsigned short int, oper_type> > m_operators;
+    // Expression, its constants, bytecode and plan of common subexpressions, shared by copies
+    evaluator_internal::cow_ref<evaluator_internal::program<T> > m_program;
+    // Builtin functions, operators and constants, shared by all evaluators until own_registry()
+    evaluator_internal::cow_ref<evaluator_internal::registry<T> > m_registry;
+    // Slot table of variables: [variable index]->value, indices are handles of variables
+    evaluator_internal::var_table<T> m_variables;
+    // Evaluation stack of interpreter, its size is maximum depth for current expression
+    std::vector<T> m_calc_stack;
+    // Values of common subexpressions, written during evaluation
+    std::vector<T> m_cse_values;
     // Current parsing status: true is good, false is bad
     bool m_status;
     // Error description if m_status == false
@@ -78,29 +82,160 @@ protected:
     // Current compiling status: true is compiled, false is not compiled
     bool m_is_compiled;
 #if !defined(EVALUATOR_JIT_DISABLE)
-    // Executable memory for bytecode
+    // Compiled code, block of process-wide code arena
     char * volatile m_jit_code;
     // Function pointer to same memory
     void(EVALUATOR_JIT_CALL * m_jit_func)();
-    // Size of allocated executable memory
+    // Size of code arena block
     std::size_t m_jit_code_size;
     // Memory for stack, used in compiled code
     T * volatile m_jit_stack;
     // Size of allocated memory for stack
     std::size_t m_jit_stack_size;
+    // Compiled code is a loop over points, see calculate_batch()
+    bool m_jit_batch;
+    // Batch mode: number of points, decremented by compiled code
+    std::size_t m_jit_batch_size;
+    // Batch mode: names of variables, which are used in compiled code
+    std::vector<std::string> m_jit_batch_names;
+    // Batch mode: indices of these variables
+    std::vector<std::size_t> m_jit_batch_slots;
+    // Batch mode: pointers to current input values, advanced by compiled code
+    std::vector<const T *> m_jit_batch_args;
+    // Batch mode: steps of input pointers in bytes, 0 for unbound variables
+    std::vector<std::size_t> m_jit_batch_steps;
+    // Batch mode: pointer to current result, advanced by compiled code
+    T * m_jit_batch_result;
+    // Batch mode: number of points per iteration of compiled loop, 1 for scalar code
+    std::size_t m_jit_batch_lanes;
+    // Batch mode: broadcast values of unbound variables and padded tail points for vector code
+    std::vector<T> m_jit_batch_buffer;
+    // Compiled code is a reentrant kernel, see compile_kernel()
+    bool m_jit_kernel;
+    // Kernel mode: names of variables in order of 'vars' argument
+    std::vector<std::string> m_jit_kernel_names;
+    // Kernel mode: indices of these variables
+    std::vector<std::size_t> m_jit_kernel_slots;
+    // Kernel mode: values of these variables, passed by calculate()
+    std::vector<T> m_jit_kernel_values;
+    // Kernel mode: number of values in 'scratch' argument
+    std::size_t m_jit_kernel_scratch_size;
+    // Compile function of current compiled code and its argument, copies are compiled by it,
+    // except kernels, which are shared
+    bool (evaluator::* m_jit_compiler)(bool);
+    bool m_jit_compiler_arg;
+
+    // Copy generated code [code_begin, code_end) to code arena, previous code is released
+    bool jit_install(const char * code_begin, const char * code_end);
+    // Return compiled code to code arena
+    void jit_release();
+    // Allocate memory for stack of compiled code
+    void jit_stack_init();
+    // Prepare batch mode data, if 'batch' is true, kernel mode is reset
+    void jit_batch_init(bool batch);
+    // Batch mode: index of variable with value 'slot'
+    std::size_t jit_batch_index(std::size_t slot) const;
+    // Push value of constant or variable 'obj' to FPU stack
+    void jit_fld_object(char *& code_curr, const evaluator_internal::evaluator_object<T> & obj);
+    // Copy value at 'src' to 'dst'
+    void jit_copy_value(char *& code_curr, const T * src, const T * dst);
+    // Copy complex value of constant or variable 'obj' to 'dst'
+    void jit_copy_object(char *& code_curr, const evaluator_internal::evaluator_object<T> & obj, const T * dst);
+    // Batch mode: store result and jump to the next point
+    void jit_batch_loop(char *& code_curr, char * loop_begin);
+    // Batch mode: advance all pointers and jump to the next point
+    void jit_batch_next(char *& code_curr, char * loop_begin);
+    // Load value of constant or variable 'obj' to register xmm[reg]
+    void jit_movs_object(char *& code_curr, int reg, const evaluator_internal::evaluator_object<T> & obj);
+    // Load value of constant or variable 'obj' to all elements of vector register 'reg'
+    void jit_avx_object(char *& code_curr, int l, int reg, const evaluator_internal::evaluator_object<T> & obj);
+    // Compile expression to scalar SSE2 code, see compile_sse2() and compile_kernel()
+    bool jit_compile_sse2(bool batch, bool kernel);
+    // Kernel mode: call kernel with current values of variables
+    void jit_kernel_run(T & result);
+    // Share reentrant kernel of 'other', previous compiled code is released
+    void jit_share_kernel(const evaluator & other);
+    // Batch mode: run compiled loop for 'n' points
+    void jit_batch_run(std::size_t n, const std::map<std::string, const T *> & bindings, T * result);
 #endif
 
-    // Return incorrect big number (uninitialized variable)
-    template<typename U> T incorrect_number(const std::complex<U> &) const;
-    template<typename U> T incorrect_number(const U &) const;
-    // Check whether a number is incorrect (uninitialized variable)
-    template<typename U> bool is_incorrect(const std::complex<U> & val) const;
-    template<typename U> bool is_incorrect(const U & val) const;
+    // Check that all variables of current expression have values, once per calculation
+    bool check_vars();
+    // Prepare interpreter for current expression: bytecode and evaluation stack
+    void calc_init();
+    // Calculate current expression by bytecode interpreter, without allocations of memory,
+    // NULL 'result' only links handlers to bytecode, see calc_init()
+    bool calculate_rpn(T * result);
+    // Strength reduction of powers and divisions by constants, see simplify()
+    void reduce_strength();
+    // Find common subexpressions of current expression and make its plan, see simplify()
+    void cse_init();
+    // Action for object 'it' of current expression, see cse_init()
+    inline evaluator_internal::cse_action cse_action_at(
+            typename std::vector<evaluator_internal::evaluator_object<T> >::const_iterator it) const
+    {
+        const evaluator_internal::program<T> & prog = * m_program;
+        return prog.cse_plan.empty() ? evaluator_internal::cse_action() : prog.cse_plan[it - prog.expression.begin()];
+    }
+
+    // Make objects of program 'prog', their names are interned
+    evaluator_internal::evaluator_object<T> make_constant(evaluator_internal::program<T> & prog,
+                                                          const std::string & str, const T & value);
+    evaluator_internal::evaluator_object<T> make_variable(evaluator_internal::program<T> & prog,
+                                                          const std::string & name);
+    evaluator_internal::evaluator_object<T> make_function(evaluator_internal::program<T> & prog,
+                                                          const std::string & name, func_type func);
+    evaluator_internal::evaluator_object<T> make_operator(evaluator_internal::program<T> & prog,
+                                                          const std::string & name, oper_type oper);
+    // Get string representation of object
+    inline const std::string & obj_str(const evaluator_internal::evaluator_object<T> & obj) const
+    {
+        return m_program->names[obj.name()];
+    }
+    // Get pointer to value of variable or constant
+    inline const T * obj_value(const evaluator_internal::evaluator_object<T> & obj) const
+    {
+        return obj.is_variable() ? (m_variables.data() + obj.index()) : (& m_program->const_values[obj.index()]);
+    }
+    // Get value of variable or constant
+    inline T obj_eval(const evaluator_internal::evaluator_object<T> & obj) const
+    {
+        return * obj_value(obj);
+    }
 
+    // Own copy of builtin functions, operators and constants for customization by derived classes,
+    // shared builtins are not changed. Customized functions are called by bytecode and compile_extcall(),
+    // compile_inline() and SSE2 code inline builtins by name, parse_cached() doesn't use cache
+    inline evaluator_internal::registry<T> & own_registry()
+    {
+        return m_registry.write();
+    }
+    // Add or replace function 'name' of own builtins, names are case insensitive
+    void set_function(const std::string & name, func_type func);
+    // Add or replace named constant 'name' of own builtins, names are case insensitive
+    void set_constant(const std::string & name, const T & value);
     // Primary initialization
     void init();
-    // Copying from another evaluator
+    // Index of variable with name 'name', new variable is created without value,
+    // compiled code with addresses of variables is reset if slot table is moved
+    std::size_t var_index(const std::string & name);
+    // Copying from another evaluator: program and reentrant kernel are shared,
+    // other compiled code is compiled anew for own variables
     void copy_from_other(const evaluator & other);
+    // Copy parsed expression of 'other', its variables are found by names among variables of this evaluator,
+    // reentrant kernel of 'other' is shared
+    void copy_program(const evaluator & other);
+    // Memory of parsed expression in bytes, estimated
+    std::size_t program_bytes() const;
+    // Process-wide cache of parse_cached(): [canonical expression]->evaluator with parsed expression
+    static evaluator_internal::lru_cache<evaluator> & parse_cache();
+    // Process-wide cache of parse_cached(): [normalized expression]->canonical expression
+    static evaluator_internal::lru_cache<std::string> & parse_cache_aliases();
+    // Structure of current expression: subtree of i-th object is [begin[i], i], its hash is hash[i],
+    // operands of i-th object are emitted in reversed order in canonical form if swap[i] is true
+    bool structure(std::vector<std::size_t> & begin, std::vector<std::size_t> & hash, std::vector<bool> & swap) const;
+    // Text of current expression in canonical form, see canonicalize()
+    std::string canonical_text() const;
 
 public:
 
@@ -127,17 +262,68 @@ public:
     // Set new value 'value' for variable with name 'name'
     inline void set_var(const std::string & name, const T & value)
     {
-        m_variables[name].value() = value;
+        m_variables.set(var_index(name), value);
+    }
+
+    // Stable handle of variable, valid until destruction of evaluator, survives parse(),
+    // simplify() and reset_vars(), copies of evaluator have the same handles
+    typedef std::size_t var_handle;
+    // Get handle of variable with name 'name', variable is created if it doesn't exist
+    var_handle get_var_handle(const std::string & name);
+    // Set new value 'value' for variable with handle 'handle', O(1) time
+    inline void set(var_handle handle, const T & value)
+    {
+        m_variables.set(handle, value);
     }
 
     // Reset all variables
     void reset_vars();
     // Parse string 'str'
     bool parse(const std::string & str);
-    // Simplify current expression
+    // Parse string 'str' by process-wide cache of parsed expressions, the cache keeps the result of
+    // simplify() if 'simplify' is true and of compile_kernel() if 'kernel' is true, so a repeated
+    // expression is neither parsed nor compiled again, expression is in canonical form, so expressions
+    // which differ by order of operands of "+" and "*" share compiled kernel
+    bool parse_cached(const std::string & str, bool simplify = false, bool kernel = false);
+    // Limit of memory of cache of parse_cached() in bytes, least recently used expressions are removed
+    static void set_parse_cache_limit(std::size_t max_bytes);
+    // Statistics of cache of parse_cached(), for canonical forms of expressions
+    static evaluator_internal::cache_stats get_parse_cache_stats();
+    // Remove all expressions from cache of parse_cached()
+    static void clear_parse_cache();
+    // Simplify current expression, small integer powers become multiplications, complex x^0.5 becomes sqrt(x),
+    // divisions by powers of two become multiplications, common subexpressions will be evaluated once
     bool simplify();
+    // Reorder operands of commutative operators to minimize depth of evaluation stack,
+    // optional step after simplify()
+    bool minimize_stack();
+    // Bring current expression to canonical form: operands of commutative operators are sorted, constants
+    // are named by their values, so expressions which differ only by that become equal, results are the same
+    bool canonicalize();
+    // Get hash of structure of current expression, the same for expressions with the same canonical form,
+    // stable between runs, so it may be used as key of caches
+    std::size_t structural_hash() const;
+    // Get maximum depth of evaluation stack for current expression
+    std::size_t stack_depth() const;
+    // Get number of objects of current expression
+    inline std::size_t expression_size() const
+    {
+        return m_program->expression.size();
+    }
+    // Get number of objects of current expression which are not evaluated,
+    // because equal subexpression is evaluated before, see simplify()
+    inline std::size_t eliminated_size() const
+    {
+        return m_program->cse_removed;
+    }
+    // Get number of instructions of interpreter for current expression, superinstructions are counted once
+    std::size_t bytecode_size() const;
     // Calculate current expression and write result to 'result'
     bool calculate(T & result);
+    // Calculate current expression in 'n' points and write results to array 'result',
+    // 'bindings' is container: [variable name]->array of 'n' values,
+    // names must be variables of expression or be set by set_var()
+    bool calculate_batch(std::size_t n, const std::map<std::string, const T *> & bindings, T * result);
 
     // Get current compiling status
     inline bool is_compiled() const
@@ -145,15 +331,37 @@ public:
         return m_is_compiled;
     }
 
-    // Compile expression, all functions will be inlined
-    bool compile_inline();
-    // Compile expression, all functions will be called from 'functions' and 'operators' containers
-    bool compile_extcall();
+    // Compile expression, all functions will be inlined,
+    // if 'batch' is true, the code will be a loop over all points of calculate_batch()
+    bool compile_inline(bool batch = false);
+    // Compile expression, all functions will be called from 'functions' and 'operators' containers,
+    // if 'batch' is true, the code will be a loop over all points of calculate_batch()
+    bool compile_extcall(bool batch = false);
+    // Compile expression to scalar SSE2 code, float and double types only,
+    // if 'batch' is true, the code will be a loop over all points of calculate_batch()
+    bool compile_sse2(bool batch = false);
+    // Compile expression to vector AVX2 or AVX-512 code, float and double types only,
+    // the code is a loop over all points of calculate_batch(), several points per iteration,
+    // AVX-512 is used if 'avx512' is true and CPU supports it
+    bool compile_simd(bool avx512 = true);
+    // Reentrant kernel: 'vars' are values of variables in order of get_kernel_vars(),
+    // 'scratch' is memory for get_kernel_scratch_size() values, result is written to 'out'
+    typedef void (EVALUATOR_JIT_CALL * kernel_type)(const T * vars, T * scratch, T * out);
+    // Compile expression to reentrant scalar SSE2 kernel, float and double types only, x64 only,
+    // the kernel may be called from several threads at once, each thread with its own scratch memory
+    bool compile_kernel();
+    // Compiled reentrant kernel, NULL if expression is not compiled by compile_kernel(),
+    // the kernel is valid until recompilation or destruction of evaluator
+    kernel_type get_kernel() const;
+    // Names of variables in order of 'vars' argument of kernel
+    const std::vector<std::string> & get_kernel_vars() const;
+    // Number of values in 'scratch' argument of kernel
+    std::size_t get_kernel_scratch_size() const;
     // Compile expression, default
-    inline bool compile()
+    inline bool compile(bool batch = false)
     {
-        //return compile_extcall();
-        return compile_inline();
+        //return compile_extcall(batch);
+        return compile_inline(batch);
     }
 
     // Print expression
@@ -162,10 +370,16 @@ public:
 
 #include "evaluator_internal/misc.h"
 #include "evaluator_internal/parse.h"
+#include "evaluator_internal/parse_cache.h"
 #include "evaluator_internal/simplify.h"
+#include "evaluator_internal/reorder.h"
+#include "evaluator_internal/canonical.h"
 #include "evaluator_internal/calculate.h"
 #include "evaluator_internal/jit/compile_inline.h"
 #include "evaluator_internal/jit/compile_extcall.h"
+#include "evaluator_internal/jit/compile_batch.h"
+#include "evaluator_internal/jit/compile_sse2.h"
+#include "evaluator_internal/jit/compile_simd.h"
 
 #endif // EVALUATOR_H
 
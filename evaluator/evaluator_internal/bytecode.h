@@ -0,0 +1,145 @@
+#if !defined(EVALUATOR_BYTECODE_H)
+#define EVALUATOR_BYTECODE_H
+
+#include <cstddef>
+#include "../evaluator_operations.h"
+
+// Bytecode of interpreter: RPN expression with specialized opcodes for operators
+// and builtin functions, so the interpreter doesn't call them through pointers.
+// Loads of operands followed by arithmetic operator are fused into superinstructions.
+// GCC and Clang dispatch opcodes by computed goto to handlers (direct threading),
+// other compilers by switch, define EVALUATOR_BYTECODE_SWITCH to use switch always.
+
+#if defined(__GNUC__) && !defined(EVALUATOR_BYTECODE_SWITCH)
+    #define EVALUATOR_BYTECODE_THREADED
+#endif
+
+// Builtin functions with own opcodes: X(opcode suffix, name of eval_ function)
+#define EVALUATOR_BYTECODE_FUNCTIONS(X) \
+    X(IMAG,  imag)  \
+    X(REAL,  real)  \
+    X(CONJ,  conj)  \
+    X(ARG,   arg)   \
+    X(SIN,   sin)   \
+    X(COS,   cos)   \
+    X(TAN,   tan)   \
+    X(ASIN,  asin)  \
+    X(ACOS,  acos)  \
+    X(ATAN,  atan)  \
+    X(SINH,  sinh)  \
+    X(COSH,  cosh)  \
+    X(TANH,  tanh)  \
+    X(ASINH, asinh) \
+    X(ACOSH, acosh) \
+    X(ATANH, atanh) \
+    X(LOG,   log)   \
+    X(LOG2,  log2)  \
+    X(LOG10, log10) \
+    X(ABS,   abs)   \
+    X(EXP,   exp)   \
+    X(SQRT,  sqrt)
+
+// Operators with superinstructions: X(opcode suffix, operator), for each of them
+// OP_VV, OP_VC, OP_CV and OP_CC push result for variable (V) and constant (C) operands,
+// OP_SV and OP_SC replace top of stack by result for top of stack (S) and operand
+#define EVALUATOR_BYTECODE_FUSED(X) \
+    X(ADD, +) \
+    X(SUB, -) \
+    X(MUL, *) \
+    X(DIV, /)
+
+namespace evaluator_internal
+{
+
+// Opcodes of bytecode, table of handlers in interpreter has the same order
+enum bc_opcode
+{
+    BC_CONST,
+    BC_VAR,
+    BC_ADD,
+    BC_SUB,
+    BC_MUL,
+    BC_DIV,
+    BC_POW,
+#define EVALUATOR_BYTECODE_ENUM(OP, NAME) BC_##OP,
+    EVALUATOR_BYTECODE_FUNCTIONS(EVALUATOR_BYTECODE_ENUM)
+#undef EVALUATOR_BYTECODE_ENUM
+    BC_FUNC,
+    BC_OPER,
+    // Common subexpressions: push temporary, copy top of stack to temporary
+    BC_TEMP,
+    BC_STORE,
+#define EVALUATOR_BYTECODE_ENUM(OP, SYM) \
+    BC_##OP##_VV, BC_##OP##_VC, BC_##OP##_CV, BC_##OP##_CC, BC_##OP##_SV, BC_##OP##_SC,
+    EVALUATOR_BYTECODE_FUSED(EVALUATOR_BYTECODE_ENUM)
+#undef EVALUATOR_BYTECODE_ENUM
+    BC_END
+};
+
+// Instruction of bytecode
+template<typename T> struct bc_instr
+{
+    // Opcode
+    bc_opcode op;
+    // Direct threading: address of handler of opcode in interpreter, set on first run
+    const void * target;
+    // Operand: index of constant, variable or temporary, pointer to function (BC_FUNC) or operator (BC_OPER),
+    // for superinstructions index of left operand, or of right one if left is on stack
+    union
+    {
+        std::size_t index;
+        T(* func)(const T &);
+        T(* oper)(const T &, const T &);
+    } arg;
+    // Index of right operand of superinstructions with two operands
+    std::size_t arg2;
+};
+
+// Opcode for operator 'oper', BC_OPER if it has no own opcode
+template<typename T>
+bc_opcode bc_oper_opcode(T(* oper)(const T &, const T &))
+{
+    // Overloads are resolved the same way as in init_operators()
+    T(* f)(const T &, const T &);
+    if(oper == (f = eval_plus))  return BC_ADD;
+    if(oper == (f = eval_minus)) return BC_SUB;
+    if(oper == (f = eval_mult))  return BC_MUL;
+    if(oper == (f = eval_div))   return BC_DIV;
+    if(oper == (f = eval_pow))   return BC_POW;
+    return BC_OPER;
+}
+
+// Opcode for function 'func', BC_FUNC if it has no own opcode
+template<typename T>
+bc_opcode bc_func_opcode(T(* func)(const T &))
+{
+    // Overloads are resolved the same way as in init_functions()
+    T(* f)(const T &);
+#define EVALUATOR_BYTECODE_FUNC_CHECK(OP, NAME) \
+    if(func == (f = eval_##NAME)) return BC_##OP;
+    EVALUATOR_BYTECODE_FUNCTIONS(EVALUATOR_BYTECODE_FUNC_CHECK)
+#undef EVALUATOR_BYTECODE_FUNC_CHECK
+    return BC_FUNC;
+}
+
+// Superinstruction of operator opcode 'op' for loads 'left' and 'right' (BC_CONST or BC_VAR),
+// any other 'left' means that left operand is on stack, 'op' itself if there is no superinstruction
+inline bc_opcode bc_fused_opcode(bc_opcode op, bc_opcode left, bc_opcode right)
+{
+    switch(op)
+    {
+#define EVALUATOR_BYTECODE_FUSED_CASE(OP, SYM) \
+    case BC_##OP: \
+        if(left == BC_VAR)   return right == BC_VAR ? BC_##OP##_VV : BC_##OP##_VC; \
+        if(left == BC_CONST) return right == BC_VAR ? BC_##OP##_CV : BC_##OP##_CC; \
+        return right == BC_VAR ? BC_##OP##_SV : BC_##OP##_SC;
+    EVALUATOR_BYTECODE_FUSED(EVALUATOR_BYTECODE_FUSED_CASE)
+#undef EVALUATOR_BYTECODE_FUSED_CASE
+    default:
+        return op;
+    }
+}
+
+} // namespace evaluator_internal
+
+#endif // EVALUATOR_BYTECODE_H
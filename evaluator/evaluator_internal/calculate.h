@@ -1,86 +1,395 @@
 #if !defined(EVALUATOR_CALCULATE_H)
 #define EVALUATOR_CALCULATE_H
 
-#include <stack>
+#include <vector>
+#include <map>
+#include <utility>
 #include <string>
 #include <cstring>
 #include <cstdlib>
 #include <sstream>
+#include <algorithm>
+#include "bytecode.h"
 #include "../evaluator.h"
 
-// Calculate current expression and write result to 'result'
+// Prepare interpreter for current expression: bytecode and evaluation stack
 template<typename T>
-bool evaluator<T>::calculate(T & result)
+void evaluator<T>::calc_init()
+{
+    using namespace evaluator_internal;
+
+    // Stack depth is checked once here, so interpreter doesn't check it for each object
+    std::size_t depth = 0, max_depth = 1;
+    bool correct = true;
+    cse_init();
+    program<T> & prog = m_program.write();
+    prog.bytecode.clear();
+    prog.bytecode.reserve(prog.expression.size() + prog.cse_temps + 1);
+    prog.vars_mask.clear();
+    for(typename std::vector<evaluator_object<T> >::const_iterator
+        it = prog.expression.begin(), it_end = prog.expression.end(); it != it_end; ++it)
+    {
+        const cse_action cse = cse_action_at(it);
+        bc_instr<T> instr;
+        instr.target = NULL;
+        instr.arg2 = 0;
+        bool fused = false;
+        if(cse.kind == CSE_LOAD)
+        {
+            // Value of subtree is evaluated before, the subtree is skipped
+            max_depth = std::max(max_depth, ++depth);
+            instr.op = BC_TEMP;
+            instr.arg.index = cse.temp;
+            it = prog.expression.begin() + cse.end;
+        }
+        else if(it->is_constant() || it->is_variable())
+        {
+            max_depth = std::max(max_depth, ++depth);
+            instr.op = it->is_constant() ? BC_CONST : BC_VAR;
+            instr.arg.index = it->index();
+            if(it->is_variable())
+                var_table<T>::mask_set(prog.vars_mask, it->index());
+        }
+        else if(it->is_operator())
+        {
+            if(depth >= 2)
+                depth--;
+            else
+                correct = false;
+            instr.op = bc_oper_opcode(it->raw_oper());
+            instr.arg.oper = it->raw_oper();
+
+            // Peephole: operator after loads of its operands becomes superinstruction,
+            // the last two loads are always the two top elements of stack, BC_TEMP is not fused
+            const std::size_t n = prog.bytecode.size();
+            if(bc_fused_opcode(instr.op, BC_CONST, BC_CONST) != instr.op && n >= 1 &&
+               (prog.bytecode[n - 1].op == BC_CONST || prog.bytecode[n - 1].op == BC_VAR))
+            {
+                bc_instr<T> & right = prog.bytecode[n - 1];
+                if(n >= 2 && (prog.bytecode[n - 2].op == BC_CONST || prog.bytecode[n - 2].op == BC_VAR))
+                {
+                    bc_instr<T> & left = prog.bytecode[n - 2];
+                    left.op = bc_fused_opcode(instr.op, left.op, right.op);
+                    left.arg2 = right.arg.index;
+                    prog.bytecode.pop_back();
+                }
+                else
+                    right.op = bc_fused_opcode(instr.op, BC_OPER, right.op);
+                fused = true;
+            }
+        }
+        else
+        {
+            if(depth < 1)
+                correct = false;
+            instr.op = bc_func_opcode(it->raw_func());
+            instr.arg.func = it->raw_func();
+        }
+        if(!fused)
+            prog.bytecode.push_back(instr);
+        if(cse.kind == CSE_STORE)
+        {
+            instr.op = BC_STORE;
+            instr.arg.index = cse.temp;
+            prog.bytecode.push_back(instr);
+        }
+    }
+    bc_instr<T> end;
+    end.op = BC_END;
+    end.target = NULL;
+    end.arg.index = 0;
+    end.arg2 = 0;
+    prog.bytecode.push_back(end);
+
+    prog.calc_stack_end = correct ? depth : 0;
+    prog.calc_stack_size = max_depth;
+    m_calc_stack.resize(max_depth);
+    // Handlers are linked here, so program is not changed when it is shared by copies
+    calculate_rpn(NULL);
+}
+
+// Get number of instructions of interpreter for current expression, superinstructions are counted once
+template<typename T>
+std::size_t evaluator<T>::bytecode_size() const
+{
+    return m_program->bytecode.empty() ? 0 : m_program->bytecode.size() - 1;
+}
+
+// Check that all variables of current expression have values, once per calculation
+template<typename T>
+bool evaluator<T>::check_vars()
+{
+    const std::size_t i = m_variables.find_undefined(m_program->vars_mask);
+    if(i != m_variables.size())
+    {
+        m_error_string = "Constant `" + m_variables.name(i) + "` must be defined!";
+        return false;
+    }
+    return true;
+}
+
+// Computed goto and addresses of labels are GNU extensions
+#if defined(EVALUATOR_BYTECODE_THREADED)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+// Calculate current expression by bytecode interpreter, without allocations of memory,
+// NULL 'result' only links handlers to bytecode, see calc_init()
+template<typename T>
+bool evaluator<T>::calculate_rpn(T * result)
 {
     using namespace evaluator_internal;
 
+#if defined(EVALUATOR_BYTECODE_THREADED)
+    // Handlers in order of enum bc_opcode
+    static const void * const handlers[] =
+    {
+        && bc_CONST,
+        && bc_VAR,
+        && bc_ADD,
+        && bc_SUB,
+        && bc_MUL,
+        && bc_DIV,
+        && bc_POW,
+#define EVALUATOR_BYTECODE_LABEL(OP, NAME) && bc_##OP,
+        EVALUATOR_BYTECODE_FUNCTIONS(EVALUATOR_BYTECODE_LABEL)
+#undef EVALUATOR_BYTECODE_LABEL
+        && bc_FUNC,
+        && bc_OPER,
+        && bc_TEMP,
+        && bc_STORE,
+#define EVALUATOR_BYTECODE_LABEL(OP, SYM) \
+        && bc_##OP##_VV, && bc_##OP##_VC, && bc_##OP##_CV, && bc_##OP##_CC, && bc_##OP##_SV, && bc_##OP##_SC,
+        EVALUATOR_BYTECODE_FUSED(EVALUATOR_BYTECODE_LABEL)
+#undef EVALUATOR_BYTECODE_LABEL
+        && bc_END
+    };
+    if(!result)
+    {
+        std::vector<bc_instr<T> > & bytecode = m_program.write().bytecode;
+        for(typename std::vector<bc_instr<T> >::iterator
+            it = bytecode.begin(), it_end = bytecode.end(); it != it_end; ++it)
+            it->target = handlers[it->op];
+        return true;
+    }
+#else
+    if(!result)
+        return true;
+#endif
+
+    const program<T> & prog = * m_program;
+    if(prog.calc_stack_end != 1)
+    {
+        std::stringstream sst;
+        sst << "Stack size equal " << prog.calc_stack_end;
+        m_error_string = sst.str();
+        return false;
+    }
+
+    const T * vars = m_variables.data();
+    const T * consts = prog.const_values.empty() ? NULL : & prog.const_values[0];
+    T * temps = m_cse_values.empty() ? NULL : & m_cse_values[0];
+    // Stack pointer: the next free element of evaluation stack
+    T * sp = & m_calc_stack[0];
+    const bc_instr<T> * ip = & prog.bytecode[0];
+
+#if defined(EVALUATOR_BYTECODE_THREADED)
+    #define EVALUATOR_BYTECODE_HANDLER(OP) bc_##OP:
+    #define EVALUATOR_BYTECODE_NEXT goto * (++ip)->target
+    goto * ip->target;
+#else
+    #define EVALUATOR_BYTECODE_HANDLER(OP) case BC_##OP:
+    #define EVALUATOR_BYTECODE_NEXT ++ip; break
+    for(;;) switch(ip->op) {
+#endif
+
+    EVALUATOR_BYTECODE_HANDLER(CONST)
+        * sp++ = consts[ip->arg.index];
+        EVALUATOR_BYTECODE_NEXT;
+    EVALUATOR_BYTECODE_HANDLER(VAR)
+        * sp++ = vars[ip->arg.index];
+        EVALUATOR_BYTECODE_NEXT;
+    EVALUATOR_BYTECODE_HANDLER(ADD)
+        sp--;
+        sp[-1] = sp[-1] + sp[0];
+        EVALUATOR_BYTECODE_NEXT;
+    EVALUATOR_BYTECODE_HANDLER(SUB)
+        sp--;
+        sp[-1] = sp[-1] - sp[0];
+        EVALUATOR_BYTECODE_NEXT;
+    EVALUATOR_BYTECODE_HANDLER(MUL)
+        sp--;
+        sp[-1] = sp[-1] * sp[0];
+        EVALUATOR_BYTECODE_NEXT;
+    EVALUATOR_BYTECODE_HANDLER(DIV)
+        sp--;
+        sp[-1] = sp[-1] / sp[0];
+        EVALUATOR_BYTECODE_NEXT;
+    EVALUATOR_BYTECODE_HANDLER(POW)
+        sp--;
+        sp[-1] = eval_pow(sp[-1], sp[0]);
+        EVALUATOR_BYTECODE_NEXT;
+#define EVALUATOR_BYTECODE_FUNC_HANDLER(OP, NAME) \
+    EVALUATOR_BYTECODE_HANDLER(OP) \
+        sp[-1] = eval_##NAME(sp[-1]); \
+        EVALUATOR_BYTECODE_NEXT;
+    EVALUATOR_BYTECODE_FUNCTIONS(EVALUATOR_BYTECODE_FUNC_HANDLER)
+#undef EVALUATOR_BYTECODE_FUNC_HANDLER
+    EVALUATOR_BYTECODE_HANDLER(FUNC)
+        sp[-1] = ip->arg.func(sp[-1]);
+        EVALUATOR_BYTECODE_NEXT;
+    EVALUATOR_BYTECODE_HANDLER(OPER)
+        sp--;
+        sp[-1] = ip->arg.oper(sp[-1], sp[0]);
+        EVALUATOR_BYTECODE_NEXT;
+    EVALUATOR_BYTECODE_HANDLER(TEMP)
+        * sp++ = temps[ip->arg.index];
+        EVALUATOR_BYTECODE_NEXT;
+    EVALUATOR_BYTECODE_HANDLER(STORE)
+        temps[ip->arg.index] = sp[-1];
+        EVALUATOR_BYTECODE_NEXT;
+#define EVALUATOR_BYTECODE_FUSED_HANDLER(OP, SYM) \
+    EVALUATOR_BYTECODE_HANDLER(OP##_VV) \
+        * sp++ = vars[ip->arg.index] SYM vars[ip->arg2]; \
+        EVALUATOR_BYTECODE_NEXT; \
+    EVALUATOR_BYTECODE_HANDLER(OP##_VC) \
+        * sp++ = vars[ip->arg.index] SYM consts[ip->arg2]; \
+        EVALUATOR_BYTECODE_NEXT; \
+    EVALUATOR_BYTECODE_HANDLER(OP##_CV) \
+        * sp++ = consts[ip->arg.index] SYM vars[ip->arg2]; \
+        EVALUATOR_BYTECODE_NEXT; \
+    EVALUATOR_BYTECODE_HANDLER(OP##_CC) \
+        * sp++ = consts[ip->arg.index] SYM consts[ip->arg2]; \
+        EVALUATOR_BYTECODE_NEXT; \
+    EVALUATOR_BYTECODE_HANDLER(OP##_SV) \
+        sp[-1] = sp[-1] SYM vars[ip->arg.index]; \
+        EVALUATOR_BYTECODE_NEXT; \
+    EVALUATOR_BYTECODE_HANDLER(OP##_SC) \
+        sp[-1] = sp[-1] SYM consts[ip->arg.index]; \
+        EVALUATOR_BYTECODE_NEXT;
+    EVALUATOR_BYTECODE_FUSED(EVALUATOR_BYTECODE_FUSED_HANDLER)
+#undef EVALUATOR_BYTECODE_FUSED_HANDLER
+    EVALUATOR_BYTECODE_HANDLER(END)
+        * result = m_calc_stack[0];
+        return true;
+
+#if !defined(EVALUATOR_BYTECODE_THREADED)
+    }
+#endif
+#undef EVALUATOR_BYTECODE_HANDLER
+#undef EVALUATOR_BYTECODE_NEXT
+}
+
+#if defined(EVALUATOR_BYTECODE_THREADED)
+#pragma GCC diagnostic pop
+#endif
+
+// Calculate current expression and write result to 'result'
+template<typename T>
+bool evaluator<T>::calculate(T & result)
+{
     if(!is_parsed())
     {
         m_error_string = "Not parsed!";
         return false;
     }
+    if(!check_vars())
+        return false;
 
 #if !defined(EVALUATOR_JIT_DISABLE)
     if(m_is_compiled)
     {
+        if(m_jit_batch)
+        {
+            jit_batch_run(1, std::map<std::string, const T *>(), & result);
+            return true;
+        }
+        if(m_jit_kernel)
+        {
+            jit_kernel_run(result);
+            return true;
+        }
         m_jit_func();
         result = m_jit_stack[0];
         return true;
     }
 #endif
 
-    std::stack<T> st;
+    return calculate_rpn(& result);
+}
 
-    for(typename std::vector<evaluator_object<T> >::const_iterator
-        it = m_expression.begin(), it_end = m_expression.end(); it != it_end; ++it)
+// Calculate current expression in 'n' points and write results to array 'result',
+// 'bindings' is container: [variable name]->array of 'n' values
+// Variables will contain values of the last point after return
+template<typename T>
+bool evaluator<T>::calculate_batch(std::size_t n, const std::map<std::string, const T *> & bindings, T * result)
+{
+    if(!is_parsed())
+    {
+        m_error_string = "Not parsed!";
+        return false;
+    }
+
+    // Resolve all names once: pair(index of variable, array of values),
+    // unknown names are errors, they are not added to variables
+    std::vector<std::pair<std::size_t, const T *> > vars;
+    vars.reserve(bindings.size());
+    for(typename std::map<std::string, const T *>::const_iterator
+        it = bindings.begin(), it_end = bindings.end(); it != it_end; ++it)
     {
-        if(it->is_constant())
+        const std::size_t index = m_variables.find(it->first);
+        if(index == m_variables.size())
         {
-            st.push(it->eval());
+            m_error_string = "Unknown variable `" + it->first + "`!";
+            return false;
         }
-        else if(it->is_variable())
+        vars.push_back(std::make_pair(index, it->second));
+    }
+    const std::size_t vars_num = vars.size();
+    T * values = m_variables.data();
+    if(n == 0)
+        return true;
+    // Bound variables have values of the last point, also if calculation fails
+    for(std::size_t j = 0; j < vars_num; j++)
+        m_variables.set(vars[j].first, vars[j].second[n - 1]);
+    if(!check_vars())
+        return false;
+
+#if !defined(EVALUATOR_JIT_DISABLE)
+    if(m_is_compiled && m_jit_batch)
+    {
+        jit_batch_run(n, bindings, result);
+        for(std::size_t j = 0; j < vars_num; j++)
+            values[vars[j].first] = vars[j].second[n - 1];
+        return true;
+    }
+    if(m_is_compiled)
+    {
+        for(std::size_t i = 0; i < n; i++)
         {
-            const T val = it->eval();
-            if(!is_incorrect(val))
+            for(std::size_t j = 0; j < vars_num; j++)
+                values[vars[j].first] = vars[j].second[i];
+            if(m_jit_kernel)
             {
-                st.push(val);
+                jit_kernel_run(result[i]);
+                continue;
             }
-            else
-            {
-                std::stringstream sst;
-                sst << "Constant `" << it->str() << "` must be defined!";
-                m_error_string = sst.str();
-                return false;
-            }
-        }
-        else if(it->is_operator())
-        {
-            const T arg2 = st.top();
-            st.pop();
-            const T arg1 = st.top();
-            st.pop();
-            const T val = it->eval(arg1, arg2);
-            st.push(val);
-        }
-        else if(it->is_function())
-        {
-            const T arg = st.top();
-            st.pop();
-            const T val = it->eval(arg);
-            st.push(val);
+            m_jit_func();
+            result[i] = m_jit_stack[0];
         }
+        return true;
     }
+#endif
 
-    if(st.size() != 1)
+    for(std::size_t i = 0; i < n; i++)
     {
-        std::stringstream sst;
-        sst << "Stack size equal " << st.size();
-        m_error_string = sst.str();
-        return false;
+        for(std::size_t j = 0; j < vars_num; j++)
+            values[vars[j].first] = vars[j].second[i];
+        if(!calculate_rpn(& result[i]))
+            return false;
     }
-    result = st.top();
     return true;
 }
 
 #endif // EVALUATOR_CALCULATE_H
-
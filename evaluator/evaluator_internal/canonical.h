@@ -0,0 +1,228 @@
+#if !defined(EVALUATOR_CANONICAL_H)
+#define EVALUATOR_CANONICAL_H
+
+#include <vector>
+#include <map>
+#include <string>
+#include <utility>
+#include <algorithm>
+#include "../evaluator.h"
+
+namespace evaluator_internal
+{
+
+// FNV-1a hash of string, the same on every run
+inline std::size_t structure_hash_string(const std::string & str)
+{
+    unsigned int h = 2166136261u;
+    for(std::size_t i = 0; i < str.size(); i++)
+    {
+        h ^= static_cast<unsigned char>(str[i]);
+        h *= 16777619u;
+    }
+    return static_cast<std::size_t>(h);
+}
+
+// Hash of sequence: hash 'h' of its beginning and hash 'v' of the next element
+inline std::size_t structure_hash_combine(std::size_t h, std::size_t v)
+{
+    return h ^ (v + static_cast<std::size_t>(0x9e3779b9u) + (h << 6) + (h >> 2));
+}
+
+} // namespace evaluator_internal
+
+// Structure of current expression: subtree of i-th object is [begin[i], i], its hash is hash[i],
+// operands of i-th object are emitted in reversed order in canonical form if swap[i] is true
+template<typename T>
+bool evaluator<T>::structure(std::vector<std::size_t> & begin, std::vector<std::size_t> & hash,
+                             std::vector<bool> & swap) const
+{
+    using namespace evaluator_internal;
+
+    // Stack depth of subtree, deeper operand of commutative operator goes first, see minimize_stack()
+    const std::vector<evaluator_object<T> > & expression = m_program->expression;
+    const std::size_t size = expression.size();
+    std::vector<std::size_t> need(size), st;
+    begin.resize(size);
+    hash.resize(size);
+    swap.assign(size, false);
+    for(std::size_t i = 0; i < size; i++)
+    {
+        const evaluator_object<T> & obj = expression[i];
+        if(obj.is_operator())
+        {
+            if(st.size() < 2)
+                return false;
+            std::size_t right = st.back();
+            st.pop_back();
+            std::size_t left = st.back();
+            st.pop_back();
+            begin[i] = begin[left];
+            // Operands of commutative operator are ordered by stack depth and hash,
+            // operands with equal hashes are usually equal and keep their order
+            if((obj_str(obj) == "+" || obj_str(obj) == "*") &&
+               (need[right] > need[left] || (need[right] == need[left] && hash[right] < hash[left])))
+            {
+                swap[i] = true;
+                std::swap(left, right);
+            }
+            if(obj_str(obj) == "+" || obj_str(obj) == "*")
+                need[i] = std::max(std::max(need[left], need[right]), std::min(need[left], need[right]) + 1);
+            else
+                need[i] = std::max(need[left], need[right] + 1);
+            hash[i] = structure_hash_combine(structure_hash_combine(
+                      structure_hash_string("o" + obj_str(obj)), hash[left]), hash[right]);
+        }
+        else if(obj.is_function())
+        {
+            if(st.empty())
+                return false;
+            const std::size_t arg = st.back();
+            st.pop_back();
+            begin[i] = begin[arg];
+            need[i] = need[arg];
+            hash[i] = structure_hash_combine(structure_hash_string("f" + obj_str(obj)), hash[arg]);
+        }
+        else
+        {
+            begin[i] = i;
+            need[i] = 1;
+            hash[i] = obj.is_variable() ? structure_hash_string("v" + obj_str(obj))
+                                        : structure_hash_string("c" + canonical_number(obj_eval(obj)));
+        }
+        st.push_back(i);
+    }
+    return st.size() == 1;
+}
+
+// Canonical form of current expression: operands of commutative operators are sorted,
+// constants are named by their values and equal constants are merged
+template<typename T>
+bool evaluator<T>::canonicalize()
+{
+    using namespace evaluator_internal;
+
+    if(!is_parsed())
+    {
+        m_error_string = "Not parsed!";
+        return false;
+    }
+
+    std::vector<std::size_t> begin, hash;
+    std::vector<bool> swap;
+    if(!structure(begin, hash, swap))
+    {
+        m_error_string = "Wrong expression!";
+        return false;
+    }
+
+    // Emit subtrees from the root, pair(i, true) emits i-th object itself,
+    // pair(i, false) emits its operands first, names and constants are made anew
+    program<T> & prog = m_program.write();
+    const std::size_t size = prog.expression.size();
+    const std::vector<evaluator_object<T> > expression_old(prog.expression);
+    const std::vector<T> const_values_old(prog.const_values);
+    const name_table names_old(prog.names);
+    prog.expression.clear();
+    prog.const_values.clear();
+    prog.names.clear();
+    // Equal constants are merged by values, not by texts
+    std::map<T, evaluator_object<T>, number_less<T> > consts;
+    std::vector<std::pair<std::size_t, bool> > todo;
+    todo.push_back(std::make_pair(size - 1, false));
+    while(!todo.empty())
+    {
+        const std::size_t i = todo.back().first;
+        const bool ready = todo.back().second;
+        todo.pop_back();
+        const evaluator_object<T> & obj = expression_old[i];
+        if(obj.is_constant())
+        {
+            const T & value = const_values_old[obj.index()];
+            typename std::map<T, evaluator_object<T>, number_less<T> >::const_iterator it = consts.find(value);
+            if(it == consts.end())
+            {
+                prog.expression.push_back(make_constant(prog, canonical_number(value), value));
+                consts.insert(std::make_pair(value, prog.expression.back()));
+            }
+            else
+                prog.expression.push_back(it->second);
+        }
+        else if(obj.is_variable())
+        {
+            prog.expression.push_back(evaluator_object<T>(evaluator_object<T>::OBJ_VARIABLE,
+                                                          prog.names.intern(names_old[obj.name()]), obj.index()));
+        }
+        else if(ready)
+        {
+            if(obj.is_function())
+                prog.expression.push_back(make_function(prog, names_old[obj.name()], obj.raw_func()));
+            else
+                prog.expression.push_back(make_operator(prog, names_old[obj.name()], obj.raw_oper()));
+        }
+        else if(obj.is_function())
+        {
+            todo.push_back(std::make_pair(i, true));
+            todo.push_back(std::make_pair(i - 1, false));
+        }
+        else
+        {
+            const std::size_t right = i - 1;
+            const std::size_t left = begin[right] - 1;
+            todo.push_back(std::make_pair(i, true));
+            // Stack of todo is reversed, so the first operand is pushed last
+            if(swap[i])
+            {
+                todo.push_back(std::make_pair(left, false));
+                todo.push_back(std::make_pair(right, false));
+            }
+            else
+            {
+                todo.push_back(std::make_pair(right, false));
+                todo.push_back(std::make_pair(left, false));
+            }
+        }
+    }
+
+    m_is_compiled = false;
+    calc_init();
+    return true;
+}
+
+// Hash of structure of current expression, the same for expressions with the same canonical form
+// and on every run, 0 if expression is not parsed
+template<typename T>
+std::size_t evaluator<T>::structural_hash() const
+{
+    std::vector<std::size_t> begin, hash;
+    std::vector<bool> swap;
+    if(!is_parsed() || !structure(begin, hash, swap))
+        return 0;
+    return hash.back();
+}
+
+// Text of current expression in canonical form, see canonicalize()
+template<typename T>
+std::string evaluator<T>::canonical_text() const
+{
+    using namespace evaluator_internal;
+
+    std::string text;
+    for(typename std::vector<evaluator_object<T> >::const_iterator
+        it = m_program->expression.begin(), it_end = m_program->expression.end(); it != it_end; ++it)
+    {
+        if(it->is_variable())
+            text += "v";
+        else if(it->is_constant())
+            text += "c";
+        else if(it->is_function())
+            text += "f";
+        else
+            text += "o";
+        text += obj_str(*it);
+        text += " ";
+    }
+    return text;
+}
+
+#endif // EVALUATOR_CANONICAL_H
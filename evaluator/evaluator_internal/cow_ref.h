@@ -0,0 +1,126 @@
+#if !defined(EVALUATOR_COW_REF_H)
+#define EVALUATOR_COW_REF_H
+
+#include <cstddef>
+#include "lock.h"
+
+namespace evaluator_internal
+{
+
+// Reference counted object V with copy-on-write: copies share the same object, which is not changed
+// while it is shared, write() makes own copy first. Empty reference doesn't allocate memory
+// and reads as V::shared(). V has field 'refs', its copy constructor copies the contents
+template<typename V> class cow_ref
+{
+public:
+
+    cow_ref()
+        : m_object(NULL)
+    {}
+
+    cow_ref(const cow_ref & other)
+        : m_object(other.m_object)
+    {
+        if(m_object)
+        {
+            scoped_lock lock(LOCK_REFS);
+            m_object->refs++;
+        }
+    }
+
+    ~cow_ref()
+    {
+        release();
+    }
+
+    cow_ref & operator = (const cow_ref & other)
+    {
+        if(m_object != other.m_object)
+        {
+            if(other.m_object)
+            {
+                scoped_lock lock(LOCK_REFS);
+                other.m_object->refs++;
+            }
+            release();
+            m_object = other.m_object;
+        }
+        return * this;
+    }
+
+    inline const V & operator * () const
+    {
+        return m_object ? * m_object : V::shared();
+    }
+
+    inline const V * operator -> () const
+    {
+        return m_object ? m_object : & V::shared();
+    }
+
+    // Reference reads V::shared()
+    inline bool is_shared() const
+    {
+        return !m_object;
+    }
+
+    // Object for changes, it is copied if it is shared
+    V & write()
+    {
+        V * copy;
+        if(m_object)
+        {
+            {
+                scoped_lock lock(LOCK_REFS);
+                if(m_object->refs == 1)
+                    return * m_object;
+            }
+            copy = new V(* m_object);
+        }
+        else
+            copy = new V(V::shared());
+        copy->refs = 1;
+        release();
+        m_object = copy;
+        return * m_object;
+    }
+
+    // Object for new contents: own object is returned as is, so its memory is reused,
+    // shared one is replaced by copy of V::shared()
+    V & write_new()
+    {
+        if(m_object)
+        {
+            scoped_lock lock(LOCK_REFS);
+            if(m_object->refs == 1)
+                return * m_object;
+        }
+        V * fresh = new V(V::shared());
+        fresh->refs = 1;
+        release();
+        m_object = fresh;
+        return * m_object;
+    }
+
+private:
+
+    void release()
+    {
+        if(!m_object)
+            return;
+        bool last;
+        {
+            scoped_lock lock(LOCK_REFS);
+            last = (--m_object->refs == 0);
+        }
+        if(last)
+            delete m_object;
+        m_object = NULL;
+    }
+
+    V * m_object;
+};
+
+} // namespace evaluator_internal
+
+#endif // EVALUATOR_COW_REF_H
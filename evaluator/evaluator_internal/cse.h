@@ -0,0 +1,63 @@
+#if !defined(EVALUATOR_CSE_H)
+#define EVALUATOR_CSE_H
+
+#include <cstddef>
+
+// Common subexpressions: equal subtrees of expression are found by hash-consing,
+// the first one is evaluated and its value is stored to temporary,
+// the others are replaced by load of this temporary.
+
+namespace evaluator_internal
+{
+
+// Kind of action for object of expression
+enum cse_kind
+{
+    // Object is evaluated as usual
+    CSE_NONE,
+    // Object is evaluated, then its value is stored to temporary
+    CSE_STORE,
+    // Subtree [object, end] is not evaluated, temporary is loaded instead
+    CSE_LOAD
+};
+
+// Action for object of expression
+struct cse_action
+{
+    cse_action()
+        : kind(CSE_NONE), temp(0), end(0)
+    {}
+
+    cse_kind kind;
+    // Index of temporary
+    std::size_t temp;
+    // CSE_LOAD: index of the last object of skipped subtree
+    std::size_t end;
+};
+
+// Node of expression DAG: object and nodes of its operands
+struct cse_node
+{
+    // 0 for constant, 1 for variable, 2 for function, 3 for operator
+    int type;
+    // Index of variable, index of distinct value of constant or interned name of other objects
+    std::size_t id;
+    // Nodes of operands, (std::size_t)-1 if there are no such operands
+    std::size_t left;
+    std::size_t right;
+
+    bool operator < (const cse_node & other) const
+    {
+        if(type != other.type)
+            return type < other.type;
+        if(id != other.id)
+            return id < other.id;
+        if(left != other.left)
+            return left < other.left;
+        return right < other.right;
+    }
+};
+
+} // namespace evaluator_internal
+
+#endif // EVALUATOR_CSE_H
@@ -1,15 +1,17 @@
 #if !defined(EVALUATOR_OBJECT_H)
 #define EVALUATOR_OBJECT_H
 
-#include <string>
+#include <cstddef>
 
 namespace evaluator_internal
 {
 
 // The universal evaluator object. It may be operator, function, variable or constant.
+// Object is a compact tagged node: type, id of name in name table of evaluator and one payload,
+// 16 bytes on 64-bit platforms. Values of variables and constants are stored by evaluator.
 template<typename T> class evaluator_object
 {
-private:
+public:
 
     // Allowed object types
     enum obj_type
@@ -19,37 +21,29 @@ private:
         OBJ_VARIABLE,
         OBJ_CONSTANT
     };
-    // Type of object
-    obj_type m_type;
+
+private:
 
     // Pointer to function  (for function type)
     typedef T(* func_type)(const T &);
-    func_type m_func;
 
     // Pointer to operator (for operator type)
     typedef T(* oper_type)(const T &, const T &);
-    oper_type m_oper;
-
-    // Value of constant (for constant type)
-    T m_const_value;
 
-    // Pointer to variable (for variable type)
-    const T * m_var_value;
+    // Type of object
+    obj_type m_type;
 
-    // String representation of object (for any type)
-    std::string m_str;
+    // Id of string representation of object (for any type)
+    unsigned int m_name;
 
-    // Initialize all members
-    void init(obj_type type, const std::string & str, func_type func,
-              oper_type oper, const T & value, const T * var_value)
+    // Payload, depends on type of object
+    union
     {
-        m_type = type;
-        m_str = str;
-        m_const_value = value;
-        m_var_value = var_value;
-        m_func = func;
-        m_oper = oper;
-    }
+        func_type func;
+        oper_type oper;
+        // Index of variable in slot table or of constant in constant pool of evaluator
+        std::size_t index;
+    } m_data;
 
 public:
 
@@ -77,74 +71,64 @@ public:
         return m_type == OBJ_OPERATOR;
     }
 
-    // Get string representation of object
-    inline const std::string & str() const
+    // Get id of string representation of object
+    inline unsigned int name() const
     {
-        return m_str;
+        return m_name;
     }
 
-    // Get pointer to variable or constant
-    inline const T * raw_value() const
+    // Get index of variable or constant
+    inline std::size_t index() const
     {
-        return (m_type == OBJ_VARIABLE ? m_var_value : (& m_const_value));
+        return m_data.index;
     }
 
     // Get pointer to operator
     inline oper_type raw_oper() const
     {
-        return m_oper;
+        return m_data.oper;
     }
 
     // Get pointer to function
     inline func_type raw_func() const
     {
-        return m_func;
-    }
-
-    // Get value of variable or constant
-    inline T eval() const
-    {
-        return (m_type == OBJ_VARIABLE ? (* m_var_value) : m_const_value);
+        return m_data.func;
     }
 
     // Calc function with argument 'arg'
     inline T eval(const T & arg) const
     {
-        return m_func(arg);
+        return m_data.func(arg);
     }
 
     // Calc oparator with arguments 'larg' and 'rarg'
     inline T eval(const T & larg, const T & rarg) const
     {
-        return m_oper(larg, rarg);
+        return m_data.oper(larg, rarg);
     }
 
-    // Construct variable object
-    evaluator_object(const std::string & new_str, const T * var_val)
+    // Construct variable or constant object
+    evaluator_object(obj_type type, unsigned int name, std::size_t index)
+        : m_type(type), m_name(name)
     {
-        init(OBJ_VARIABLE, new_str, NULL, NULL, T(), var_val);
-    }
-
-    // Construct constant object
-    evaluator_object(const std::string & new_str, const T & const_val)
-    {
-        init(OBJ_CONSTANT, new_str, NULL, NULL, const_val, NULL);
+        m_data.index = index;
     }
 
     // Construct function object
-    evaluator_object(const std::string & new_str, func_type func)
+    evaluator_object(unsigned int name, func_type func)
+        : m_type(OBJ_FUNCTION), m_name(name)
     {
-        init(OBJ_FUNCTION, new_str, func, NULL, T(), NULL);
+        m_data.func = func;
     }
 
     // Construct operator object
-    evaluator_object(const std::string & new_str, oper_type oper)
+    evaluator_object(unsigned int name, oper_type oper)
+        : m_type(OBJ_OPERATOR), m_name(name)
     {
-        init(OBJ_OPERATOR, new_str, NULL, oper, T(), NULL);
+        m_data.oper = oper;
     }
 };
 
 } // namespace evaluator_internal
 
 #endif // EVALUATOR_OBJECT_H
-
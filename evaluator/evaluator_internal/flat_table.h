@@ -0,0 +1,143 @@
+#if !defined(EVALUATOR_FLAT_TABLE_H)
+#define EVALUATOR_FLAT_TABLE_H
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstddef>
+
+namespace evaluator_internal
+{
+
+// Flat table: [name]->value, entries are stored in one array and found by perfect hash,
+// i.e. each name has its own slot and lookup is one hash and one comparison of names.
+// New entry takes its free slot, hash is rebuilt only on collision or when half of slots is used.
+template<typename V> class flat_table
+{
+public:
+
+    struct entry
+    {
+        std::string name;
+        V value;
+    };
+
+    flat_table()
+        : m_seed(0), m_mask(0)
+    {}
+
+    // Number of entries
+    inline std::size_t size() const
+    {
+        return m_entries.size();
+    }
+
+    // Entry with index 'i'
+    inline const entry & operator [] (std::size_t i) const
+    {
+        return m_entries[i];
+    }
+
+    // Entry with name [name, name + length), NULL if there is no such entry
+    const entry * find(const char * name, std::size_t length) const
+    {
+        if(m_slots.empty())
+            return NULL;
+        const std::size_t i = m_slots[hash(name, length, m_seed) & m_mask];
+        if(i == empty_slot)
+            return NULL;
+        const entry & e = m_entries[i];
+        if(e.name.size() != length || memcmp(e.name.data(), name, length) != 0)
+            return NULL;
+        return & e;
+    }
+
+    inline const entry * find(const std::string & name) const
+    {
+        return find(name.data(), name.size());
+    }
+
+    // Add entry, value of existing entry is replaced
+    void insert(const std::string & name, const V & value)
+    {
+        const entry * existing = find(name);
+        if(existing)
+        {
+            m_entries[static_cast<std::size_t>(existing - & m_entries[0])].value = value;
+            return;
+        }
+        entry e;
+        e.name = name;
+        e.value = value;
+        m_entries.push_back(e);
+        if(m_slots.size() >= m_entries.size() * 2)
+        {
+            std::size_t & slot = m_slots[hash(name.data(), name.size(), m_seed) & m_mask];
+            if(slot == empty_slot)
+            {
+                slot = m_entries.size() - 1;
+                return;
+            }
+        }
+        rebuild();
+    }
+
+private:
+
+    static const std::size_t empty_slot = static_cast<std::size_t>(-1);
+
+    // FNV-1a hash with seed
+    static std::size_t hash(const char * name, std::size_t length, std::size_t seed)
+    {
+        unsigned int h = 2166136261u ^ static_cast<unsigned int>(seed);
+        for(std::size_t i = 0; i < length; i++)
+        {
+            h ^= static_cast<unsigned char>(name[i]);
+            h *= 16777619u;
+        }
+        return static_cast<std::size_t>(h ^ (h >> 16));
+    }
+
+    // Find seed and number of slots without collisions
+    void rebuild()
+    {
+        std::size_t slots_num = 4;
+        while(slots_num < m_entries.size() * 2)
+            slots_num *= 2;
+        for(;;)
+        {
+            for(std::size_t seed = 0; seed < 256; seed++)
+            {
+                m_slots.assign(slots_num, empty_slot);
+                bool collision = false;
+                for(std::size_t i = 0; i < m_entries.size() && !collision; i++)
+                {
+                    std::size_t & slot = m_slots[hash(m_entries[i].name.data(), m_entries[i].name.size(), seed) & (slots_num - 1)];
+                    if(slot != empty_slot)
+                        collision = true;
+                    slot = i;
+                }
+                if(!collision)
+                {
+                    m_seed = seed;
+                    m_mask = slots_num - 1;
+                    return;
+                }
+            }
+            slots_num *= 2;
+        }
+    }
+
+    // Entries in order of insertion
+    std::vector<entry> m_entries;
+    // Slots: [hash & m_mask]->index of entry
+    std::vector<std::size_t> m_slots;
+    std::size_t m_seed;
+    std::size_t m_mask;
+};
+
+template<typename V> const std::size_t flat_table<V>::empty_slot;
+
+} // namespace evaluator_internal
+
+#endif // EVALUATOR_FLAT_TABLE_H
@@ -0,0 +1,344 @@
+#if !defined(EVALUATOR_APPROX_MATH_H)
+#define EVALUATOR_APPROX_MATH_H
+
+#include <cmath>
+#include <limits>
+#include "common.h"
+
+// Polynomial approximations of elementary functions in double precision for software kernels
+// of SSE2 and vector code (accuracy is listed in vector_kernels.h). They use selects instead
+// of branches and no calls except sqrt, so loops over them can be vectorized.
+
+namespace evaluator_internal_jit
+{
+
+typedef unsigned long long bits_type;
+
+inline bits_type as_bits(double x)
+{
+    bits_type b;
+    memcpy(& b, & x, sizeof(b));
+    return b;
+}
+
+inline double from_bits(bits_type b)
+{
+    double x;
+    memcpy(& x, & b, sizeof(x));
+    return x;
+}
+
+// 1.5 * 2^52, (x + magic) - magic rounds x to nearest integer, low bits of (x + magic) are this integer
+const double round_magic = 6755399441055744.0;
+
+const double pi      = 3.14159265358979311600e+00;
+const double pi_2    = 1.57079632679489655800e+00;
+const double pi_2_lo = 6.12323399573676603587e-17;
+const double pi_6    = 5.23598775598298815658e-01;
+const double sqrt3   = 1.73205080756887719318e+00;
+const double ln2_hi  = 6.93147180369123816490e-01;
+const double ln2_lo  = 1.90821492927058770002e-10;
+const double log2e   = 1.44269504088896338700e+00;
+const double log10e  = 4.34294481903251816668e-01;
+
+inline double infinity()
+{
+    return std::numeric_limits<double>::infinity();
+}
+
+inline double quiet_nan()
+{
+    return std::numeric_limits<double>::quiet_NaN();
+}
+
+// |x| with sign of y
+inline double copy_sign(double x, double y)
+{
+    const bits_type sign = static_cast<bits_type>(1) << 63;
+    return from_bits((as_bits(x) & ~sign) | (as_bits(y) & sign));
+}
+
+// exp(x), argument reduction x = n * ln2 + r, |r| <= ln2 / 2, Taylor series of degree 13
+inline double approx_exp(double x)
+{
+    // out of range values give infinity or zero in last multiplication
+    const double hi = 710.0, lo = -746.0;
+    const double xc = x > hi ? hi : (x < lo ? lo : x);
+    const double t = xc * log2e + round_magic;
+    const double n = t - round_magic;
+    const bits_type ni = as_bits(t) - as_bits(round_magic);
+    const double r = (xc - n * ln2_hi) - n * ln2_lo;
+
+    double p = 1.0 / 6227020800.0;
+    p = p * r + 1.0 / 479001600.0;
+    p = p * r + 1.0 / 39916800.0;
+    p = p * r + 1.0 / 3628800.0;
+    p = p * r + 1.0 / 362880.0;
+    p = p * r + 1.0 / 40320.0;
+    p = p * r + 1.0 / 5040.0;
+    p = p * r + 1.0 / 720.0;
+    p = p * r + 1.0 / 120.0;
+    p = p * r + 1.0 / 24.0;
+    p = p * r + 1.0 / 6.0;
+    p = p * r + 0.5;
+    p = p * r * r + r + 1.0;
+
+    // 2^n = 2^n1 * 2^n2, both are normal numbers even if result is subnormal
+    const bits_type n1 = as_bits(n * 0.5 + round_magic) - as_bits(round_magic);
+    const bits_type n2 = ni - n1;
+    const double s1 = from_bits((n1 + 1023) << 52);
+    const double s2 = from_bits((n2 + 1023) << 52);
+    return p * s1 * s2;
+}
+
+// log(x), x = 2^e * (1 + f), sqrt(2) / 2 <= 1 + f < sqrt(2),
+// log(1 + f) = f - hfsq + s * (hfsq + R(s^2)), s = f / (2 + f), series of atanh
+inline double approx_log(double x)
+{
+    const double min_normal = 2.2250738585072014e-308;
+    const bool sub = x < min_normal;
+    const double xs = sub ? x * 18014398509481984.0 : x; // 2^54
+    const bits_type b = as_bits(xs);
+    // exponent as double without integer conversion
+    const double eb = from_bits(((b >> 52) & 0x7ff) | 0x4330000000000000ULL) - 4503599627371519.0; // 2^52 + 1023
+    double m = from_bits((b & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL);
+    const bool big = m > 1.41421356237309514547;
+    m = big ? m * 0.5 : m;
+    const double e = eb + (big ? 1.0 : 0.0) - (sub ? 54.0 : 0.0);
+
+    const double f = m - 1.0;
+    const double hfsq = 0.5 * f * f;
+    const double s = f / (2.0 + f);
+    const double z = s * s;
+    double R = 2.0 / 23.0;
+    R = R * z + 2.0 / 21.0;
+    R = R * z + 2.0 / 19.0;
+    R = R * z + 2.0 / 17.0;
+    R = R * z + 2.0 / 15.0;
+    R = R * z + 2.0 / 13.0;
+    R = R * z + 2.0 / 11.0;
+    R = R * z + 2.0 / 9.0;
+    R = R * z + 2.0 / 7.0;
+    R = R * z + 2.0 / 5.0;
+    R = R * z + 2.0 / 3.0;
+    R = R * z;
+    const double result = e * ln2_hi - ((hfsq - (s * (hfsq + R) + e * ln2_lo)) - f);
+
+    const double special = (x != x || x == infinity()) ? x + x : (x == 0.0 ? -infinity() : quiet_nan());
+    return (x > 0.0 && x < infinity()) ? result : special;
+}
+
+// log(1 + x) without loss of accuracy for small x
+inline double approx_log1p(double x)
+{
+    const double u = 1.0 + x;
+    const double result = approx_log(u) - ((u - 1.0) - x) / u;
+    return u == infinity() ? u : result;
+}
+
+// Argument reduction for sin, cos and tan: x = k * pi / 2 + r, |r| <= pi / 4, q = k mod 4,
+// accurate for |x| < 2^20 (see trig_limit), Cody-Waite with 3 parts of pi / 2
+inline double trig_reduce(double x, bits_type & q)
+{
+    const double pio2_1 = 1.57079632673412561417e+00;
+    const double pio2_2 = 6.07710050630396597660e-11;
+    const double pio2_3 = 2.02226624871116645580e-21;
+    const double t = x * 6.36619772367581382433e-01 + round_magic;
+    const double k = t - round_magic;
+    q = as_bits(t) & 3;
+    return ((x - k * pio2_1) - k * pio2_2) - k * pio2_3;
+}
+
+const double trig_limit = 1048576.0; // 2^20
+
+// sin(r), |r| <= pi / 4, Taylor series of degree 17
+inline double poly_sin(double r)
+{
+    const double z = r * r;
+    double p = 1.0 / 355687428096000.0;
+    p = p * z - 1.0 / 1307674368000.0;
+    p = p * z + 1.0 / 6227020800.0;
+    p = p * z - 1.0 / 39916800.0;
+    p = p * z + 1.0 / 362880.0;
+    p = p * z - 1.0 / 5040.0;
+    p = p * z + 1.0 / 120.0;
+    p = p * z - 1.0 / 6.0;
+    return r + r * z * p;
+}
+
+// cos(r), |r| <= pi / 4, Taylor series of degree 18
+inline double poly_cos(double r)
+{
+    const double z = r * r;
+    double p = -1.0 / 6402373705728000.0;
+    p = p * z + 1.0 / 20922789888000.0;
+    p = p * z - 1.0 / 87178291200.0;
+    p = p * z + 1.0 / 479001600.0;
+    p = p * z - 1.0 / 3628800.0;
+    p = p * z + 1.0 / 40320.0;
+    p = p * z - 1.0 / 720.0;
+    p = p * z + 1.0 / 24.0;
+    const double hz = 0.5 * z;
+    const double w = 1.0 - hz;
+    return w + (((1.0 - w) - hz) + z * z * p);
+}
+
+inline double approx_sin(double x)
+{
+    bits_type q;
+    const double r = trig_reduce(x, q);
+    const double s = poly_sin(r), c = poly_cos(r);
+    const double v = (q & 1) ? c : s;
+    return (q & 2) ? -v : v;
+}
+
+inline double approx_cos(double x)
+{
+    bits_type q;
+    const double r = trig_reduce(x, q);
+    const double s = poly_sin(r), c = poly_cos(r);
+    const double v = (q & 1) ? s : c;
+    return ((q + 1) & 2) ? -v : v;
+}
+
+inline double approx_tan(double x)
+{
+    bits_type q;
+    const double r = trig_reduce(x, q);
+    const double s = poly_sin(r), c = poly_cos(r);
+    return (q & 1) ? -c / s : s / c;
+}
+
+// atan(x), reduction to |t| <= tan(pi / 12) by atan(x) = pi / 2 - atan(1 / x)
+// and atan(x) = pi / 6 + atan((x * sqrt(3) - 1) / (x + sqrt(3))), Taylor series of degree 29
+inline double approx_atan(double x)
+{
+    const double a = copy_sign(x, 1.0);
+    const bool inv = a > 1.0;
+    const double t1 = inv ? 1.0 / a : a;
+    const bool mid = t1 > 2.67949192431122696e-01;
+    const double t = mid ? (t1 * sqrt3 - 1.0) / (t1 + sqrt3) : t1;
+    const double z = t * t;
+    double p = 1.0 / 29.0;
+    p = -p * z + 1.0 / 27.0;
+    p = -p * z + 1.0 / 25.0;
+    p = -p * z + 1.0 / 23.0;
+    p = -p * z + 1.0 / 21.0;
+    p = -p * z + 1.0 / 19.0;
+    p = -p * z + 1.0 / 17.0;
+    p = -p * z + 1.0 / 15.0;
+    p = -p * z + 1.0 / 13.0;
+    p = -p * z + 1.0 / 11.0;
+    p = -p * z + 1.0 / 9.0;
+    p = -p * z + 1.0 / 7.0;
+    p = -p * z + 1.0 / 5.0;
+    p = -p * z + 1.0 / 3.0;
+    const double u = t - t * z * p;
+    const double v = mid ? pi_6 + u : u;
+    const double w = inv ? (pi_2 - v) + pi_2_lo : v;
+    return copy_sign(w, x);
+}
+
+inline double approx_asin(double x)
+{
+    return approx_atan(x / std::sqrt((1.0 - x) * (1.0 + x)));
+}
+
+inline double approx_acos(double x)
+{
+    return 2.0 * approx_atan(std::sqrt((1.0 - x) / (1.0 + x)));
+}
+
+// exp(x) / 2, does not overflow for x < 710.47
+inline double half_exp(double x)
+{
+    const double h = approx_exp(0.5 * x);
+    return (0.5 * h) * h;
+}
+
+// sinh(x), Taylor series of degree 19 for |x| < 1
+inline double approx_sinh(double x)
+{
+    const double z = x * x;
+    double p = 1.0 / 121645100408832000.0;
+    p = p * z + 1.0 / 355687428096000.0;
+    p = p * z + 1.0 / 1307674368000.0;
+    p = p * z + 1.0 / 6227020800.0;
+    p = p * z + 1.0 / 39916800.0;
+    p = p * z + 1.0 / 362880.0;
+    p = p * z + 1.0 / 5040.0;
+    p = p * z + 1.0 / 120.0;
+    p = p * z + 1.0 / 6.0;
+    const double small = x + x * z * p;
+    const double a = copy_sign(x, 1.0);
+    const double e = half_exp(a);
+    const double large = copy_sign(e - 0.25 / e, x);
+    return a < 1.0 ? small : large;
+}
+
+inline double approx_cosh(double x)
+{
+    const double e = half_exp(copy_sign(x, 1.0));
+    return e + 0.25 / e;
+}
+
+inline double approx_tanh(double x)
+{
+    const double a = copy_sign(x, 1.0);
+    const double e = approx_exp(a);
+    const double small = approx_sinh(x) / (0.5 * (e + 1.0 / e));
+    const double large = copy_sign(1.0 - 2.0 / (approx_exp(2.0 * a) + 1.0), x);
+    return a < 1.0 ? small : large;
+}
+
+// asinh(x) = log1p(|x| + x^2 / (1 + sqrt(1 + x^2))), log(|x|) + log(2) for large |x|
+inline double approx_asinh(double x)
+{
+    const double a = copy_sign(x, 1.0);
+    const double big = 268435456.0; // 2^28
+    const bool large = a > big;
+    const double ac = large ? 1.0 : a;
+    const double z = ac * ac;
+    const double l = approx_log1p(large ? a - 1.0 : ac + z / (1.0 + std::sqrt(1.0 + z)));
+    return copy_sign(l + (large ? ln2_hi + ln2_lo : 0.0), x);
+}
+
+// acosh(x) = log1p(x - 1 + sqrt((x - 1) * (x + 1))), log(x) + log(2) for large x
+inline double approx_acosh(double x)
+{
+    const double big = 268435456.0; // 2^28
+    const bool large = x > big;
+    const double t = (large ? 1.0 : x) - 1.0;
+    const double l = approx_log1p(large ? x - 1.0 : t + std::sqrt(t * (t + 2.0)));
+    return l + (large ? ln2_hi + ln2_lo : 0.0);
+}
+
+// atanh(x) = log1p(2x / (1 - x)) / 2
+inline double approx_atanh(double x)
+{
+    const double a = copy_sign(x, 1.0);
+    return copy_sign(0.5 * approx_log1p(2.0 * a / (1.0 - a)), x);
+}
+
+inline double approx_log2(double x)
+{
+    const double l = approx_log(x);
+    return l * log2e;
+}
+
+inline double approx_log10(double x)
+{
+    const double l = approx_log(x);
+    return l * log10e;
+}
+
+// arg(x) = pi for negative x (and -0.0), 0 for positive x
+inline double approx_arg(double x)
+{
+    const double v = (as_bits(x) >> 63) ? pi : 0.0;
+    return x != x ? x : v;
+}
+
+} // namespace evaluator_internal_jit
+
+#endif // EVALUATOR_APPROX_MATH_H
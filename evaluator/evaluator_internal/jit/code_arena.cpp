@@ -0,0 +1,204 @@
+#include "code_arena.h"
+#include "../lock.h"
+
+#include <map>
+#include <cstring>
+
+namespace evaluator_internal_jit
+{
+
+namespace
+{
+
+// Blocks are aligned by 16 bytes, new chunks are allocated by 1 MiB
+const std::size_t block_align = 16;
+const std::size_t chunk_size = 1024 * 1024;
+
+class code_arena
+{
+public:
+
+    code_arena()
+        : m_reserved(0), m_used(0)
+    {}
+
+    char * alloc(std::size_t size)
+    {
+        // Best fit: smallest free block which is large enough
+        std::multimap<std::size_t, char *>::iterator it = m_free_by_size.lower_bound(size);
+        if(it == m_free_by_size.end())
+        {
+            if(!add_chunk(size))
+                return NULL;
+            it = m_free_by_size.lower_bound(size);
+        }
+        char * block = it->second;
+        const std::size_t free_size = it->first;
+        remove_free(block, it);
+        if(free_size > size)
+            insert_free(block + size, free_size - size);
+        m_used += size;
+        m_refs[block] = 1;
+        return block;
+    }
+
+    void retain(char * block)
+    {
+        m_refs[block]++;
+    }
+
+    void free(char * block, std::size_t size)
+    {
+        std::map<char *, std::size_t>::iterator ref = m_refs.find(block);
+        if(--ref->second)
+            return;
+        m_refs.erase(ref);
+        m_used -= size;
+
+        // Coalesce with neighbours inside the same chunk
+        std::map<char *, std::size_t>::iterator chunk = m_chunks.upper_bound(block);
+        --chunk;
+        char * const chunk_begin = chunk->first;
+        char * const chunk_end = chunk->first + chunk->second;
+        std::map<char *, std::size_t>::iterator next = m_free.find(block + size);
+        if(next != m_free.end() && next->first < chunk_end)
+        {
+            const std::size_t next_size = next->second;
+            remove_free(next->first, next_size);
+            size += next_size;
+        }
+        std::map<char *, std::size_t>::iterator prev = m_free.lower_bound(block);
+        if(prev != m_free.begin())
+        {
+            --prev;
+            if(prev->first >= chunk_begin && prev->first + prev->second == block)
+            {
+                block = prev->first;
+                size += prev->second;
+                remove_free(block, prev->second);
+            }
+        }
+
+        // Empty chunks are returned to OS, except the last one
+        if(block == chunk_begin && size == chunk->second && m_chunks.size() > 1)
+        {
+            exec_dealloc(chunk_begin, size);
+            m_reserved -= size;
+            m_chunks.erase(chunk);
+            return;
+        }
+        insert_free(block, size);
+    }
+
+    code_arena_stats stats() const
+    {
+        code_arena_stats result;
+        result.reserved = m_reserved;
+        result.used = m_used;
+        result.blocks = m_refs.size();
+        result.free_blocks = m_free.size();
+        result.largest_free = m_free_by_size.empty() ? 0 : m_free_by_size.rbegin()->first;
+        return result;
+    }
+
+private:
+
+    bool add_chunk(std::size_t size)
+    {
+        std::size_t new_size = chunk_size;
+        while(new_size < size)
+            new_size *= 2;
+        char * chunk = reinterpret_cast<char *>(exec_alloc(new_size));
+        if(!chunk)
+            return false;
+        m_chunks[chunk] = new_size;
+        m_reserved += new_size;
+        insert_free(chunk, new_size);
+        return true;
+    }
+
+    void insert_free(char * block, std::size_t size)
+    {
+        m_free[block] = size;
+        m_free_by_size.insert(std::make_pair(size, block));
+    }
+
+    void remove_free(char * block, std::multimap<std::size_t, char *>::iterator it)
+    {
+        m_free.erase(block);
+        m_free_by_size.erase(it);
+    }
+
+    void remove_free(char * block, std::size_t size)
+    {
+        std::multimap<std::size_t, char *>::iterator it = m_free_by_size.lower_bound(size);
+        while(it->second != block)
+            ++it;
+        remove_free(block, it);
+    }
+
+    // Chunks of executable memory: [begin]->size
+    std::map<char *, std::size_t> m_chunks;
+    // Free blocks: [begin]->size
+    std::map<char *, std::size_t> m_free;
+    // Same free blocks: [size]->begin
+    std::multimap<std::size_t, char *> m_free_by_size;
+    // Allocated blocks: [begin]->number of references
+    std::map<char *, std::size_t> m_refs;
+    std::size_t m_reserved;
+    std::size_t m_used;
+};
+
+// Created on first use and never destroyed, so code of static evaluators stays valid
+code_arena * arena = NULL;
+
+code_arena & get_arena()
+{
+    if(!arena)
+        arena = new code_arena;
+    return * arena;
+}
+
+} // namespace
+
+std::size_t code_arena_block_size(std::size_t size)
+{
+    return (size + block_align - 1) / block_align * block_align;
+}
+
+char * code_arena_alloc(const char * begin, const char * end)
+{
+    const std::size_t size = code_arena_block_size(static_cast<std::size_t>(end - begin));
+    char * block;
+    {
+        evaluator_internal::scoped_lock lock(evaluator_internal::LOCK_ARENA);
+        block = get_arena().alloc(size);
+    }
+    if(block)
+    {
+        memcpy(block, begin, static_cast<std::size_t>(end - begin));
+        // Tail of block is filled with ret
+        memset(block + (end - begin), '\xc3', size - static_cast<std::size_t>(end - begin));
+    }
+    return block;
+}
+
+void code_arena_retain(char * code)
+{
+    evaluator_internal::scoped_lock lock(evaluator_internal::LOCK_ARENA);
+    get_arena().retain(code);
+}
+
+void code_arena_free(char * code, std::size_t size)
+{
+    evaluator_internal::scoped_lock lock(evaluator_internal::LOCK_ARENA);
+    get_arena().free(code, size);
+}
+
+code_arena_stats code_arena_get_stats()
+{
+    evaluator_internal::scoped_lock lock(evaluator_internal::LOCK_ARENA);
+    return get_arena().stats();
+}
+
+} // namespace evaluator_internal_jit
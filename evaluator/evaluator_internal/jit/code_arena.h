@@ -0,0 +1,76 @@
+#if !defined(EVALUATOR_CODE_ARENA_H)
+#define EVALUATOR_CODE_ARENA_H
+
+#include <cstddef>
+#include "common.h"
+
+// Process-wide arena of executable memory: compiled code of all evaluators is packed
+// into shared chunks, blocks are reference counted and returned to a free list when
+// the last evaluator which uses them is destroyed or recompiled, all functions are thread-safe
+
+namespace evaluator_internal_jit
+{
+
+// Statistics of code arena
+struct code_arena_stats
+{
+    // Bytes of executable memory allocated from OS
+    std::size_t reserved;
+    // Bytes in blocks of compiled code, rounded up to block alignment
+    std::size_t used;
+    // Number of blocks of compiled code
+    std::size_t blocks;
+    // Number of free blocks
+    std::size_t free_blocks;
+    // Size of largest free block
+    std::size_t largest_free;
+
+    // Part of free memory which is not in largest free block, 0 - no fragmentation
+    double fragmentation() const
+    {
+        const std::size_t free = reserved - used;
+        return free ? 1.0 - static_cast<double>(largest_free) / static_cast<double>(free) : 0.0;
+    }
+};
+
+// Copy code [begin, end) to new block of arena, NULL if memory is not available
+char * code_arena_alloc(const char * begin, const char * end);
+// Add reference to block 'code'
+void code_arena_retain(char * code);
+// Remove reference to block 'code' of 'size' bytes, the last one returns block to arena
+void code_arena_free(char * code, std::size_t size);
+// Block size for 'size' bytes of code
+std::size_t code_arena_block_size(std::size_t size);
+// Current statistics
+code_arena_stats code_arena_get_stats();
+
+// Temporary buffer for code generation, code is copied to arena when it is complete
+class code_buffer
+{
+public:
+
+    code_buffer()
+        : m_data(new char [128 * 1024]) // 128 KiB
+    {}
+
+    ~code_buffer()
+    {
+        delete [] m_data;
+    }
+
+    char * begin()
+    {
+        return m_data;
+    }
+
+private:
+
+    code_buffer(const code_buffer &);
+    code_buffer & operator = (const code_buffer &);
+
+    char * m_data;
+};
+
+} // namespace evaluator_internal_jit
+
+#endif // EVALUATOR_CODE_ARENA_H
@@ -9,6 +9,11 @@
     #include <sys/mman.h>
 #endif
 #include <cstdlib>
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#elif defined(__GNUC__) && !defined(EVALUATOR_JIT_DISABLE)
+    #include <cpuid.h>
+#endif
 
 // Executable memory allocation and deallocation
 
@@ -45,3 +50,82 @@ void exec_dealloc(void * data, std::size_t size)
 
 }
 
+// Detection of CPU features
+
+namespace evaluator_internal_jit
+{
+
+// regs := eax, ebx, ecx, edx after cpuid with 'leaf', false if 'leaf' is not supported
+static bool cpuid(unsigned int leaf, unsigned int regs[4])
+{
+#if defined(EVALUATOR_JIT_DISABLE)
+    (void)(leaf);
+    (void)(regs);
+    return false;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, static_cast<int>(leaf & 0x80000000));
+    if(static_cast<unsigned int>(info[0]) < leaf)
+        return false;
+    __cpuidex(info, static_cast<int>(leaf), 0);
+    for(int i = 0; i < 4; i++)
+        regs[i] = static_cast<unsigned int>(info[i]);
+    return true;
+#elif defined(__GNUC__)
+    if(__get_cpuid_max(leaf & 0x80000000, NULL) < leaf)
+        return false;
+    __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+    return true;
+#else
+    (void)(leaf);
+    (void)(regs);
+    return false;
+#endif
+}
+
+// Extended control register XCR0, state components which are enabled by OS
+static unsigned int xgetbv0()
+{
+#if defined(EVALUATOR_JIT_DISABLE)
+    return 0;
+#elif defined(_MSC_VER)
+    return static_cast<unsigned int>(_xgetbv(0));
+#elif defined(__GNUC__)
+    unsigned int eax, edx;
+    __asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a"(eax), "=d"(edx) : "c"(0));
+    return eax;
+#else
+    return 0;
+#endif
+}
+
+bool cpu_has_sse2()
+{
+    unsigned int regs[4];
+    return cpuid(1, regs) && (regs[3] & (1u << 26));
+}
+
+bool cpu_has_avx2()
+{
+    unsigned int regs[4];
+    // OSXSAVE and AVX
+    if(!cpuid(1, regs) || (regs[2] & (3u << 27)) != (3u << 27))
+        return false;
+    // xmm and ymm state
+    if((xgetbv0() & 0x06) != 0x06)
+        return false;
+    return cpuid(7, regs) && (regs[1] & (1u << 5));
+}
+
+bool cpu_has_avx512f()
+{
+    unsigned int regs[4];
+    if(!cpu_has_avx2())
+        return false;
+    // opmask, upper halves of zmm0 - zmm15 and zmm16 - zmm31 state
+    if((xgetbv0() & 0xe6) != 0xe6)
+        return false;
+    return cpuid(7, regs) && (regs[1] & (1u << 16));
+}
+
+} // namespace evaluator_internal_jit
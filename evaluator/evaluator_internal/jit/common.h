@@ -44,13 +44,13 @@
 // No arch if disabled
 #if defined(EVALUATOR_JIT_DISABLE)
     #if defined(EVALUATOR_JIT_X86)
-        #undef(EVALUATOR_JIT_X86)
+        #undef EVALUATOR_JIT_X86
     #endif
     #if defined(EVALUATOR_JIT_X64)
-        #undef(EVALUATOR_JIT_X64)
+        #undef EVALUATOR_JIT_X64
     #endif
     #if defined(EVALUATOR_JIT_X32)
-        #undef(EVALUATOR_JIT_X32)
+        #undef EVALUATOR_JIT_X32
     #endif
 #endif
 
@@ -132,5 +132,18 @@ void exec_dealloc(void * data, std::size_t size);
 } // namespace evaluator_internal_jit
 
 
+
+// Detection of CPU features
+
+namespace evaluator_internal_jit
+{
+
+bool cpu_has_sse2();
+bool cpu_has_avx2();
+bool cpu_has_avx512f();
+
+} // namespace evaluator_internal_jit
+
+
 #endif // EVALUATOR_COMMON_H
 
@@ -0,0 +1,257 @@
+#if !defined(EVALUATOR_COMPILE_BATCH_H)
+#define EVALUATOR_COMPILE_BATCH_H
+
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include "common.h"
+#include "opcodes.h"
+#include "code_arena.h"
+#include "../type_detection.h"
+#include "../../evaluator.h"
+
+#if !defined(EVALUATOR_JIT_DISABLE)
+
+// Copy generated code [code_begin, code_end) to code arena, previous code is released
+template<typename T>
+bool evaluator<T>::jit_install(const char * code_begin, const char * code_end)
+{
+    using namespace evaluator_internal_jit;
+
+    jit_release();
+    m_jit_code = code_arena_alloc(code_begin, code_end);
+    if(!m_jit_code)
+    {
+        m_error_string = "Can't allocate executable memory!";
+        return false;
+    }
+    m_jit_code_size = code_arena_block_size(static_cast<std::size_t>(code_end - code_begin));
+    std::size_t call_addr = reinterpret_cast<std::size_t>(& m_jit_func);
+    std::size_t code_addr = reinterpret_cast<std::size_t>(& m_jit_code);
+    memcpy(reinterpret_cast<void *>(call_addr), reinterpret_cast<void *>(code_addr), sizeof(void *));
+    return true;
+}
+
+// Return compiled code to code arena
+template<typename T>
+void evaluator<T>::jit_release()
+{
+    if(m_jit_code && m_jit_code_size)
+        evaluator_internal_jit::code_arena_free(m_jit_code, m_jit_code_size);
+    m_jit_code = NULL;
+    m_jit_code_size = 0;
+    m_jit_func = NULL;
+}
+
+// Allocate memory for stack of compiled code, a copy of evaluator may have smaller one
+template<typename T>
+void evaluator<T>::jit_stack_init()
+{
+    const std::size_t stack_size = 128 * 1024 / sizeof(T); // 128 KiB
+    if(m_jit_stack_size < stack_size)
+    {
+        delete [] m_jit_stack;
+        m_jit_stack_size = stack_size;
+        m_jit_stack = new T [m_jit_stack_size];
+    }
+    memset(m_jit_stack, 0, m_jit_stack_size);
+}
+
+// Prepare batch mode data, if 'batch' is true, kernel mode is reset
+template<typename T>
+void evaluator<T>::jit_batch_init(bool batch)
+{
+    using namespace evaluator_internal;
+
+    m_jit_kernel = false;
+    m_jit_batch = batch;
+    m_jit_batch_size = 0;
+    m_jit_batch_result = NULL;
+    m_jit_batch_lanes = 1;
+    m_jit_batch_names.clear();
+    m_jit_batch_slots.clear();
+    if(!batch)
+        return;
+
+    for(typename std::vector<evaluator_object<T> >::const_iterator
+        it = m_program->expression.begin(), it_end = m_program->expression.end(); it != it_end; ++it)
+    {
+        if(it->is_variable() && std::find(m_jit_batch_slots.begin(), m_jit_batch_slots.end(),
+                                          it->index()) == m_jit_batch_slots.end())
+        {
+            m_jit_batch_names.push_back(obj_str(*it));
+            m_jit_batch_slots.push_back(it->index());
+        }
+    }
+    // Unbound variables are read from their own values, see jit_batch_run()
+    m_jit_batch_args.assign(m_jit_batch_slots.size(), NULL);
+    m_jit_batch_steps.assign(m_jit_batch_slots.size(), 0);
+}
+
+// Batch mode: index of variable with index 'slot' in slot table
+template<typename T>
+std::size_t evaluator<T>::jit_batch_index(std::size_t slot) const
+{
+    return static_cast<std::size_t>(std::find(m_jit_batch_slots.begin(), m_jit_batch_slots.end(), slot) -
+                                    m_jit_batch_slots.begin());
+}
+
+// Push value of constant or variable 'obj' to FPU stack
+template<typename T>
+void evaluator<T>::jit_fld_object(char *& code_curr, const evaluator_internal::evaluator_object<T> & obj)
+{
+    using namespace evaluator_internal_jit;
+
+    if(m_jit_batch && obj.is_variable())
+    {
+        const std::size_t index = jit_batch_index(obj.index());
+        fld_pptr(code_curr, & m_jit_batch_args[index]);
+    }
+    else
+    {
+        fld_ptr(code_curr, obj_value(obj));
+    }
+}
+
+// Copy value at 'src' to 'dst'
+template<typename T>
+void evaluator<T>::jit_copy_value(char *& code_curr, const T * src, const T * dst)
+{
+    using namespace evaluator_internal;
+    using namespace evaluator_internal_jit;
+
+    if(is_float<T>() || is_double<T>())
+    {
+        fld_ptr(code_curr, src);
+        fstp_ptr(code_curr, dst);
+    }
+    else
+    {
+        fld_ptr_real(code_curr, src);
+        fstp_ptr_real(code_curr, dst);
+        fld_ptr_imag(code_curr, src);
+        fstp_ptr_imag(code_curr, dst);
+    }
+}
+
+// Copy complex value of constant or variable 'obj' to 'dst'
+template<typename T>
+void evaluator<T>::jit_copy_object(char *& code_curr, const evaluator_internal::evaluator_object<T> & obj, const T * dst)
+{
+    using namespace evaluator_internal_jit;
+
+    if(m_jit_batch && obj.is_variable())
+    {
+        const std::size_t index = jit_batch_index(obj.index());
+        fld_pptr_real(code_curr, & m_jit_batch_args[index]);
+        fld_pptr_imag(code_curr, & m_jit_batch_args[index]);
+        fstp_ptr_imag(code_curr, dst);
+        fstp_ptr_real(code_curr, dst);
+    }
+    else
+    {
+        jit_copy_value(code_curr, obj_value(obj), dst);
+    }
+}
+
+// Batch mode: store result and jump to the next point
+// Input: st(0) = result for real types, m_jit_stack[0] = result for complex types
+template<typename T>
+void evaluator<T>::jit_batch_loop(char *& code_curr, char * loop_begin)
+{
+    using namespace evaluator_internal;
+    using namespace evaluator_internal_jit;
+
+    if(is_float<T>() || is_double<T>())
+    {
+        fstp_pptr(code_curr, & m_jit_batch_result);
+    }
+    else
+    {
+        fld_ptr_real(code_curr, m_jit_stack);
+        fld_ptr_imag(code_curr, m_jit_stack);
+        fstp_pptr_imag(code_curr, & m_jit_batch_result);
+        fstp_pptr_real(code_curr, & m_jit_batch_result);
+    }
+    jit_batch_next(code_curr, loop_begin);
+}
+
+// Batch mode: advance all pointers and jump to the next point
+template<typename T>
+void evaluator<T>::jit_batch_next(char *& code_curr, char * loop_begin)
+{
+    using namespace evaluator_internal_jit;
+
+    for(std::size_t i = 0, i_end = m_jit_batch_args.size(); i < i_end; i++)
+        add_pptr(code_curr, & m_jit_batch_args[i], & m_jit_batch_steps[i]);
+    add_pptr_imm(code_curr, & m_jit_batch_result, static_cast<char>(sizeof(T) * m_jit_batch_lanes));
+    dec_ptr(code_curr, & m_jit_batch_size);
+    jnz_long(code_curr, loop_begin);
+}
+
+// Batch mode: run compiled loop for 'n' points,
+// vector code runs over full vectors, then over the tail padded to full vector
+template<typename T>
+void evaluator<T>::jit_batch_run(std::size_t n, const std::map<std::string, const T *> & bindings, T * result)
+{
+    const std::size_t lanes = m_jit_batch_lanes;
+    const std::size_t vars_num = m_jit_batch_names.size();
+    if(lanes > 1)
+        m_jit_batch_buffer.resize((vars_num + 1) * lanes);
+
+    for(std::size_t i = 0; i < vars_num; i++)
+    {
+        typename std::map<std::string, const T *>::const_iterator it = bindings.find(m_jit_batch_names[i]);
+        if(it != bindings.end())
+        {
+            m_jit_batch_args[i] = it->second;
+            m_jit_batch_steps[i] = sizeof(T) * lanes;
+        }
+        else if(lanes > 1)
+        {
+            T * buffer = & m_jit_batch_buffer[i * lanes];
+            std::fill(buffer, buffer + lanes, m_variables[m_jit_batch_slots[i]]);
+            m_jit_batch_args[i] = buffer;
+        }
+        else
+        {
+            m_jit_batch_args[i] = m_variables.data() + m_jit_batch_slots[i];
+        }
+    }
+
+    const std::size_t full = n / lanes, tail = n % lanes;
+    if(full)
+    {
+        m_jit_batch_size = full;
+        m_jit_batch_result = result;
+        m_jit_func();
+    }
+    if(tail)
+    {
+        // Input pointers of bound variables are advanced to the tail already
+        for(std::size_t i = 0; i < vars_num; i++)
+        {
+            if(m_jit_batch_steps[i])
+            {
+                T * buffer = & m_jit_batch_buffer[i * lanes];
+                std::copy(m_jit_batch_args[i], m_jit_batch_args[i] + tail, buffer);
+                std::fill(buffer + tail, buffer + lanes, buffer[0]);
+                m_jit_batch_args[i] = buffer;
+            }
+        }
+        T * tail_result = & m_jit_batch_buffer[vars_num * lanes];
+        m_jit_batch_size = 1;
+        m_jit_batch_result = tail_result;
+        m_jit_func();
+        std::copy(tail_result, tail_result + tail, result + full * lanes);
+    }
+
+    for(std::size_t i = 0; i < vars_num; i++)
+        m_jit_batch_steps[i] = 0;
+}
+
+#endif
+
+#endif // EVALUATOR_COMPILE_BATCH_H
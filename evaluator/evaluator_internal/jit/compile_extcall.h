@@ -9,14 +9,16 @@
 #include <sstream>
 #include "common.h"
 #include "opcodes.h"
+#include "code_arena.h"
 #include "func_templates.h"
 #include "oper_templates.h"
 #include "../type_detection.h"
 #include "../../evaluator.h"
 
-// Compile expression, all functions will be called from 'functions' and 'operators' containers
+// Compile expression, all functions will be called from 'functions' and 'operators' containers,
+// if 'batch' is true, the code will be a loop over all points of calculate_batch()
 template<typename T>
-bool evaluator<T>::compile_extcall()
+bool evaluator<T>::compile_extcall(bool batch)
 {
 #if !defined(EVALUATOR_JIT_DISABLE)
     using namespace evaluator_internal;
@@ -28,25 +30,13 @@ bool evaluator<T>::compile_extcall()
         return false;
     }
 
-    if(!m_jit_code || !m_jit_code_size)
-    {
-        m_jit_code_size = 128 * 1024; // 128 KiB
-        m_jit_code = reinterpret_cast<char *>(exec_alloc(m_jit_code_size));
-        std::size_t call_addr = reinterpret_cast<std::size_t>(& m_jit_func);
-        std::size_t code_addr = reinterpret_cast<std::size_t>(& m_jit_code);
-        memcpy(reinterpret_cast<void *>(call_addr), reinterpret_cast<void *>(code_addr), sizeof(void *));
-    }
-    memset(m_jit_code, '\xc3', m_jit_code_size);
-
-    if(!m_jit_stack || !m_jit_stack_size)
-    {
-        m_jit_stack_size = 128 * 1024 / sizeof(T); // 128 KiB
-        m_jit_stack = new T [m_jit_stack_size];
-    }
-    memset(m_jit_stack, 0, m_jit_stack_size);
+    m_is_compiled = false;
+    jit_stack_init();
 
-    char * curr = m_jit_code;
+    code_buffer code;
+    char * curr = code.begin();
     T * jit_stack_curr = m_jit_stack;
+    jit_batch_init(batch);
 
 #if defined(EVALUATOR_JIT_X86) || defined(EVALUATOR_JIT_X64) || defined(EVALUATOR_JIT_X32)
 
@@ -59,59 +49,70 @@ bool evaluator<T>::compile_extcall()
         return false;
     }
 
-    if(is_float<T>() || is_double<T>())
+    if(is_float<T>() || is_double<T>() || is_complex_float<T>() || is_complex_double<T>())
     {
+        // Arguments are passed by pointer, so constants and variables are used
+        // from their own memory, only results of calls are written to stack,
+        // results of common subexpressions are written to their temporaries
+        std::vector<const T *> st;
         for(typename std::vector<evaluator_object<T> >::const_iterator
-            it = m_expression.begin(), it_end = m_expression.end(); it != it_end; ++it)
+            it = m_program->expression.begin(), it_end = m_program->expression.end(); it != it_end; ++it)
         {
-            if(it->is_constant() || it->is_variable())
-            {
-                fld_ptr(curr, it->raw_value());
-                fstp_ptr(curr, jit_stack_curr++);
-            }
-            else if(it->is_operator())
+            const cse_action cse = cse_action_at(it);
+            if(cse.kind == CSE_LOAD)
             {
-                jit_stack_curr -= 2;
-                f2arg.call(curr, it->raw_oper(), jit_stack_curr, jit_stack_curr + 1, jit_stack_curr);
+                st.push_back(& m_cse_values[cse.temp]);
                 jit_stack_curr++;
+                it = m_program->expression.begin() + cse.end;
             }
-            else if(it->is_function())
+            else if(it->is_constant() || (it->is_variable() && !m_jit_batch))
             {
-                jit_stack_curr--;
-                f1arg.call(curr, it->raw_func(), jit_stack_curr, jit_stack_curr);
+                st.push_back(obj_value(*it));
                 jit_stack_curr++;
             }
-        }
-
-        jit_stack_curr--;
-    }
-    else if(is_complex_float<T>() || is_complex_double<T>())
-    {
-        for(typename std::vector<evaluator_object<T> >::const_iterator
-            it = m_expression.begin(), it_end = m_expression.end(); it != it_end; ++it)
-        {
-            if(it->is_constant() || it->is_variable())
+            else if(it->is_variable())
             {
-                fld_ptr_real(curr, it->raw_value());
-                fstp_ptr_real(curr, jit_stack_curr);
-                fld_ptr_imag(curr, it->raw_value());
-                fstp_ptr_imag(curr, jit_stack_curr++);
+                if(is_float<T>() || is_double<T>())
+                {
+                    jit_fld_object(curr, *it);
+                    fstp_ptr(curr, jit_stack_curr);
+                }
+                else
+                {
+                    jit_copy_object(curr, *it, jit_stack_curr);
+                }
+                st.push_back(jit_stack_curr++);
             }
             else if(it->is_operator())
             {
                 jit_stack_curr -= 2;
-                f2arg.call(curr, it->raw_oper(), jit_stack_curr, jit_stack_curr + 1, jit_stack_curr);
+                T * dst = (cse.kind == CSE_STORE) ? & m_cse_values[cse.temp] : jit_stack_curr;
+                f2arg.call(curr, it->raw_oper(), st[st.size() - 2], st[st.size() - 1], dst);
+                st.pop_back();
+                st.back() = dst;
                 jit_stack_curr++;
             }
             else if(it->is_function())
             {
                 jit_stack_curr--;
-                f1arg.call(curr, it->raw_func(), jit_stack_curr, jit_stack_curr);
+                T * dst = (cse.kind == CSE_STORE) ? & m_cse_values[cse.temp] : jit_stack_curr;
+                f1arg.call(curr, it->raw_func(), st.back(), dst);
+                st.back() = dst;
                 jit_stack_curr++;
             }
         }
 
         jit_stack_curr--;
+
+        if(st.size() == 1 && st.back() != m_jit_stack)
+            jit_copy_value(curr, st.back(), m_jit_stack);
+
+        if(m_jit_batch)
+        {
+            if(is_float<T>() || is_double<T>())
+                fld_ptr(curr, m_jit_stack);
+            jit_batch_loop(curr, code.begin());
+        }
     }
     else
     {
@@ -135,9 +136,14 @@ bool evaluator<T>::compile_extcall()
         return false;
     }
 
+    if(!jit_install(code.begin(), curr))
+        return false;
+    m_jit_compiler = & evaluator::compile_extcall;
+    m_jit_compiler_arg = batch;
     m_is_compiled = true;
     return true;
 #else
+    (void)(batch);
     m_error_string = "JIT is disabled!";
     return false;
 #endif
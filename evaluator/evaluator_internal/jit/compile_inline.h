@@ -3,22 +3,26 @@
 
 #include <vector>
 #include <string>
+#include <algorithm>
 #include <cstring>
 #include <cstdlib>
 #include <complex>
 #include <sstream>
 #include "common.h"
 #include "opcodes.h"
+#include "code_arena.h"
 #include "func_templates.h"
 #include "oper_templates.h"
 #include "real_templates.h"
 #include "complex_templates.h"
+#include "reg_alloc.h"
 #include "../type_detection.h"
 #include "../../evaluator.h"
 
-// Compile expression, all functions will be inlined
+// Compile expression, all functions will be inlined,
+// if 'batch' is true, the code will be a loop over all points of calculate_batch()
 template<typename T>
-bool evaluator<T>::compile_inline()
+bool evaluator<T>::compile_inline(bool batch)
 {
 #if !defined(EVALUATOR_JIT_DISABLE)
     using namespace evaluator_internal;
@@ -30,90 +34,145 @@ bool evaluator<T>::compile_inline()
         return false;
     }
 
-    if(!m_jit_code || !m_jit_code_size)
-    {
-        m_jit_code_size = 128 * 1024; // 128 KiB
-        m_jit_code = reinterpret_cast<char *>(exec_alloc(m_jit_code_size));
-        std::size_t call_addr = reinterpret_cast<std::size_t>(& m_jit_func);
-        std::size_t code_addr = reinterpret_cast<std::size_t>(& m_jit_code);
-        memcpy(reinterpret_cast<void *>(call_addr), reinterpret_cast<void *>(code_addr), sizeof(void *));
-    }
-    memset(m_jit_code, '\xc3', m_jit_code_size);
-
-    if(!m_jit_stack || !m_jit_stack_size)
-    {
-        m_jit_stack_size = 128 * 1024 / sizeof(T); // 128 KiB
-        m_jit_stack = new T [m_jit_stack_size];
-    }
-    memset(m_jit_stack, 0, m_jit_stack_size);
+    m_is_compiled = false;
+    jit_stack_init();
 
-    char * curr = m_jit_code;
+    code_buffer code;
+    char * curr = code.begin();
     T * jit_stack_curr = m_jit_stack;
+    jit_batch_init(batch);
 
 #if defined(EVALUATOR_JIT_X86) || defined(EVALUATOR_JIT_X64) || defined(EVALUATOR_JIT_X32)
 
     if(is_float<T>() || is_double<T>())
     {
-        char * last_push_pos = NULL;
-        T * last_push_val = NULL;
+        // Values of evaluation stack are kept on x87 stack, registers which are needed
+        // by inlined functions are reserved, operator ^ may also load its second argument
+        int temp_regs = 0;
+        for(typename std::vector<evaluator_object<T> >::const_iterator
+            it = m_program->expression.begin(), it_end = m_program->expression.end(); it != it_end; ++it)
+        {
+            if(it->is_operator() && obj_str(*it)[0] == '^')
+                temp_regs = std::max(temp_regs, real_temp_regs(obj_str(*it)) + 1);
+            else if(it->is_function())
+                temp_regs = std::max(temp_regs, real_temp_regs(obj_str(*it)));
+        }
+        jit_x87_stack<T> st(m_jit_stack, 8 - temp_regs);
+
         for(typename std::vector<evaluator_object<T> >::const_iterator
-            it = m_expression.begin(), it_end = m_expression.end(); it != it_end; ++it)
+            it = m_program->expression.begin(), it_end = m_program->expression.end(); it != it_end; ++it)
         {
-            if(it->is_constant() || it->is_variable())
+            const cse_action cse = cse_action_at(it);
+            if(cse.kind == CSE_LOAD)
             {
-                fld_ptr(curr, it->raw_value());
-                last_push_pos = curr;
-                last_push_val = jit_stack_curr;
-                fstp_ptr(curr, jit_stack_curr++);
+                // Common subexpression is used from its temporary
+                st.push_mem(& m_cse_values[cse.temp]);
+                it = m_program->expression.begin() + cse.end;
+            }
+            else if(it->is_constant() || (it->is_variable() && !m_jit_batch))
+            {
+                // Will be used from memory
+                st.push_mem(obj_value(*it));
+            }
+            else if(it->is_variable())
+            {
+                st.reserve(curr);
+                jit_fld_object(curr, *it);
+                st.push_reg();
             }
             else if(it->is_operator())
             {
-                jit_stack_curr -= 2;
-                if(last_push_val == jit_stack_curr + 1)
+                const T * left = st.ptr(1), * right = st.ptr(0);
+                const std::string op = obj_str(*it);
+                if(op[0] == '^')
                 {
-                    curr = last_push_pos;
-                    fld_ptr(curr, jit_stack_curr);
-                    fxch(curr);
+                    // st(0) = left, st(1) = right
+                    if(left && right)
+                    {
+                        st.reserve(curr);
+                        fld_ptr(curr, right);
+                        fld_ptr(curr, left);
+                    }
+                    else if(left)
+                        fld_ptr(curr, left);
+                    else if(right)
+                    {
+                        fld_ptr(curr, right);
+                        fxch(curr);
+                    }
+                    else
+                        fxch(curr);
+                    real_pow(curr);
                 }
-                else
+                else if(!left && !right)
                 {
-                    fld_ptr(curr, jit_stack_curr++);
-                    fld_ptr(curr, jit_stack_curr--);
+                    if     (op[0] == '+')
+                        fadd(curr);
+                    else if(op[0] == '-')
+                        fsub(curr);
+                    else if(op[0] == '*')
+                        fmul(curr);
+                    else if(op[0] == '/')
+                        fdiv(curr);
+                    else
+                    {
+                        m_error_string = "Unsupported operator " + obj_str(*it);
+                        return false;
+                    }
                 }
-
-                const std::string op = it->str();
-                if     (op[0] == '+')
-                    fadd(curr);
-                else if(op[0] == '-')
-                    fsub(curr);
-                else if(op[0] == '*')
-                    fmul(curr);
-                else if(op[0] == '/')
-                    fdiv(curr);
-                else if(op[0] == '^')
+                else if(left && !right)
                 {
-                    fxch(curr);
-                    real_pow(curr);
+                    // st(0) = right
+                    if     (op[0] == '+')
+                        fadd_ptr(curr, left);
+                    else if(op[0] == '-')
+                        fsubr_ptr(curr, left);
+                    else if(op[0] == '*')
+                        fmul_ptr(curr, left);
+                    else if(op[0] == '/')
+                        fdivr_ptr(curr, left);
+                    else
+                    {
+                        m_error_string = "Unsupported operator " + obj_str(*it);
+                        return false;
+                    }
                 }
                 else
                 {
-                    m_error_string = "Unsupported operator " + it->str();
-                    return false;
+                    // st(0) = left
+                    if(left)
+                    {
+                        st.reserve(curr);
+                        fld_ptr(curr, left);
+                    }
+                    if     (op[0] == '+')
+                        fadd_ptr(curr, right);
+                    else if(op[0] == '-')
+                        fsub_ptr(curr, right);
+                    else if(op[0] == '*')
+                        fmul_ptr(curr, right);
+                    else if(op[0] == '/')
+                        fdiv_ptr(curr, right);
+                    else
+                    {
+                        m_error_string = "Unsupported operator " + obj_str(*it);
+                        return false;
+                    }
                 }
-
-                last_push_pos = curr;
-                last_push_val = jit_stack_curr;
-                fstp_ptr(curr, jit_stack_curr++);
+                st.pop();
+                st.pop();
+                st.push_reg();
             }
-            else if(it->is_function())
+            else if(it->is_function() && obj_str(*it) != "real" && obj_str(*it) != "conj")
             {
-                jit_stack_curr--;
-                if(last_push_val == jit_stack_curr)
-                    curr = last_push_pos;
-                else
-                    fld_ptr(curr, jit_stack_curr);
+                // real() and conj() of real value are the value itself
+                const std::string fu = obj_str(*it);
+                if(st.ptr(0))
+                {
+                    st.reserve(curr);
+                    fld_ptr(curr, st.ptr(0));
+                }
 
-                const std::string fu = it->str();
                 if     (fu == "sin")
                     fsin(curr);
                 else if(fu == "cos")
@@ -163,34 +222,48 @@ bool evaluator<T>::compile_inline()
                 }
                 else if(fu == "arg")
                     real_arg(curr);
-                else if(fu != "real" && fu != "conj")
+                else
                 {
-                    m_error_string = "Unsupported function " + it->str();
+                    m_error_string = "Unsupported function " + obj_str(*it);
                     return false;
                 }
-                last_push_pos = curr;
-                last_push_val = jit_stack_curr;
-                fstp_ptr(curr, jit_stack_curr++);
+                st.pop();
+                st.push_reg();
             }
+            if(cse.kind == CSE_STORE)
+                st.copy_top(curr, & m_cse_values[cse.temp]);
         }
 
+        if(st.size() == 1)
+        {
+            if(st.ptr(0))
+                fld_ptr(curr, st.ptr(0));
+            if(m_jit_batch)
+                jit_batch_loop(curr, code.begin());
+            else
+                fstp_ptr(curr, m_jit_stack);
+        }
+        jit_stack_curr += st.size();
         jit_stack_curr--;
     }
     else if(is_complex_float<T>() || is_complex_double<T>())
     {
         for(typename std::vector<evaluator_object<T> >::const_iterator
-            it = m_expression.begin(), it_end = m_expression.end(); it != it_end; ++it)
+            it = m_program->expression.begin(), it_end = m_program->expression.end(); it != it_end; ++it)
         {
-            if(it->is_constant() || it->is_variable())
+            const cse_action cse = cse_action_at(it);
+            if(cse.kind == CSE_LOAD)
             {
-                fld_ptr_real(curr, it->raw_value());
-                fstp_ptr_real(curr, jit_stack_curr);
-                fld_ptr_imag(curr, it->raw_value());
-                fstp_ptr_imag(curr, jit_stack_curr++);
+                jit_copy_value(curr, & m_cse_values[cse.temp], jit_stack_curr++);
+                it = m_program->expression.begin() + cse.end;
+            }
+            else if(it->is_constant() || it->is_variable())
+            {
+                jit_copy_object(curr, *it, jit_stack_curr++);
             }
             else if(it->is_operator())
             {
-                const std::string op = it->str();
+                const std::string op = obj_str(*it);
                 jit_stack_curr -= 2;
                 if(op[0] == '+')
                     complex_add(curr, jit_stack_curr, jit_stack_curr + 1, jit_stack_curr);
@@ -204,14 +277,14 @@ bool evaluator<T>::compile_inline()
                     complex_pow(curr, jit_stack_curr, jit_stack_curr + 1, jit_stack_curr, jit_stack_curr + 2);
                 else
                 {
-                    m_error_string = "Unsupported operator " + it->str();
+                    m_error_string = "Unsupported operator " + obj_str(*it);
                     return false;
                 }
                 jit_stack_curr++;
             }
             else if(it->is_function())
             {
-                const std::string fu = it->str();
+                const std::string fu = obj_str(*it);
                 jit_stack_curr--;
                 if(fu == "real")
                     complex_real(curr, jit_stack_curr);
@@ -259,14 +332,19 @@ bool evaluator<T>::compile_inline()
                     complex_atanh(curr, jit_stack_curr, jit_stack_curr, jit_stack_curr + 1);
                 else
                 {
-                    m_error_string = "Unsupported function " + it->str();
+                    m_error_string = "Unsupported function " + obj_str(*it);
                     return false;
                 }
                 jit_stack_curr++;
             }
+            if(cse.kind == CSE_STORE)
+                jit_copy_value(curr, jit_stack_curr - 1, & m_cse_values[cse.temp]);
         }
 
         jit_stack_curr--;
+
+        if(m_jit_batch)
+            jit_batch_loop(curr, code.begin());
     }
     else
     {
@@ -290,9 +368,14 @@ bool evaluator<T>::compile_inline()
         return false;
     }
 
+    if(!jit_install(code.begin(), curr))
+        return false;
+    m_jit_compiler = & evaluator::compile_inline;
+    m_jit_compiler_arg = batch;
     m_is_compiled = true;
     return true;
 #else
+    (void)(batch);
     m_error_string = "JIT is disabled!";
     return false;
 #endif
@@ -0,0 +1,209 @@
+#if !defined(EVALUATOR_COMPILE_SIMD_H)
+#define EVALUATOR_COMPILE_SIMD_H
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <sstream>
+#include "common.h"
+#include "opcodes.h"
+#include "code_arena.h"
+#include "opcodes_sse.h"
+#include "opcodes_avx.h"
+#include "vector_kernels.h"
+#include "reg_alloc.h"
+#include "../type_detection.h"
+#include "../../evaluator.h"
+
+#if !defined(EVALUATOR_JIT_DISABLE)
+
+// Load value of constant or variable 'obj' to all elements of vector register 'reg'
+template<typename T>
+void evaluator<T>::jit_avx_object(char *& code_curr, int l, int reg, const evaluator_internal::evaluator_object<T> & obj)
+{
+    using namespace evaluator_internal_jit;
+
+    if(obj.is_variable())
+        avx_load_pptr(code_curr, l, reg, & m_jit_batch_args[jit_batch_index(obj.index())]);
+    else
+        avx_broadcast(code_curr, l, reg, obj_value(obj));
+}
+
+#endif
+
+// Compile expression to vector AVX2 or AVX-512 code, float and double types only,
+// the code is a loop over all points of calculate_batch(), several points per iteration,
+// AVX-512 is used if 'avx512' is true and CPU supports it
+template<typename T>
+bool evaluator<T>::compile_simd(bool avx512)
+{
+#if !defined(EVALUATOR_JIT_DISABLE)
+    using namespace evaluator_internal;
+    using namespace evaluator_internal_jit;
+
+    if(!is_parsed())
+    {
+        m_error_string = "Not parsed!";
+        return false;
+    }
+
+    m_is_compiled = false;
+    if(!is_float<T>() && !is_double<T>())
+    {
+        m_error_string = "Unsupported type `" + get_type_name<T>() + "`!";
+        return false;
+    }
+
+#if defined(EVALUATOR_JIT_X64)
+
+    // Vector length: 1 = ymm, 2 = zmm
+    int l;
+    if(avx512 && cpu_has_avx512f())
+        l = 2;
+    else if(cpu_has_avx2())
+        l = 1;
+    else
+    {
+        m_error_string = "AVX2 is not supported by CPU!";
+        return false;
+    }
+    const std::size_t lanes = (static_cast<std::size_t>(16) << l) / sizeof(T);
+
+    jit_stack_init();
+
+    code_buffer code;
+    char * curr = code.begin();
+    // Each element of stack is a full vector
+    T * jit_stack_curr = m_jit_stack;
+    jit_batch_init(true);
+    m_jit_batch_lanes = lanes;
+    const void * lanes_arg = reinterpret_cast<const void *>(lanes);
+
+    sse_enter(curr);
+    char * loop_begin = curr;
+
+    // Values of evaluation stack are kept in vector registers,
+    // kernels work in memory, so all registers are stored before calls
+    jit_reg_stack<T, jit_avx_emitter<T> > st(jit_avx_emitter<T>(l, lanes), m_jit_stack, sse_regs_num());
+    for(typename std::vector<evaluator_object<T> >::const_iterator
+        it = m_program->expression.begin(), it_end = m_program->expression.end(); it != it_end; ++it)
+    {
+        if(it->is_constant() || it->is_variable())
+        {
+            const int reg = st.alloc(curr);
+            jit_avx_object(curr, l, reg, *it);
+            st.push_reg(reg);
+        }
+        else if(it->is_operator())
+        {
+            const std::string op = obj_str(*it);
+            if(op[0] == '+' || op[0] == '-' || op[0] == '*' || op[0] == '/')
+            {
+                const int left = st.load(curr, 1);
+                const int right = st.load(curr, 0);
+                if     (op[0] == '+')
+                    avx_add<T>(curr, l, left, left, right);
+                else if(op[0] == '-')
+                    avx_sub<T>(curr, l, left, left, right);
+                else if(op[0] == '*')
+                    avx_mul<T>(curr, l, left, left, right);
+                else
+                    avx_div<T>(curr, l, left, left, right);
+                st.pop();
+                st.pop();
+                st.push_reg(left);
+            }
+            else
+            {
+                const void * kernel = vector_oper_kernel(op[0], T());
+                if(!kernel)
+                {
+                    m_error_string = "Unsupported operator " + obj_str(*it);
+                    return false;
+                }
+                // Result is written over left argument in its slot
+                st.spill_all(curr);
+                avx_call(curr, kernel, st.slot(1), st.slot(0), lanes_arg);
+                st.pop();
+            }
+        }
+        else if(it->is_function())
+        {
+            const std::string fu = obj_str(*it);
+            if     (fu == "sqrt")
+            {
+                const int reg = st.load(curr, 0);
+                avx_sqrt<T>(curr, l, reg, reg);
+            }
+            else if(fu == "abs")
+            {
+                const int reg = st.load(curr, 0);
+                const int mask = st.alloc(curr);
+                avx_broadcast(curr, l, mask, avx_sign_mask<T>());
+                avx_andn<T>(curr, l, reg, mask, reg);
+            }
+            else if(fu == "imag")
+            {
+                st.pop();
+                const int reg = st.alloc(curr);
+                avx_xor<T>(curr, l, reg, reg, reg);
+                st.push_reg(reg);
+            }
+            else if(fu != "real" && fu != "conj")
+            {
+                const void * kernel = vector_func_kernel(fu, T());
+                if(!kernel)
+                {
+                    m_error_string = "Unsupported function " + obj_str(*it);
+                    return false;
+                }
+                // Result is written over argument in its slot
+                st.spill_all(curr);
+                avx_call(curr, kernel, st.slot(0), lanes_arg, NULL);
+            }
+        }
+    }
+
+    if(st.size() == 1)
+    {
+        const int reg = st.load(curr, 0);
+        avx_store_pptr(curr, l, & m_jit_batch_result, reg);
+        jit_batch_next(curr, loop_begin);
+    }
+    jit_stack_curr += st.size() * lanes;
+    jit_stack_curr -= lanes;
+
+    vzeroupper(curr);
+    sse_leave(curr);
+    ret(curr);
+
+    if(jit_stack_curr != m_jit_stack)
+    {
+        std::stringstream sst;
+        sst << "Stack size equal " << static_cast<std::size_t>(jit_stack_curr - m_jit_stack) / lanes;
+        m_error_string = sst.str();
+        return false;
+    }
+
+    if(!jit_install(code.begin(), curr))
+        return false;
+    m_jit_compiler = & evaluator::compile_simd;
+    m_jit_compiler_arg = avx512;
+    m_is_compiled = true;
+    return true;
+
+#else
+    (void)(avx512);
+    m_error_string = "Unsupported arch!";
+    return false;
+#endif
+
+#else
+    (void)(avx512);
+    m_error_string = "JIT is disabled!";
+    return false;
+#endif
+}
+
+#endif // EVALUATOR_COMPILE_SIMD_H
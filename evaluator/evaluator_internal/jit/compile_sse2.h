@@ -0,0 +1,403 @@
+#if !defined(EVALUATOR_COMPILE_SSE2_H)
+#define EVALUATOR_COMPILE_SSE2_H
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <sstream>
+#include "common.h"
+#include "opcodes.h"
+#include "code_arena.h"
+#include "opcodes_sse.h"
+#include "sse_kernels.h"
+#include "reg_alloc.h"
+#include "../type_detection.h"
+#include "../../evaluator.h"
+
+#if !defined(EVALUATOR_JIT_DISABLE)
+
+// Load value of constant or variable 'obj' to register xmm[reg]
+template<typename T>
+void evaluator<T>::jit_movs_object(char *& code_curr, int reg, const evaluator_internal::evaluator_object<T> & obj)
+{
+    using namespace evaluator_internal_jit;
+
+    if(m_jit_batch && obj.is_variable())
+        movs_load_pptr(code_curr, reg, & m_jit_batch_args[jit_batch_index(obj.index())]);
+    else
+        movs_load(code_curr, reg, obj_value(obj));
+}
+
+#endif
+
+// Compile expression to scalar SSE2 code, float and double types only,
+// if 'batch' is true, the code will be a loop over all points of calculate_batch()
+template<typename T>
+bool evaluator<T>::compile_sse2(bool batch)
+{
+#if !defined(EVALUATOR_JIT_DISABLE)
+    return jit_compile_sse2(batch, false);
+#else
+    (void)(batch);
+    m_error_string = "JIT is disabled!";
+    return false;
+#endif
+}
+
+// Compile expression to reentrant scalar SSE2 kernel, float and double types only, x64 only
+template<typename T>
+bool evaluator<T>::compile_kernel()
+{
+#if !defined(EVALUATOR_JIT_DISABLE)
+    return jit_compile_sse2(false, true);
+#else
+    m_error_string = "JIT is disabled!";
+    return false;
+#endif
+}
+
+// Compiled reentrant kernel, NULL if expression is not compiled by compile_kernel()
+template<typename T>
+typename evaluator<T>::kernel_type evaluator<T>::get_kernel() const
+{
+    kernel_type kernel = NULL;
+#if !defined(EVALUATOR_JIT_DISABLE)
+    if(m_is_compiled && m_jit_kernel)
+        memcpy(& kernel, & m_jit_func, sizeof(kernel));
+#endif
+    return kernel;
+}
+
+// Names of variables in order of 'vars' argument of kernel
+template<typename T>
+const std::vector<std::string> & evaluator<T>::get_kernel_vars() const
+{
+#if !defined(EVALUATOR_JIT_DISABLE)
+    return m_jit_kernel_names;
+#else
+    static const std::vector<std::string> empty;
+    return empty;
+#endif
+}
+
+// Number of values in 'scratch' argument of kernel
+template<typename T>
+std::size_t evaluator<T>::get_kernel_scratch_size() const
+{
+#if !defined(EVALUATOR_JIT_DISABLE)
+    return m_jit_kernel_scratch_size;
+#else
+    return 0;
+#endif
+}
+
+#if !defined(EVALUATOR_JIT_DISABLE)
+
+// Kernel mode: call kernel with current values of variables
+template<typename T>
+void evaluator<T>::jit_kernel_run(T & result)
+{
+    for(std::size_t i = 0; i < m_jit_kernel_slots.size(); i++)
+        m_jit_kernel_values[i] = m_variables[m_jit_kernel_slots[i]];
+    get_kernel()(m_jit_kernel_values.empty() ? NULL : & m_jit_kernel_values[0], m_jit_stack, & result);
+}
+
+// Share reentrant kernel of 'other', previous compiled code is released,
+// variables of kernel have the same indices as in 'other'
+template<typename T>
+void evaluator<T>::jit_share_kernel(const evaluator & other)
+{
+    evaluator_internal_jit::code_arena_retain(other.m_jit_code);
+    jit_release();
+    m_jit_code = other.m_jit_code;
+    m_jit_code_size = other.m_jit_code_size;
+    m_jit_func = other.m_jit_func;
+    m_jit_batch = false;
+    m_jit_kernel = true;
+    m_jit_kernel_names = other.m_jit_kernel_names;
+    m_jit_kernel_slots = other.m_jit_kernel_slots;
+    m_jit_kernel_values.resize(m_jit_kernel_slots.size());
+    m_jit_kernel_scratch_size = other.m_jit_kernel_scratch_size;
+    if(m_jit_stack_size < std::max(m_jit_kernel_scratch_size, static_cast<std::size_t>(1)))
+    {
+        delete [] m_jit_stack;
+        m_jit_stack_size = std::max(m_jit_kernel_scratch_size, static_cast<std::size_t>(1));
+        m_jit_stack = new T [m_jit_stack_size];
+    }
+    m_is_compiled = true;
+}
+
+// Compile expression to scalar SSE2 code, see compile_sse2() and compile_kernel()
+template<typename T>
+bool evaluator<T>::jit_compile_sse2(bool batch, bool kernel)
+{
+    using namespace evaluator_internal;
+    using namespace evaluator_internal_jit;
+
+    if(!is_parsed())
+    {
+        m_error_string = "Not parsed!";
+        return false;
+    }
+
+    m_is_compiled = false;
+    if(!is_float<T>() && !is_double<T>())
+    {
+        m_error_string = "Unsupported type `" + get_type_name<T>() + "`!";
+        return false;
+    }
+    if(!cpu_has_sse2())
+    {
+        m_error_string = "SSE2 is not supported by CPU!";
+        return false;
+    }
+
+    jit_stack_init();
+
+    code_buffer code;
+    char * curr = code.begin();
+    T * jit_stack_curr = m_jit_stack;
+    jit_batch_init(batch);
+
+#if !defined(EVALUATOR_JIT_X64)
+    if(kernel)
+    {
+        m_error_string = "Unsupported arch!";
+        return false;
+    }
+#endif
+
+#if defined(EVALUATOR_JIT_X86) || defined(EVALUATOR_JIT_X64) || defined(EVALUATOR_JIT_X32)
+
+    // Kernel mode: variables in order of first use, stack slots in scratch memory
+    m_jit_kernel_names.clear();
+    m_jit_kernel_slots.clear();
+    m_jit_kernel_scratch_size = 0;
+    if(kernel)
+    {
+        for(typename std::vector<evaluator_object<T> >::const_iterator
+            it = m_program->expression.begin(), it_end = m_program->expression.end(); it != it_end; ++it)
+        {
+            if(it->is_variable() && std::find(m_jit_kernel_slots.begin(), m_jit_kernel_slots.end(),
+                                              it->index()) == m_jit_kernel_slots.end())
+            {
+                m_jit_kernel_names.push_back(obj_str(*it));
+                m_jit_kernel_slots.push_back(it->index());
+            }
+        }
+        m_jit_kernel_values.resize(m_jit_kernel_slots.size());
+        m_jit_kernel_scratch_size = stack_depth();
+    }
+    // Kernel mode: constants are copied to the beginning of code and skipped by jump,
+    // so the kernel does not depend on evaluator and may be shared by its copies
+    std::vector<std::pair<const T *, const T *> > consts;
+    if(kernel)
+    {
+        std::size_t consts_num = 0;
+        for(typename std::vector<evaluator_object<T> >::const_iterator
+            it = m_program->expression.begin(), it_end = m_program->expression.end(); it != it_end; ++it)
+        {
+            if(it->is_constant())
+                consts_num++;
+        }
+        // Code blocks are aligned by 16 bytes
+        T * pool = reinterpret_cast<T *>(code.begin() + 16);
+        char * entry = reinterpret_cast<char *>(pool + consts_num);
+        jmp_long(curr, entry);
+        for(typename std::vector<evaluator_object<T> >::const_iterator
+            it = m_program->expression.begin(), it_end = m_program->expression.end(); it != it_end; ++it)
+        {
+            if(it->is_constant())
+            {
+                * pool = obj_eval(*it);
+                consts.push_back(std::make_pair(obj_value(*it), const_cast<const T *>(pool)));
+                pool++;
+            }
+        }
+        curr = entry;
+    }
+    std::vector<const T *> vars;
+    for(std::size_t i = 0; i < m_jit_kernel_slots.size(); i++)
+        vars.push_back(m_variables.data() + m_jit_kernel_slots[i]);
+    const sse_memory<T> mem = kernel ? sse_memory<T>(vars, consts, m_jit_stack, m_jit_stack_size) : sse_memory<T>();
+
+    if(kernel)
+        sse_kernel_enter(curr);
+    else
+        sse_enter(curr);
+    char * loop_begin = curr;
+
+    // Values of evaluation stack are kept in xmm registers, constants and variables
+    // are used from memory, all registers are stored before calls
+    jit_reg_stack<T, jit_sse_emitter<T> > st(jit_sse_emitter<T>(mem), m_jit_stack, sse_regs_num());
+    for(typename std::vector<evaluator_object<T> >::const_iterator
+        it = m_program->expression.begin(), it_end = m_program->expression.end(); it != it_end; ++it)
+    {
+        if(it->is_constant() || (it->is_variable() && !m_jit_batch))
+        {
+            st.push_mem(obj_value(*it));
+        }
+        else if(it->is_variable())
+        {
+            const int reg = st.alloc(curr);
+            jit_movs_object(curr, reg, *it);
+            st.push_reg(reg);
+        }
+        else if(it->is_operator())
+        {
+            const std::string op = obj_str(*it);
+            int reg;
+            if(op[0] == '+' || op[0] == '-' || op[0] == '*' || op[0] == '/')
+            {
+                // Result replaces left argument, commutative operators may use right one
+                std::size_t dst = 1, src = 0;
+                if((op[0] == '+' || op[0] == '*') && st.reg(1) < 0 && st.reg(0) >= 0)
+                    std::swap(dst, src);
+                reg = st.load(curr, dst);
+                if(st.reg(src) >= 0)
+                {
+                    if     (op[0] == '+')
+                        adds<T>(curr, reg, st.reg(src));
+                    else if(op[0] == '-')
+                        subs<T>(curr, reg, st.reg(src));
+                    else if(op[0] == '*')
+                        muls<T>(curr, reg, st.reg(src));
+                    else
+                        divs<T>(curr, reg, st.reg(src));
+                }
+                else
+                {
+                    if     (op[0] == '+')
+                        adds_ptr(curr, reg, st.ptr(src), mem);
+                    else if(op[0] == '-')
+                        subs_ptr(curr, reg, st.ptr(src), mem);
+                    else if(op[0] == '*')
+                        muls_ptr(curr, reg, st.ptr(src), mem);
+                    else
+                        divs_ptr(curr, reg, st.ptr(src), mem);
+                }
+            }
+            else
+            {
+                const void * kernel = sse_oper_kernel(op[0], T());
+                if(!kernel)
+                {
+                    m_error_string = "Unsupported operator " + obj_str(*it);
+                    return false;
+                }
+                // Arguments in xmm0 and xmm1
+                st.spill_all(curr, 2);
+                if(st.reg(0) == 0)
+                    st.spill(curr, 0);
+                if(st.reg(1) >= 0)
+                    movaps(curr, 0, st.reg(1));
+                else
+                    movs_load(curr, 0, st.ptr(1), mem);
+                if(st.reg(0) >= 0)
+                    movaps(curr, 1, st.reg(0));
+                else
+                    movs_load(curr, 1, st.ptr(0), mem);
+                sse_call<T>(curr, kernel, 2);
+                reg = 0;
+            }
+            st.pop();
+            st.pop();
+            st.push_reg(reg);
+        }
+        else if(it->is_function())
+        {
+            const std::string fu = obj_str(*it);
+            if(fu == "real" || fu == "conj")
+                continue;
+            int reg;
+            if(fu == "imag")
+            {
+                st.pop();
+                reg = st.alloc(curr);
+                xorps(curr, reg, reg);
+                st.push_reg(reg);
+                continue;
+            }
+            if(fu == "sqrt")
+            {
+                reg = st.load(curr, 0);
+                sqrts<T>(curr, reg, reg);
+            }
+            else if(fu == "abs")
+            {
+                reg = st.load(curr, 0);
+                abss<T>(curr, reg, st.alloc(curr));
+            }
+            else
+            {
+                const void * kernel = sse_func_kernel(fu, T());
+                if(!kernel)
+                {
+                    m_error_string = "Unsupported function " + obj_str(*it);
+                    return false;
+                }
+                // Argument in xmm0
+                st.spill_all(curr, 1);
+                if(st.reg(0) > 0)
+                    movaps(curr, 0, st.reg(0));
+                else if(st.reg(0) < 0)
+                    movs_load(curr, 0, st.ptr(0), mem);
+                sse_call<T>(curr, kernel, 1);
+                reg = 0;
+            }
+            st.pop();
+            st.push_reg(reg);
+        }
+    }
+
+    if(st.size() == 1)
+    {
+        const int reg = st.load(curr, 0);
+        if(kernel)
+            sse_kernel_store<T>(curr, reg);
+        else if(m_jit_batch)
+        {
+            movs_store_pptr(curr, & m_jit_batch_result, reg);
+            jit_batch_next(curr, loop_begin);
+        }
+        else
+            movs_store(curr, m_jit_stack, reg);
+    }
+    jit_stack_curr += st.size();
+    jit_stack_curr--;
+
+    if(kernel)
+        sse_kernel_leave(curr);
+    else
+        sse_leave(curr);
+    ret(curr);
+
+#else
+    (void)(curr);
+    m_error_string = "Unsupported arch!";
+    return false;
+#endif
+
+    if(jit_stack_curr != m_jit_stack)
+    {
+        std::stringstream sst;
+        sst << "Stack size equal " << static_cast<std::size_t>(jit_stack_curr - m_jit_stack);
+        m_error_string = sst.str();
+        return false;
+    }
+
+    if(!jit_install(code.begin(), curr))
+        return false;
+    m_jit_kernel = kernel;
+    // Kernel is shared by copies, other code is compiled anew for them, see copy_from_other()
+    m_jit_compiler = kernel ? NULL : & evaluator::compile_sse2;
+    m_jit_compiler_arg = batch;
+    m_is_compiled = true;
+    return true;
+}
+
+#endif
+
+#endif // EVALUATOR_COMPILE_SSE2_H
@@ -121,6 +121,185 @@ void fstp_ptr(char *& code_curr, const T * ptr)
 #endif
 }
 
+// eax(rax) := mem, edx(rdx) is used as temporary register
+inline void mov_eax_pptr(char *& code_curr, const void * pptr)
+{
+#if defined(EVALUATOR_JIT_X86)
+    // mov    eax, dword ptr ds:[pptr]
+    *(code_curr++) = '\xa1';
+    memcpy(code_curr, & pptr, sizeof(void*));
+    code_curr += sizeof(void*);
+#elif defined(EVALUATOR_JIT_X64)
+    // mov    rdx, 0aaaaaaaaaaaaaaah
+    *(code_curr++) = '\x48';
+    *(code_curr++) = '\xba';
+    memcpy(code_curr, & pptr, sizeof(void*));
+    code_curr += sizeof(void*);
+    // mov    rax, qword ptr [rdx]
+    *(code_curr++) = '\x48';
+    *(code_curr++) = '\x8b';
+    *(code_curr++) = '\x02';
+#elif defined(EVALUATOR_JIT_X32)
+    // mov    edx, 0xaaaaaaaa
+    *(code_curr++) = '\xba';
+    memcpy(code_curr, & pptr, sizeof(void*));
+    code_curr += sizeof(void*);
+    // mov    eax, dword ptr [rdx]
+    *(code_curr++) = '\x8b';
+    *(code_curr++) = '\x02';
+#else
+    (void)(code_curr);
+    (void)(pptr);
+#endif
+}
+
+// push, 0 := [[pptr] + offset]
+template<typename T>
+void fld_pptr(char *& code_curr, const T * const * pptr, char offset = 0)
+{
+    using namespace evaluator_internal;
+    mov_eax_pptr(code_curr, pptr);
+    // fld    [dq]word ptr [eax + offset]
+    if(is_float<T>())
+        *(code_curr++) = '\xd9';
+    else if(is_double<T>())
+        *(code_curr++) = '\xdd';
+    else
+        assert(false);
+    *(code_curr++) = '\x40';
+    *(code_curr++) = offset;
+}
+
+// [[pptr] + offset] := 0, pop
+template<typename T>
+void fstp_pptr(char *& code_curr, T * const * pptr, char offset = 0)
+{
+    using namespace evaluator_internal;
+    mov_eax_pptr(code_curr, pptr);
+    // fstp   [dq]word ptr [eax + offset]
+    if(is_float<T>())
+        *(code_curr++) = '\xd9';
+    else if(is_double<T>())
+        *(code_curr++) = '\xdd';
+    else
+        assert(false);
+    *(code_curr++) = '\x58';
+    *(code_curr++) = offset;
+}
+
+// [pptr] := [pptr] + [step]
+inline void add_pptr(char *& code_curr, const void * pptr, const std::size_t * step)
+{
+#if defined(EVALUATOR_JIT_X86)
+    // mov    edx, dword ptr ds:[step]
+    *(code_curr++) = '\x8b';
+    *(code_curr++) = '\x15';
+    memcpy(code_curr, & step, sizeof(void*));
+    code_curr += sizeof(void*);
+    // add    dword ptr ds:[pptr], edx
+    *(code_curr++) = '\x01';
+    *(code_curr++) = '\x15';
+    memcpy(code_curr, & pptr, sizeof(void*));
+    code_curr += sizeof(void*);
+#elif defined(EVALUATOR_JIT_X64)
+    // mov    rax, qword ptr [step]
+    mov_eax_pptr(code_curr, step);
+    // mov    rdx, 0aaaaaaaaaaaaaaah
+    *(code_curr++) = '\x48';
+    *(code_curr++) = '\xba';
+    memcpy(code_curr, & pptr, sizeof(void*));
+    code_curr += sizeof(void*);
+    // add    qword ptr [rdx], rax
+    *(code_curr++) = '\x48';
+    *(code_curr++) = '\x01';
+    *(code_curr++) = '\x02';
+#elif defined(EVALUATOR_JIT_X32)
+    // mov    eax, dword ptr [step]
+    mov_eax_pptr(code_curr, step);
+    // mov    edx, 0xaaaaaaaa
+    *(code_curr++) = '\xba';
+    memcpy(code_curr, & pptr, sizeof(void*));
+    code_curr += sizeof(void*);
+    // add    dword ptr [rdx], eax
+    *(code_curr++) = '\x01';
+    *(code_curr++) = '\x02';
+#else
+    (void)(code_curr);
+    (void)(pptr);
+    (void)(step);
+#endif
+}
+
+// [pptr] := [pptr] + step
+inline void add_pptr_imm(char *& code_curr, const void * pptr, char step)
+{
+#if defined(EVALUATOR_JIT_X86)
+    // add    dword ptr ds:[pptr], step
+    *(code_curr++) = '\x83';
+    *(code_curr++) = '\x05';
+    memcpy(code_curr, & pptr, sizeof(void*));
+    code_curr += sizeof(void*);
+    *(code_curr++) = step;
+#elif defined(EVALUATOR_JIT_X64)
+    // mov    rdx, 0aaaaaaaaaaaaaaah
+    *(code_curr++) = '\x48';
+    *(code_curr++) = '\xba';
+    memcpy(code_curr, & pptr, sizeof(void*));
+    code_curr += sizeof(void*);
+    // add    qword ptr [rdx], step
+    *(code_curr++) = '\x48';
+    *(code_curr++) = '\x83';
+    *(code_curr++) = '\x02';
+    *(code_curr++) = step;
+#elif defined(EVALUATOR_JIT_X32)
+    // mov    edx, 0xaaaaaaaa
+    *(code_curr++) = '\xba';
+    memcpy(code_curr, & pptr, sizeof(void*));
+    code_curr += sizeof(void*);
+    // add    dword ptr [rdx], step
+    *(code_curr++) = '\x83';
+    *(code_curr++) = '\x02';
+    *(code_curr++) = step;
+#else
+    (void)(code_curr);
+    (void)(pptr);
+    (void)(step);
+#endif
+}
+
+// [ptr] := [ptr] - 1, set ZF
+inline void dec_ptr(char *& code_curr, const std::size_t * ptr)
+{
+#if defined(EVALUATOR_JIT_X86)
+    // dec    dword ptr ds:[ptr]
+    *(code_curr++) = '\xff';
+    *(code_curr++) = '\x0d';
+    memcpy(code_curr, & ptr, sizeof(void*));
+    code_curr += sizeof(void*);
+#elif defined(EVALUATOR_JIT_X64)
+    // mov    rdx, 0aaaaaaaaaaaaaaah
+    *(code_curr++) = '\x48';
+    *(code_curr++) = '\xba';
+    memcpy(code_curr, & ptr, sizeof(void*));
+    code_curr += sizeof(void*);
+    // dec    qword ptr [rdx]
+    *(code_curr++) = '\x48';
+    *(code_curr++) = '\xff';
+    *(code_curr++) = '\x0a';
+#elif defined(EVALUATOR_JIT_X32)
+    // mov    edx, 0xaaaaaaaa
+    *(code_curr++) = '\xba';
+    memcpy(code_curr, & ptr, sizeof(void*));
+    code_curr += sizeof(void*);
+    // dec    dword ptr [rdx]
+    *(code_curr++) = '\xff';
+    *(code_curr++) = '\x0a';
+#else
+    (void)(code_curr);
+    (void)(ptr);
+#endif
+}
+
 // 1 := 1 + 0, pop
 inline void fadd(char *& code_curr)
 {
@@ -163,6 +342,85 @@ inline void fdivr(char *& code_curr)
     *(code_curr++) = '\xf1';
 }
 
+// 0 := 0 op mem, 'op' is reg field of D8 (float) or DC (double) opcode:
+// 0 = fadd, 1 = fmul, 4 = fsub, 5 = fsubr, 6 = fdiv, 7 = fdivr
+template<typename T>
+void fop_ptr(char *& code_curr, int op, const T * ptr)
+{
+    using namespace evaluator_internal;
+    const char opcode = is_float<T>() ? '\xd8' : '\xdc';
+    assert(is_float<T>() || is_double<T>());
+#if defined(EVALUATOR_JIT_X86)
+    // op     [dq]word ptr ds:[ptr]
+    *(code_curr++) = opcode;
+    *(code_curr++) = static_cast<char>(0x05 | (op << 3));
+    const char * tmp_mem = reinterpret_cast<const char *>(ptr);
+    memcpy(code_curr, & tmp_mem, sizeof(T*));
+    code_curr += sizeof(T*);
+#elif defined(EVALUATOR_JIT_X64)
+    // mov    rdx, 0aaaaaaaaaaaaaaah
+    *(code_curr++) = '\x48';
+    *(code_curr++) = '\xba';
+    const char * tmp_mem = reinterpret_cast<const char *>(ptr);
+    memcpy(code_curr, & tmp_mem, sizeof(T*));
+    code_curr += sizeof(T*);
+    // op     [dq]word ptr [rdx]
+    *(code_curr++) = opcode;
+    *(code_curr++) = static_cast<char>(0x02 | (op << 3));
+#elif defined(EVALUATOR_JIT_X32)
+    // mov    eax, 0xaaaaaaaa
+    *(code_curr++) = '\xb8';
+    const char * tmp_mem = reinterpret_cast<const char *>(ptr);
+    memcpy(code_curr, & tmp_mem, sizeof(T*));
+    code_curr += sizeof(T*);
+    // op     [dq]word ptr [eax]
+    *(code_curr++) = opcode;
+    *(code_curr++) = static_cast<char>(0x00 | (op << 3));
+#endif
+}
+
+// 0 := 0 + mem
+template<typename T>
+void fadd_ptr(char *& code_curr, const T * ptr)
+{
+    fop_ptr(code_curr, 0, ptr);
+}
+
+// 0 := 0 * mem
+template<typename T>
+void fmul_ptr(char *& code_curr, const T * ptr)
+{
+    fop_ptr(code_curr, 1, ptr);
+}
+
+// 0 := 0 - mem
+template<typename T>
+void fsub_ptr(char *& code_curr, const T * ptr)
+{
+    fop_ptr(code_curr, 4, ptr);
+}
+
+// 0 := mem - 0
+template<typename T>
+void fsubr_ptr(char *& code_curr, const T * ptr)
+{
+    fop_ptr(code_curr, 5, ptr);
+}
+
+// 0 := 0 / mem
+template<typename T>
+void fdiv_ptr(char *& code_curr, const T * ptr)
+{
+    fop_ptr(code_curr, 6, ptr);
+}
+
+// 0 := mem / 0
+template<typename T>
+void fdivr_ptr(char *& code_curr, const T * ptr)
+{
+    fop_ptr(code_curr, 7, ptr);
+}
+
 // 0 := 1 * log base 2.0 of 0, pop
 inline void fyl2x(char *& code_curr)
 {
@@ -435,6 +693,25 @@ inline void jmp(char *& code_curr, char * code_jump)
     }
 }
 
+// 4-byte jump if !=
+inline void jnz_long(char *& code_curr, char * code_jump)
+{
+    const std::size_t diff = reinterpret_cast<std::size_t>(code_jump) - reinterpret_cast<std::size_t>(code_curr) - 6;
+    *(code_curr++) = '\x0f';
+    *(code_curr++) = '\x85';
+    memcpy(code_curr, & diff, 4);
+    code_curr += 4;
+}
+
+// 4-byte jump
+inline void jmp_long(char *& code_curr, char * code_jump)
+{
+    const std::size_t diff = reinterpret_cast<std::size_t>(code_jump) - reinterpret_cast<std::size_t>(code_curr) - 5;
+    *(code_curr++) = '\xe9';
+    memcpy(code_curr, & diff, 4);
+    code_curr += 4;
+}
+
 // mov  bl,ah
 inline void mov_bl_ah(char *& code_curr)
 {
@@ -511,6 +788,34 @@ inline void fstp_ptr_imag(char *& code_curr, const std::complex<T> * ptr)
     fstp_ptr(code_curr, &(arr[1]));
 }
 
+// Load real part of '[pptr]'
+template<typename T>
+inline void fld_pptr_real(char *& code_curr, const std::complex<T> * const * pptr)
+{
+    fld_pptr(code_curr, reinterpret_cast<const T * const *>(pptr), 0);
+}
+
+// Load imag part of '[pptr]'
+template<typename T>
+inline void fld_pptr_imag(char *& code_curr, const std::complex<T> * const * pptr)
+{
+    fld_pptr(code_curr, reinterpret_cast<const T * const *>(pptr), static_cast<char>(sizeof(T)));
+}
+
+// Store to real part of '[pptr]'
+template<typename T>
+inline void fstp_pptr_real(char *& code_curr, std::complex<T> * const * pptr)
+{
+    fstp_pptr(code_curr, reinterpret_cast<T * const *>(pptr), 0);
+}
+
+// Store to imag part of '[pptr]'
+template<typename T>
+inline void fstp_pptr_imag(char *& code_curr, std::complex<T> * const * pptr)
+{
+    fstp_pptr(code_curr, reinterpret_cast<T * const *>(pptr), static_cast<char>(sizeof(T)));
+}
+
 // Fake functions
 template<typename T>
 inline void fld_ptr_real(char *& code_curr, const T * ptr)
@@ -544,6 +849,38 @@ inline void fstp_ptr_imag(char *& code_curr, const T * ptr)
     assert(false);
 }
 
+template<typename T>
+inline void fld_pptr_real(char *& code_curr, const T * const * pptr)
+{
+    (void)pptr;
+    (void)code_curr;
+    assert(false);
+}
+
+template<typename T>
+inline void fld_pptr_imag(char *& code_curr, const T * const * pptr)
+{
+    (void)pptr;
+    (void)code_curr;
+    assert(false);
+}
+
+template<typename T>
+inline void fstp_pptr_real(char *& code_curr, T * const * pptr)
+{
+    (void)pptr;
+    (void)code_curr;
+    assert(false);
+}
+
+template<typename T>
+inline void fstp_pptr_imag(char *& code_curr, T * const * pptr)
+{
+    (void)pptr;
+    (void)code_curr;
+    assert(false);
+}
+
 } // namespace evaluator_internal_jit
 
 
@@ -0,0 +1,227 @@
+#if !defined(EVALUATOR_OPCODES_AVX_H)
+#define EVALUATOR_OPCODES_AVX_H
+
+#include <cstring>
+#include <cassert>
+#include "common.h"
+#include "opcodes.h"
+#include "../type_detection.h"
+
+// Packed AVX, AVX2 and AVX-512 instructions, x64 only
+// Vector length 'l': 0 = xmm (128 bit), 1 = ymm (256 bit), 2 = zmm (512 bit)
+// VEX prefix is used for xmm and ymm, EVEX prefix is used for zmm
+
+namespace evaluator_internal_jit
+{
+
+// Prefix and opcode, 'pp': 0 = none, 1 = 66, 2 = F3, 3 = F2; 'map': 1 = 0F, 2 = 0F38, 3 = 0F3A
+inline void avx_opcode(char *& code_curr, int l, int pp, int map, int w, char opcode, int reg, int vvvv, int rm)
+{
+    if(l < 2)
+    {
+        // 3-byte VEX
+        *(code_curr++) = '\xc4';
+        *(code_curr++) = static_cast<char>((((~reg >> 3) & 1) << 7) | (1 << 6) | (((~rm >> 3) & 1) << 5) | map);
+        *(code_curr++) = static_cast<char>((w << 7) | ((~vvvv & 15) << 3) | (l << 2) | pp);
+    }
+    else
+    {
+        // EVEX, no masking, no broadcast
+        *(code_curr++) = '\x62';
+        *(code_curr++) = static_cast<char>((((~reg >> 3) & 1) << 7) | (1 << 6) | (((~rm >> 3) & 1) << 5) |
+                                           (((~reg >> 4) & 1) << 4) | map);
+        *(code_curr++) = static_cast<char>((w << 7) | ((~vvvv & 15) << 3) | (1 << 2) | pp);
+        *(code_curr++) = static_cast<char>((l << 5) | (((~vvvv >> 4) & 1) << 3));
+    }
+    *(code_curr++) = opcode;
+}
+
+// Packed float: W0, no prefix; packed double: W1 (EVEX only), prefix 66
+template<typename T>
+int avx_pp()
+{
+    return evaluator_internal::is_double<T>() ? 1 : 0;
+}
+
+template<typename T>
+int avx_w(int l)
+{
+    return (l == 2 && evaluator_internal::is_double<T>()) ? 1 : 0;
+}
+
+// reg := reg op rm
+inline void avx_rr(char *& code_curr, int l, int pp, int map, int w, char opcode, int dst, int src1, int src2)
+{
+    avx_opcode(code_curr, l, pp, map, w, opcode, dst, src1, src2);
+    *(code_curr++) = static_cast<char>(0xc0 | ((dst & 7) << 3) | (src2 & 7));
+}
+
+// reg := op [rdx], rdx := ptr
+inline void avx_rm(char *& code_curr, int l, int pp, int map, int w, char opcode, int reg, const void * ptr)
+{
+    // mov    rdx, 0aaaaaaaaaaaaaaah
+    *(code_curr++) = '\x48';
+    *(code_curr++) = '\xba';
+    memcpy(code_curr, & ptr, sizeof(void*));
+    code_curr += sizeof(void*);
+    // op     reg, [rdx]
+    avx_opcode(code_curr, l, pp, map, w, opcode, reg, 0, 2);
+    *(code_curr++) = static_cast<char>(0x02 | ((reg & 7) << 3));
+}
+
+// reg := op [rax], rax := [pptr]
+inline void avx_rm_pptr(char *& code_curr, int l, int pp, int map, int w, char opcode, int reg, const void * pptr)
+{
+    mov_eax_pptr(code_curr, pptr);
+    // op     reg, [rax]
+    avx_opcode(code_curr, l, pp, map, w, opcode, reg, 0, 0);
+    *(code_curr++) = static_cast<char>(0x00 | ((reg & 7) << 3));
+}
+
+// reg := mem
+template<typename T>
+void avx_load(char *& code_curr, int l, int reg, const T * ptr)
+{
+    // vmovup[sd]  reg, [ptr]
+    avx_rm(code_curr, l, avx_pp<T>(), 1, avx_w<T>(l), '\x10', reg, ptr);
+}
+
+// mem := reg
+template<typename T>
+void avx_store(char *& code_curr, int l, const T * ptr, int reg)
+{
+    // vmovup[sd]  [ptr], reg
+    avx_rm(code_curr, l, avx_pp<T>(), 1, avx_w<T>(l), '\x11', reg, ptr);
+}
+
+// reg := [[pptr]]
+template<typename T>
+void avx_load_pptr(char *& code_curr, int l, int reg, const T * const * pptr)
+{
+    // vmovup[sd]  reg, [[pptr]]
+    avx_rm_pptr(code_curr, l, avx_pp<T>(), 1, avx_w<T>(l), '\x10', reg, pptr);
+}
+
+// [[pptr]] := reg
+template<typename T>
+void avx_store_pptr(char *& code_curr, int l, T * const * pptr, int reg)
+{
+    // vmovup[sd]  [[pptr]], reg
+    avx_rm_pptr(code_curr, l, avx_pp<T>(), 1, avx_w<T>(l), '\x11', reg, pptr);
+}
+
+// all elements of reg := mem
+template<typename T>
+void avx_broadcast(char *& code_curr, int l, int reg, const T * ptr)
+{
+    using namespace evaluator_internal;
+    // vbroadcasts[sd]  reg, [ptr]
+    avx_rm(code_curr, l, 1, 2, avx_w<T>(l), is_double<T>() ? '\x19' : '\x18', reg, ptr);
+}
+
+// dst := src
+inline void avx_mov(char *& code_curr, int l, int dst, int src)
+{
+    // vmovaps  dst, src
+    avx_rr(code_curr, l, 0, 1, 0, '\x28', dst, 0, src);
+}
+
+// dst := src1 + src2
+template<typename T>
+void avx_add(char *& code_curr, int l, int dst, int src1, int src2)
+{
+    avx_rr(code_curr, l, avx_pp<T>(), 1, avx_w<T>(l), '\x58', dst, src1, src2);
+}
+
+// dst := src1 - src2
+template<typename T>
+void avx_sub(char *& code_curr, int l, int dst, int src1, int src2)
+{
+    avx_rr(code_curr, l, avx_pp<T>(), 1, avx_w<T>(l), '\x5c', dst, src1, src2);
+}
+
+// dst := src1 * src2
+template<typename T>
+void avx_mul(char *& code_curr, int l, int dst, int src1, int src2)
+{
+    avx_rr(code_curr, l, avx_pp<T>(), 1, avx_w<T>(l), '\x59', dst, src1, src2);
+}
+
+// dst := src1 / src2
+template<typename T>
+void avx_div(char *& code_curr, int l, int dst, int src1, int src2)
+{
+    avx_rr(code_curr, l, avx_pp<T>(), 1, avx_w<T>(l), '\x5e', dst, src1, src2);
+}
+
+// dst := square root of src
+template<typename T>
+void avx_sqrt(char *& code_curr, int l, int dst, int src)
+{
+    avx_rr(code_curr, l, avx_pp<T>(), 1, avx_w<T>(l), '\x51', dst, 0, src);
+}
+
+// dst := ~src1 & src2
+template<typename T>
+void avx_andn(char *& code_curr, int l, int dst, int src1, int src2)
+{
+    // vpandn[dq]  dst, src1, src2
+    avx_rr(code_curr, l, 1, 1, avx_w<T>(l), '\xdf', dst, src1, src2);
+}
+
+// dst := src1 ^ src2
+template<typename T>
+void avx_xor(char *& code_curr, int l, int dst, int src1, int src2)
+{
+    // vpxor[dq]  dst, src1, src2
+    avx_rr(code_curr, l, 1, 1, avx_w<T>(l), '\xef', dst, src1, src2);
+}
+
+// Zero upper bits of all ymm and zmm registers
+inline void vzeroupper(char *& code_curr)
+{
+    *(code_curr++) = '\xc5';
+    *(code_curr++) = '\xf8';
+    *(code_curr++) = '\x77';
+}
+
+// reg := value, registers: 0 = rax, 1 = rcx, 2 = rdx, 6 = rsi, 7 = rdi, 8 = r8
+inline void mov_reg_imm(char *& code_curr, int reg, const void * value)
+{
+    // mov    reg, 0aaaaaaaaaaaaaaah
+    *(code_curr++) = static_cast<char>(0x48 | (reg >> 3));
+    *(code_curr++) = static_cast<char>(0xb8 | (reg & 7));
+    memcpy(code_curr, & value, sizeof(void*));
+    code_curr += sizeof(void*);
+}
+
+// Call 'func' with 3 integer or pointer arguments,
+// all vector registers and rax, rcx, rdx, rsi, rdi, r8 - r11 are destroyed
+inline void avx_call(char *& code_curr, const void * func, const void * arg1, const void * arg2, const void * arg3)
+{
+#if defined(EVALUATOR_JIT_MSVC_ABI) || defined(EVALUATOR_JIT_MINGW_ABI)
+    const int regs[3] = { 1, 2, 8 };
+#else
+    const int regs[3] = { 7, 6, 2 };
+#endif
+    vzeroupper(code_curr);
+    mov_reg_imm(code_curr, regs[0], arg1);
+    mov_reg_imm(code_curr, regs[1], arg2);
+    mov_reg_imm(code_curr, regs[2], arg3);
+    mov_reg_imm(code_curr, 0, func);
+    // call   rax
+    *(code_curr++) = '\xff';
+    *(code_curr++) = '\xd0';
+}
+
+// -0.0, mask of sign bit
+template<typename T>
+const T * avx_sign_mask()
+{
+    static const T value = -static_cast<T>(0);
+    return & value;
+}
+
+} // namespace evaluator_internal_jit
+
+#endif // EVALUATOR_OPCODES_AVX_H
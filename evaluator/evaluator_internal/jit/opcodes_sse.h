@@ -0,0 +1,506 @@
+#if !defined(EVALUATOR_OPCODES_SSE_H)
+#define EVALUATOR_OPCODES_SSE_H
+
+#include <cstring>
+#include <vector>
+#include <utility>
+#include <cassert>
+#include "common.h"
+#include "opcodes.h"
+#include "../type_detection.h"
+
+// Scalar SSE and SSE2 instructions, xmm registers are addressed by number
+
+namespace evaluator_internal_jit
+{
+
+// Mandatory prefix of scalar instruction: F3 for float (ss), F2 for double (sd)
+template<typename T>
+char sse_prefix()
+{
+    using namespace evaluator_internal;
+    if(is_float<T>())
+        return '\xf3';
+    else if(is_double<T>())
+        return '\xf2';
+    assert(false);
+    return '\x00';
+}
+
+// Prefix (if any), REX (if needed), 0F, opcode
+inline void sse_opcode(char *& code_curr, char prefix, char opcode, int reg, int rm)
+{
+    if(prefix)
+        *(code_curr++) = prefix;
+#if defined(EVALUATOR_JIT_X64) || defined(EVALUATOR_JIT_X32)
+    if(reg >= 8 || rm >= 8)
+        *(code_curr++) = static_cast<char>(0x40 | ((reg >> 3) << 2) | (rm >> 3));
+#else
+    assert(reg < 8 && rm < 8);
+#endif
+    *(code_curr++) = '\x0f';
+    *(code_curr++) = opcode;
+}
+
+// xmm[reg] := xmm[reg] op xmm[rm]
+inline void sse_rr(char *& code_curr, char prefix, char opcode, int reg, int rm)
+{
+    sse_opcode(code_curr, prefix, opcode, reg, rm);
+    *(code_curr++) = static_cast<char>(0xc0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+// xmm[reg] := xmm[reg] op mem, edx(rdx) is used as temporary register
+inline void sse_rm(char *& code_curr, char prefix, char opcode, int reg, const void * ptr)
+{
+#if defined(EVALUATOR_JIT_X86)
+    // op     xmm, ds:[ptr]
+    sse_opcode(code_curr, prefix, opcode, reg, 0);
+    *(code_curr++) = static_cast<char>(0x05 | ((reg & 7) << 3));
+    memcpy(code_curr, & ptr, sizeof(void*));
+    code_curr += sizeof(void*);
+#elif defined(EVALUATOR_JIT_X64)
+    // mov    rdx, 0aaaaaaaaaaaaaaah
+    *(code_curr++) = '\x48';
+    *(code_curr++) = '\xba';
+    memcpy(code_curr, & ptr, sizeof(void*));
+    code_curr += sizeof(void*);
+    // op     xmm, [rdx]
+    sse_opcode(code_curr, prefix, opcode, reg, 0);
+    *(code_curr++) = static_cast<char>(0x02 | ((reg & 7) << 3));
+#elif defined(EVALUATOR_JIT_X32)
+    // mov    edx, 0xaaaaaaaa
+    *(code_curr++) = '\xba';
+    memcpy(code_curr, & ptr, sizeof(void*));
+    code_curr += sizeof(void*);
+    // op     xmm, [rdx]
+    sse_opcode(code_curr, prefix, opcode, reg, 0);
+    *(code_curr++) = static_cast<char>(0x02 | ((reg & 7) << 3));
+#else
+    (void)(code_curr);
+    (void)(prefix);
+    (void)(opcode);
+    (void)(reg);
+    (void)(ptr);
+#endif
+}
+
+// xmm[reg] := xmm[reg] op [eax(rax) + offset]
+inline void sse_rm_eax(char *& code_curr, char prefix, char opcode, int reg, char offset)
+{
+    sse_opcode(code_curr, prefix, opcode, reg, 0);
+    *(code_curr++) = static_cast<char>(0x40 | ((reg & 7) << 3));
+    *(code_curr++) = offset;
+}
+
+// xmm[reg] := xmm[reg] op [esp(rsp) + offset]
+inline void sse_rm_esp(char *& code_curr, char prefix, char opcode, int reg, char offset)
+{
+    sse_opcode(code_curr, prefix, opcode, reg, 0);
+    *(code_curr++) = static_cast<char>(0x44 | ((reg & 7) << 3));
+    *(code_curr++) = '\x24';
+    *(code_curr++) = offset;
+}
+
+// xmm[reg] := xmm[reg] op [base + disp], base: 3 = ebx(rbx), 5 = ebp(rbp)
+inline void sse_rm_base(char *& code_curr, char prefix, char opcode, int reg, int base, std::size_t disp)
+{
+    sse_opcode(code_curr, prefix, opcode, reg, base);
+    *(code_curr++) = static_cast<char>(0x80 | ((reg & 7) << 3) | base);
+    memcpy(code_curr, & disp, 4);
+    code_curr += 4;
+}
+
+// xmm[reg] := xmm[reg] op [rip + disp], 'ptr' must be in the same block of code, x64 only
+inline void sse_rm_rip(char *& code_curr, char prefix, char opcode, int reg, const void * ptr)
+{
+    sse_opcode(code_curr, prefix, opcode, reg, 0);
+    *(code_curr++) = static_cast<char>(0x05 | ((reg & 7) << 3));
+    const std::size_t diff = reinterpret_cast<std::size_t>(ptr) - reinterpret_cast<std::size_t>(code_curr) - 4;
+    memcpy(code_curr, & diff, 4);
+    code_curr += 4;
+}
+
+// Memory operands of scalar instructions: absolute addresses by default,
+// in reentrant kernels variables are addressed relative to ebx(rbx),
+// slots of evaluation stack are addressed relative to ebp(rbp),
+// constants are copied to the code and addressed relative to rip
+template<typename T>
+class sse_memory
+{
+public:
+
+    sse_memory()
+        : m_slots(0), m_slots_num(0)
+    {}
+
+    // 'consts' are pairs(address of constant, address of its copy in code)
+    sse_memory(const std::vector<const T *> & vars, const std::vector<std::pair<const T *, const T *> > & consts,
+               const T * slots, std::size_t slots_num)
+        : m_vars(vars), m_consts(consts), m_slots(reinterpret_cast<std::size_t>(slots)), m_slots_num(slots_num)
+    {}
+
+    // xmm[reg] := xmm[reg] op mem
+    void rm(char *& code_curr, char opcode, int reg, const T * ptr) const
+    {
+        const std::size_t addr = reinterpret_cast<std::size_t>(ptr);
+        if(addr >= m_slots && addr < m_slots + m_slots_num * sizeof(T))
+        {
+            sse_rm_base(code_curr, sse_prefix<T>(), opcode, reg, 5, addr - m_slots);
+            return;
+        }
+        for(std::size_t i = 0; i < m_vars.size(); i++)
+        {
+            if(m_vars[i] == ptr)
+            {
+                sse_rm_base(code_curr, sse_prefix<T>(), opcode, reg, 3, i * sizeof(T));
+                return;
+            }
+        }
+        for(std::size_t i = 0; i < m_consts.size(); i++)
+        {
+            if(m_consts[i].first == ptr)
+            {
+                sse_rm_rip(code_curr, sse_prefix<T>(), opcode, reg, m_consts[i].second);
+                return;
+            }
+        }
+        sse_rm(code_curr, sse_prefix<T>(), opcode, reg, ptr);
+    }
+
+private:
+
+    std::vector<const T *> m_vars;
+    std::vector<std::pair<const T *, const T *> > m_consts;
+    std::size_t m_slots;
+    std::size_t m_slots_num;
+};
+
+// xmm[reg] := mem
+template<typename T>
+void movs_load(char *& code_curr, int reg, const T * ptr, const sse_memory<T> & mem = sse_memory<T>())
+{
+    // movs[sd]  xmm, [ptr]
+    mem.rm(code_curr, '\x10', reg, ptr);
+}
+
+// mem := xmm[reg]
+template<typename T>
+void movs_store(char *& code_curr, const T * ptr, int reg, const sse_memory<T> & mem = sse_memory<T>())
+{
+    // movs[sd]  [ptr], xmm
+    mem.rm(code_curr, '\x11', reg, ptr);
+}
+
+// xmm[reg] := [[pptr]]
+template<typename T>
+void movs_load_pptr(char *& code_curr, int reg, const T * const * pptr)
+{
+    mov_eax_pptr(code_curr, pptr);
+    // movs[sd]  xmm, [eax]
+    sse_rm_eax(code_curr, sse_prefix<T>(), '\x10', reg, 0);
+}
+
+// [[pptr]] := xmm[reg]
+template<typename T>
+void movs_store_pptr(char *& code_curr, T * const * pptr, int reg)
+{
+    mov_eax_pptr(code_curr, pptr);
+    // movs[sd]  [eax], xmm
+    sse_rm_eax(code_curr, sse_prefix<T>(), '\x11', reg, 0);
+}
+
+// xmm[dst] := xmm[src]
+inline void movaps(char *& code_curr, int dst, int src)
+{
+    sse_rr(code_curr, 0, '\x28', dst, src);
+}
+
+// xmm[dst] := xmm[dst] + xmm[src]
+template<typename T>
+void adds(char *& code_curr, int dst, int src)
+{
+    sse_rr(code_curr, sse_prefix<T>(), '\x58', dst, src);
+}
+
+// xmm[dst] := xmm[dst] - xmm[src]
+template<typename T>
+void subs(char *& code_curr, int dst, int src)
+{
+    sse_rr(code_curr, sse_prefix<T>(), '\x5c', dst, src);
+}
+
+// xmm[dst] := xmm[dst] * xmm[src]
+template<typename T>
+void muls(char *& code_curr, int dst, int src)
+{
+    sse_rr(code_curr, sse_prefix<T>(), '\x59', dst, src);
+}
+
+// xmm[dst] := xmm[dst] / xmm[src]
+template<typename T>
+void divs(char *& code_curr, int dst, int src)
+{
+    sse_rr(code_curr, sse_prefix<T>(), '\x5e', dst, src);
+}
+
+// xmm[dst] := xmm[dst] + mem
+template<typename T>
+void adds_ptr(char *& code_curr, int dst, const T * ptr, const sse_memory<T> & mem = sse_memory<T>())
+{
+    mem.rm(code_curr, '\x58', dst, ptr);
+}
+
+// xmm[dst] := xmm[dst] - mem
+template<typename T>
+void subs_ptr(char *& code_curr, int dst, const T * ptr, const sse_memory<T> & mem = sse_memory<T>())
+{
+    mem.rm(code_curr, '\x5c', dst, ptr);
+}
+
+// xmm[dst] := xmm[dst] * mem
+template<typename T>
+void muls_ptr(char *& code_curr, int dst, const T * ptr, const sse_memory<T> & mem = sse_memory<T>())
+{
+    mem.rm(code_curr, '\x59', dst, ptr);
+}
+
+// xmm[dst] := xmm[dst] / mem
+template<typename T>
+void divs_ptr(char *& code_curr, int dst, const T * ptr, const sse_memory<T> & mem = sse_memory<T>())
+{
+    mem.rm(code_curr, '\x5e', dst, ptr);
+}
+
+// xmm[dst] := square root of xmm[src]
+template<typename T>
+void sqrts(char *& code_curr, int dst, int src)
+{
+    sse_rr(code_curr, sse_prefix<T>(), '\x51', dst, src);
+}
+
+// xmm[dst] := xmm[dst] & xmm[src]
+inline void andps(char *& code_curr, int dst, int src)
+{
+    sse_rr(code_curr, 0, '\x54', dst, src);
+}
+
+// xmm[dst] := xmm[dst] ^ xmm[src]
+inline void xorps(char *& code_curr, int dst, int src)
+{
+    sse_rr(code_curr, 0, '\x57', dst, src);
+}
+
+// xmm[dst] := all bits set
+inline void pcmpeqd(char *& code_curr, int dst)
+{
+    sse_rr(code_curr, '\x66', '\x76', dst, dst);
+}
+
+// xmm[dst] := xmm[dst] >> shift for each dword (float) or qword (double)
+template<typename T>
+void psrl(char *& code_curr, int dst, char shift)
+{
+    using namespace evaluator_internal;
+    // psrl[dq]  xmm, shift
+    sse_rr(code_curr, '\x66', is_float<T>() ? '\x72' : '\x73', 2, dst);
+    *(code_curr++) = shift;
+}
+
+// xmm[dst] := |xmm[dst]|, xmm[tmp] is used as temporary register
+template<typename T>
+void abss(char *& code_curr, int dst, int tmp)
+{
+    pcmpeqd(code_curr, tmp);
+    psrl<T>(code_curr, tmp, 1);
+    andps(code_curr, dst, tmp);
+}
+
+// Size of local stack frame: keep stack aligned by 16 bytes for calls
+// x86: 12 + 16, return address + 8 bytes for arguments
+// SysV x64 and x32: 8, return address only
+// MS x64: 8 + 32, return address + shadow space
+inline char sse_frame_size()
+{
+#if defined(EVALUATOR_JIT_X86)
+    return '\x1c';
+#elif defined(EVALUATOR_JIT_X64) && (defined(EVALUATOR_JIT_MSVC_ABI) || defined(EVALUATOR_JIT_MINGW_ABI))
+    return '\x28';
+#else
+    return '\x08';
+#endif
+}
+
+// Number of xmm registers which may be used without saving,
+// MS x64 preserves xmm6 - xmm15 across calls
+inline int sse_regs_num()
+{
+#if defined(EVALUATOR_JIT_X64) && (defined(EVALUATOR_JIT_MSVC_ABI) || defined(EVALUATOR_JIT_MINGW_ABI))
+    return 6;
+#elif defined(EVALUATOR_JIT_X64) || defined(EVALUATOR_JIT_X32)
+    return 16;
+#else
+    return 8;
+#endif
+}
+
+// Allocate local stack frame
+inline void sse_enter(char *& code_curr)
+{
+#if defined(EVALUATOR_JIT_X64)
+    // sub    rsp, size
+    *(code_curr++) = '\x48';
+#endif
+    // sub    esp, size
+    *(code_curr++) = '\x83';
+    *(code_curr++) = '\xec';
+    *(code_curr++) = sse_frame_size();
+}
+
+// Free local stack frame
+inline void sse_leave(char *& code_curr)
+{
+#if defined(EVALUATOR_JIT_X64)
+    // add    rsp, size
+    *(code_curr++) = '\x48';
+#endif
+    // add    esp, size
+    *(code_curr++) = '\x83';
+    *(code_curr++) = '\xc4';
+    *(code_curr++) = sse_frame_size();
+}
+
+// Reentrant kernel void kernel(const T * vars, T * scratch, T * out), x64 only:
+// rbx := vars, rbp := scratch, out is kept in local stack frame,
+// stack is aligned by 16 bytes after 3 pushes, MS x64 needs shadow space for calls
+inline char sse_kernel_frame_size()
+{
+#if defined(EVALUATOR_JIT_MSVC_ABI) || defined(EVALUATOR_JIT_MINGW_ABI)
+    return '\x20';
+#else
+    return '\x00';
+#endif
+}
+
+// Save registers, load base registers from arguments
+inline void sse_kernel_enter(char *& code_curr)
+{
+    // push   rbx
+    *(code_curr++) = '\x53';
+    // push   rbp
+    *(code_curr++) = '\x55';
+#if defined(EVALUATOR_JIT_MSVC_ABI) || defined(EVALUATOR_JIT_MINGW_ABI)
+    // push   r8
+    *(code_curr++) = '\x41';
+    *(code_curr++) = '\x50';
+    // mov    rbx, rcx
+    *(code_curr++) = '\x48';
+    *(code_curr++) = '\x89';
+    *(code_curr++) = '\xcb';
+    // mov    rbp, rdx
+    *(code_curr++) = '\x48';
+    *(code_curr++) = '\x89';
+    *(code_curr++) = '\xd5';
+#else
+    // push   rdx
+    *(code_curr++) = '\x52';
+    // mov    rbx, rdi
+    *(code_curr++) = '\x48';
+    *(code_curr++) = '\x89';
+    *(code_curr++) = '\xfb';
+    // mov    rbp, rsi
+    *(code_curr++) = '\x48';
+    *(code_curr++) = '\x89';
+    *(code_curr++) = '\xf5';
+#endif
+    if(sse_kernel_frame_size())
+    {
+        // sub    rsp, size
+        *(code_curr++) = '\x48';
+        *(code_curr++) = '\x83';
+        *(code_curr++) = '\xec';
+        *(code_curr++) = sse_kernel_frame_size();
+    }
+}
+
+// [out] := xmm[reg]
+template<typename T>
+void sse_kernel_store(char *& code_curr, int reg)
+{
+    // mov    rax, [rsp + size]
+    *(code_curr++) = '\x48';
+    *(code_curr++) = '\x8b';
+    *(code_curr++) = '\x44';
+    *(code_curr++) = '\x24';
+    *(code_curr++) = sse_kernel_frame_size();
+    // movs[sd]  [rax], xmm
+    sse_rm_eax(code_curr, sse_prefix<T>(), '\x11', reg, 0);
+}
+
+// Free local stack frame, restore registers
+inline void sse_kernel_leave(char *& code_curr)
+{
+    // add    rsp, size + 8
+    *(code_curr++) = '\x48';
+    *(code_curr++) = '\x83';
+    *(code_curr++) = '\xc4';
+    *(code_curr++) = static_cast<char>(sse_kernel_frame_size() + 8);
+    // pop    rbp
+    *(code_curr++) = '\x5d';
+    // pop    rbx
+    *(code_curr++) = '\x5b';
+}
+
+// xmm0 := func(xmm0) or xmm0 := func(xmm0, xmm1), 'func' takes and returns T by value
+// All xmm registers and eax(rax), ecx(rcx), edx(rdx) are destroyed
+template<typename T>
+void sse_call(char *& code_curr, const void * func, int args_num)
+{
+#if defined(EVALUATOR_JIT_X86)
+    // cdecl: arguments in stack, return value in st(0)
+    // movs[sd]  [esp], xmm0
+    sse_rm_esp(code_curr, sse_prefix<T>(), '\x11', 0, 0);
+    if(args_num > 1)
+    {
+        // movs[sd]  [esp + size], xmm1
+        sse_rm_esp(code_curr, sse_prefix<T>(), '\x11', 1, static_cast<char>(sizeof(T)));
+    }
+    // mov    eax, func
+    *(code_curr++) = '\xb8';
+    memcpy(code_curr, & func, sizeof(void*));
+    code_curr += sizeof(void*);
+    // call   eax
+    *(code_curr++) = '\xff';
+    *(code_curr++) = '\xd0';
+    // fstp   [dq]word ptr [esp]
+    *(code_curr++) = (sizeof(T) == 4) ? '\xd9' : '\xdd';
+    *(code_curr++) = '\x1c';
+    *(code_curr++) = '\x24';
+    // movs[sd]  xmm0, [esp]
+    sse_rm_esp(code_curr, sse_prefix<T>(), '\x10', 0, 0);
+#elif defined(EVALUATOR_JIT_X64)
+    // SysV and MS: arguments in xmm0 and xmm1, return value in xmm0
+    (void)(args_num);
+    // mov    rax, 0aaaaaaaaaaaaaaah
+    *(code_curr++) = '\x48';
+    *(code_curr++) = '\xb8';
+    memcpy(code_curr, & func, sizeof(void*));
+    code_curr += sizeof(void*);
+    // call   rax
+    *(code_curr++) = '\xff';
+    *(code_curr++) = '\xd0';
+#elif defined(EVALUATOR_JIT_X32)
+    // SysV: arguments in xmm0 and xmm1, return value in xmm0
+    (void)(args_num);
+    // mov    eax, 0xaaaaaaaa
+    *(code_curr++) = '\xb8';
+    memcpy(code_curr, & func, sizeof(void*));
+    code_curr += sizeof(void*);
+    // call   rax
+    *(code_curr++) = '\xff';
+    *(code_curr++) = '\xd0';
+#endif
+}
+
+} // namespace evaluator_internal_jit
+
+#endif // EVALUATOR_OPCODES_SSE_H
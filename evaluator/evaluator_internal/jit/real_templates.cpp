@@ -3,6 +3,21 @@
 namespace evaluator_internal_jit
 {
 
+// Number of x87 registers which are used by inlined code of function or operator 'name'
+// in addition to registers of arguments
+int real_temp_regs(const std::string & name)
+{
+    if(name == "sinh" || name == "cosh")
+        return 3;
+    if(name == "^" || name == "asin" || name == "acos" || name == "exp" || name == "tanh" ||
+       name == "asinh" || name == "acosh" || name == "atanh")
+        return 2;
+    if(name == "tan" || name == "atan" || name == "log" || name == "log2" || name == "log10" ||
+       name == "arg" || name == "imag")
+        return 1;
+    return 0;
+}
+
 // Input:  st(0) = X , st(1) = Y
 // Output: st(0) = X ^ Y
 void real_pow(char *& code_curr)
@@ -1,11 +1,16 @@
 #if !defined(EVALUATOR_REAL_TEMPLATES_H)
 #define EVALUATOR_REAL_TEMPLATES_H
 
+#include <string>
 #include "opcodes.h"
 
 namespace evaluator_internal_jit
 {
 
+// Number of x87 registers which are used by inlined code of function or operator 'name'
+// in addition to registers of arguments
+int real_temp_regs(const std::string & name);
+
 // Input:  st(0) = X , st(1) = Y
 // Output: st(0) = X ^ Y
 void real_pow(char *& code_curr);
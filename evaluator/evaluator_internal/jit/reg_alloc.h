@@ -0,0 +1,277 @@
+#if !defined(EVALUATOR_REG_ALLOC_H)
+#define EVALUATOR_REG_ALLOC_H
+
+#include <vector>
+#include <cstddef>
+#include <cassert>
+#include "common.h"
+#include "opcodes.h"
+#include "opcodes_sse.h"
+#include "opcodes_avx.h"
+
+// Register allocation for evaluation stack of compiled code.
+// Each value of evaluation stack is kept in register or in memory: constants and variables
+// may be used from their own memory, intermediate values are stored to their slots
+// (slot i of m_jit_stack for i-th value of evaluation stack) only if registers are exhausted.
+
+namespace evaluator_internal_jit
+{
+
+// Values on x87 register stack, at most 'limit' values are kept in registers,
+// the rest of st(0) - st(7) is reserved for temporary values of inlined functions
+template<typename T>
+class jit_x87_stack
+{
+public:
+
+    jit_x87_stack(T * slots, int limit)
+        : m_slots(slots), m_limit(limit), m_regs(0)
+    {}
+
+    std::size_t size() const
+    {
+        return m_values.size();
+    }
+
+    // Memory of i-th value from top, NULL if value is in register
+    const T * ptr(std::size_t i = 0) const
+    {
+        return m_values[m_values.size() - 1 - i];
+    }
+
+    // Make free register for new value, topmost value in register is stored if all are used
+    void reserve(char *& code_curr)
+    {
+        if(m_regs < m_limit)
+            return;
+        std::size_t i = m_values.size() - 1;
+        while(m_values[i])
+            i--;
+        fstp_ptr(code_curr, m_slots + i);
+        m_values[i] = m_slots + i;
+        m_regs--;
+    }
+
+    // New value in st(0)
+    void push_reg()
+    {
+        assert(m_regs < m_limit);
+        m_values.push_back(NULL);
+        m_regs++;
+    }
+
+    // New value in memory
+    void push_mem(const T * ptr)
+    {
+        m_values.push_back(ptr);
+    }
+
+    void pop()
+    {
+        if(!m_values.back())
+            m_regs--;
+        m_values.pop_back();
+    }
+
+    // Copy top value to 'dst', it stays on stack
+    void copy_top(char *& code_curr, const T * dst)
+    {
+        reserve(code_curr);
+        if(m_values.back())
+            fld_ptr(code_curr, m_values.back());
+        else
+            fldi(code_curr, 0);
+        fstp_ptr(code_curr, dst);
+    }
+
+private:
+
+    std::vector<const T *> m_values;
+    T * m_slots;
+    int m_limit;
+    int m_regs;
+};
+
+// Scalar values in xmm registers, memory is addressed by 'mem'
+template<typename T>
+struct jit_sse_emitter
+{
+    jit_sse_emitter(const sse_memory<T> & mem)
+        : m_mem(mem)
+    {}
+
+    std::size_t stride() const
+    {
+        return 1;
+    }
+
+    void load(char *& code_curr, int reg, const T * ptr) const
+    {
+        movs_load(code_curr, reg, ptr, m_mem);
+    }
+
+    void store(char *& code_curr, const T * ptr, int reg) const
+    {
+        movs_store(code_curr, ptr, reg, m_mem);
+    }
+
+    sse_memory<T> m_mem;
+};
+
+// Vectors in ymm or zmm registers, 'l' is vector length of opcodes_avx.h
+template<typename T>
+struct jit_avx_emitter
+{
+    jit_avx_emitter(int l, std::size_t lanes)
+        : m_l(l), m_lanes(lanes)
+    {}
+
+    std::size_t stride() const
+    {
+        return m_lanes;
+    }
+
+    void load(char *& code_curr, int reg, const T * ptr) const
+    {
+        avx_load(code_curr, m_l, reg, ptr);
+    }
+
+    void store(char *& code_curr, const T * ptr, int reg) const
+    {
+        avx_store(code_curr, m_l, ptr, reg);
+    }
+
+    int m_l;
+    std::size_t m_lanes;
+};
+
+// Values in 'regs_num' vector registers, 'E' emits loads and stores,
+// deepest value in register is stored if all registers are used,
+// so two values on top of stack are never stored by alloc() or load()
+template<typename T, typename E>
+class jit_reg_stack
+{
+public:
+
+    jit_reg_stack(const E & emitter, T * slots, int regs_num)
+        : m_emitter(emitter), m_slots(slots), m_busy(regs_num, false)
+    {
+        assert(regs_num >= 3);
+    }
+
+    std::size_t size() const
+    {
+        return m_values.size();
+    }
+
+    // Register of i-th value from top, -1 if value is in memory
+    int reg(std::size_t i = 0) const
+    {
+        return m_values[m_values.size() - 1 - i].reg;
+    }
+
+    // Memory of i-th value from top, if value is in memory
+    const T * ptr(std::size_t i = 0) const
+    {
+        return m_values[m_values.size() - 1 - i].ptr;
+    }
+
+    // Own slot of i-th value from top
+    T * slot(std::size_t i = 0) const
+    {
+        return m_slots + (m_values.size() - 1 - i) * m_emitter.stride();
+    }
+
+    // Free register, it is not marked as used until push_reg()
+    int alloc(char *& code_curr)
+    {
+        for(std::size_t r = 0; r < m_busy.size(); r++)
+            if(!m_busy[r])
+                return static_cast<int>(r);
+        std::size_t i = 0;
+        while(m_values[i].reg < 0)
+            i++;
+        const int r = m_values[i].reg;
+        store(code_curr, i);
+        return r;
+    }
+
+    // Move i-th value from top to register
+    int load(char *& code_curr, std::size_t i)
+    {
+        value & v = m_values[m_values.size() - 1 - i];
+        if(v.reg >= 0)
+            return v.reg;
+        const int r = alloc(code_curr);
+        m_emitter.load(code_curr, r, v.ptr);
+        v.reg = r;
+        v.ptr = NULL;
+        m_busy[r] = true;
+        return r;
+    }
+
+    // Move i-th value from top to its slot
+    void spill(char *& code_curr, std::size_t i)
+    {
+        const std::size_t j = m_values.size() - 1 - i;
+        if(m_values[j].reg >= 0)
+            store(code_curr, j);
+    }
+
+    // Move all values except 'keep' values on top to memory, registers are destroyed by calls
+    void spill_all(char *& code_curr, std::size_t keep = 0)
+    {
+        for(std::size_t j = 0; j + keep < m_values.size(); j++)
+            if(m_values[j].reg >= 0)
+                store(code_curr, j);
+    }
+
+    void push_reg(int reg)
+    {
+        assert(!m_busy[reg]);
+        value v = { reg, NULL };
+        m_values.push_back(v);
+        m_busy[reg] = true;
+    }
+
+    void push_mem(const T * ptr)
+    {
+        value v = { -1, ptr };
+        m_values.push_back(v);
+    }
+
+    void pop()
+    {
+        if(m_values.back().reg >= 0)
+            m_busy[m_values.back().reg] = false;
+        m_values.pop_back();
+    }
+
+private:
+
+    struct value
+    {
+        int reg;
+        const T * ptr;
+    };
+
+    // Store j-th value from bottom to its slot
+    void store(char *& code_curr, std::size_t j)
+    {
+        value & v = m_values[j];
+        T * slot = m_slots + j * m_emitter.stride();
+        m_emitter.store(code_curr, slot, v.reg);
+        m_busy[v.reg] = false;
+        v.reg = -1;
+        v.ptr = slot;
+    }
+
+    E m_emitter;
+    T * m_slots;
+    std::vector<value> m_values;
+    std::vector<bool> m_busy;
+};
+
+} // namespace evaluator_internal_jit
+
+#endif // EVALUATOR_REG_ALLOC_H
@@ -0,0 +1,122 @@
+#include "sse_kernels.h"
+#include "approx_math.h"
+#include "../../evaluator_operations.h"
+
+namespace evaluator_internal_jit
+{
+
+namespace
+{
+
+// Function kernels, float kernels evaluate the function in double precision
+template<double(* F)(double)>
+double EVALUATOR_JIT_CALL kernel_func(double x)
+{
+    return F(x);
+}
+
+template<double(* F)(double)>
+float EVALUATOR_JIT_CALL kernel_func(float x)
+{
+    return static_cast<float>(F(static_cast<double>(x)));
+}
+
+// Trigonometric kernels, values with |x| >= trig_limit are calculated by 'G'
+template<typename T, double(* F)(double), T(* G)(const T &)>
+T EVALUATOR_JIT_CALL kernel_trig(T x)
+{
+    if(static_cast<double>(x) < trig_limit && static_cast<double>(x) > -trig_limit)
+        return static_cast<T>(F(static_cast<double>(x)));
+    return G(x);
+}
+
+template<typename T, T(* F)(const T &, const T &)>
+T EVALUATOR_JIT_CALL kernel_oper(T x, T y)
+{
+    return F(x, y);
+}
+
+// Function pointer to data pointer
+template<typename F>
+const void * kernel_address(F func)
+{
+    const void * result = NULL;
+    memcpy(& result, & func, sizeof(void *));
+    return result;
+}
+
+template<typename T>
+const void * func_kernel(const std::string & name)
+{
+    using namespace evaluator_internal;
+    typedef T(EVALUATOR_JIT_CALL * kernel_type)(T);
+    kernel_type kernel = NULL;
+    if     (name == "sin")
+        kernel = & kernel_trig<T, approx_sin, eval_sin<T> >;
+    else if(name == "cos")
+        kernel = & kernel_trig<T, approx_cos, eval_cos<T> >;
+    else if(name == "tan")
+        kernel = & kernel_trig<T, approx_tan, eval_tan<T> >;
+    else if(name == "asin")
+        kernel = & kernel_func<approx_asin>;
+    else if(name == "acos")
+        kernel = & kernel_func<approx_acos>;
+    else if(name == "atan")
+        kernel = & kernel_func<approx_atan>;
+    else if(name == "sinh")
+        kernel = & kernel_func<approx_sinh>;
+    else if(name == "cosh")
+        kernel = & kernel_func<approx_cosh>;
+    else if(name == "tanh")
+        kernel = & kernel_func<approx_tanh>;
+    else if(name == "asinh")
+        kernel = & kernel_func<approx_asinh>;
+    else if(name == "acosh")
+        kernel = & kernel_func<approx_acosh>;
+    else if(name == "atanh")
+        kernel = & kernel_func<approx_atanh>;
+    else if(name == "log")
+        kernel = & kernel_func<approx_log>;
+    else if(name == "log2")
+        kernel = & kernel_func<approx_log2>;
+    else if(name == "log10")
+        kernel = & kernel_func<approx_log10>;
+    else if(name == "exp")
+        kernel = & kernel_func<approx_exp>;
+    else if(name == "arg")
+        kernel = & kernel_func<approx_arg>;
+    return kernel ? kernel_address(kernel) : NULL;
+}
+
+template<typename T>
+const void * oper_kernel(char name)
+{
+    using namespace evaluator_internal;
+    if(name == '^')
+        return kernel_address(& kernel_oper<T, eval_pow<T> >);
+    return NULL;
+}
+
+} // namespace
+
+const void * sse_func_kernel(const std::string & name, float)
+{
+    return func_kernel<float>(name);
+}
+
+const void * sse_func_kernel(const std::string & name, double)
+{
+    return func_kernel<double>(name);
+}
+
+const void * sse_oper_kernel(char name, float)
+{
+    return oper_kernel<float>(name);
+}
+
+const void * sse_oper_kernel(char name, double)
+{
+    return oper_kernel<double>(name);
+}
+
+} // namespace evaluator_internal_jit
@@ -0,0 +1,36 @@
+#if !defined(EVALUATOR_SSE_KERNELS_H)
+#define EVALUATOR_SSE_KERNELS_H
+
+#include <string>
+#include "common.h"
+
+namespace evaluator_internal_jit
+{
+
+// Software kernels which are called from SSE2 code, they use the same approximations as
+// vector kernels (see approx_math.h and vector_kernels.h for accuracy),
+// kernels take arguments and return value by value: T kernel(T) and T kernel(T, T)
+
+// Address of kernel for function 'name', NULL if function is not supported
+const void * sse_func_kernel(const std::string & name, float);
+const void * sse_func_kernel(const std::string & name, double);
+
+template<typename T>
+const void * sse_func_kernel(const std::string &, const T &)
+{
+    return NULL;
+}
+
+// Address of kernel for operator 'name', NULL if operator is not supported
+const void * sse_oper_kernel(char name, float);
+const void * sse_oper_kernel(char name, double);
+
+template<typename T>
+const void * sse_oper_kernel(char, const T &)
+{
+    return NULL;
+}
+
+} // namespace evaluator_internal_jit
+
+#endif // EVALUATOR_SSE_KERNELS_H
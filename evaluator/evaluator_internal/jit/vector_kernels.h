@@ -0,0 +1,56 @@
+#if !defined(EVALUATOR_VECTOR_KERNELS_H)
+#define EVALUATOR_VECTOR_KERNELS_H
+
+#include <string>
+#include "common.h"
+
+namespace evaluator_internal_jit
+{
+
+// Software kernels which are called from vector code, kernels work in place over 'n' values:
+// void kernel(T * x, std::size_t n) for functions, x := func(x)
+// void kernel(T * x, const T * y, std::size_t n) for operators, x := oper(x, y)
+//
+// Functions are polynomial approximations evaluated in double precision, loops are vectorized
+// by compiler. Max error in ULP (see kernels_test() in benchmark.cpp):
+//   function   domain              float   double
+//   sin, cos   |x| <= 100          0.5     1.5
+//   tan        |x| <= 100          0.5     2.6
+//   asin, acos |x| <= 1            0.5     3.7
+//   atan       |x| <= 100          0.5     2.7
+//   sinh, cosh |x| <= 20           0.5     3.4
+//   tanh       |x| <= 5            0.5     2.6
+//   asinh      |x| <= 100          0.5     1.8
+//   acosh      1 < x <= 100        0.5     1.6
+//   atanh      |x| <= 0.99         0.5     2.2
+//   log        x > 0               0.5     0.8
+//   log2       x > 0               0.5     1.4
+//   log10      x > 0               0.5     1.8
+//   exp        |x| <= 50           0.5     1.0
+//   arg        any x               0.5     0.5
+// sin, cos and tan fall back to libm for |x| >= 2^20, pow always uses libm,
+// sqrt, abs, real, imag and conj are single instructions in generated code.
+
+// Address of kernel for function 'name', NULL if function is not supported
+const void * vector_func_kernel(const std::string & name, float);
+const void * vector_func_kernel(const std::string & name, double);
+
+template<typename T>
+const void * vector_func_kernel(const std::string &, const T &)
+{
+    return NULL;
+}
+
+// Address of kernel for operator 'name', NULL if operator is not supported
+const void * vector_oper_kernel(char name, float);
+const void * vector_oper_kernel(char name, double);
+
+template<typename T>
+const void * vector_oper_kernel(char, const T &)
+{
+    return NULL;
+}
+
+} // namespace evaluator_internal_jit
+
+#endif // EVALUATOR_VECTOR_KERNELS_H
@@ -0,0 +1,71 @@
+#include "lock.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+    #if !defined(NOMINMAX)
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <pthread.h>
+#endif
+
+namespace evaluator_internal
+{
+
+namespace
+{
+
+// One mutex per lock_id
+#if defined(_WIN32) || defined(_WIN64)
+volatile LONG mutexes[LOCK_NUM] = { 0 };
+#else
+pthread_mutex_t mutexes[LOCK_NUM] =
+{
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER
+};
+#endif
+
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+scoped_lock::scoped_lock(lock_id id)
+    : m_id(id)
+{
+    while(InterlockedExchange(& mutexes[m_id], 1))
+        Sleep(0);
+}
+
+scoped_lock::~scoped_lock()
+{
+    InterlockedExchange(& mutexes[m_id], 0);
+}
+#else
+scoped_lock::scoped_lock(lock_id id)
+    : m_id(id)
+{
+    pthread_mutex_lock(& mutexes[m_id]);
+}
+
+scoped_lock::~scoped_lock()
+{
+    pthread_mutex_unlock(& mutexes[m_id]);
+}
+#endif
+
+void memory_barrier()
+{
+#if defined(_WIN32) || defined(_WIN64)
+    MemoryBarrier();
+#elif defined(__GNUC__)
+    __sync_synchronize();
+#else
+    // Lock and unlock are full barriers
+    scoped_lock lock(LOCK_BARRIER);
+#endif
+}
+
+} // namespace evaluator_internal
@@ -0,0 +1,37 @@
+#if !defined(EVALUATOR_LOCK_H)
+#define EVALUATOR_LOCK_H
+
+namespace evaluator_internal
+{
+
+// Process-wide locks of shared state, each one guards its own data
+enum lock_id
+{
+    LOCK_REGISTRY,  // creation of registries, see registry
+    LOCK_REFS,      // reference counters of shared objects, see cow_ref
+    LOCK_CACHE,     // caches of parsed expressions, see lru_cache
+    LOCK_ARENA,     // code arena of compiled code
+    LOCK_BARRIER,   // memory_barrier() of compilers without builtin barrier
+    LOCK_NUM
+};
+
+// Scoped lock, mutexes are initialized statically, so it may be used before main()
+class scoped_lock
+{
+public:
+    explicit scoped_lock(lock_id id);
+    ~scoped_lock();
+
+private:
+    scoped_lock(const scoped_lock &);
+    scoped_lock & operator = (const scoped_lock &);
+
+    lock_id m_id;
+};
+
+// Full memory barrier: writes before it are visible to other threads before writes after it
+void memory_barrier();
+
+} // namespace evaluator_internal
+
+#endif // EVALUATOR_LOCK_H
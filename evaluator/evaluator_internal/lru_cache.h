@@ -0,0 +1,140 @@
+#if !defined(EVALUATOR_LRU_CACHE_H)
+#define EVALUATOR_LRU_CACHE_H
+
+#include <list>
+#include <map>
+#include <string>
+#include <cstddef>
+#include "lock.h"
+
+namespace evaluator_internal
+{
+
+// Statistics of cache
+struct cache_stats
+{
+    // Number of lookups which found a value
+    std::size_t hits;
+    // Number of lookups which found nothing
+    std::size_t misses;
+    // Number of values removed to free memory
+    std::size_t evictions;
+    // Number of values in cache
+    std::size_t entries;
+    // Memory of values in bytes, estimated
+    std::size_t bytes;
+    // Limit of memory in bytes
+    std::size_t max_bytes;
+};
+
+// Cache: [key]->value with bounded memory, least recently used values are removed first,
+// caller estimates memory of each value, caller locks cache by LOCK_CACHE
+template<typename V> class lru_cache
+{
+public:
+
+    lru_cache(std::size_t max_bytes)
+        : m_bytes(0), m_max_bytes(max_bytes), m_hits(0), m_misses(0), m_evictions(0)
+    {}
+
+    // Value with key 'key', NULL if there is no such value, the value becomes most recently used
+    const V * find(const std::string & key)
+    {
+        typename std::map<std::string, iterator>::const_iterator it = m_index.find(key);
+        if(it == m_index.end())
+        {
+            m_misses++;
+            return NULL;
+        }
+        m_hits++;
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return & it->second->value;
+    }
+
+    // Add value 'value' of 'bytes' bytes with key 'key', value larger than limit is not added
+    void insert(const std::string & key, const V & value, std::size_t bytes)
+    {
+        typename std::map<std::string, iterator>::iterator it = m_index.find(key);
+        if(it != m_index.end())
+            erase(it);
+        if(bytes > m_max_bytes)
+            return;
+        m_entries.push_front(entry(key, value, bytes));
+        m_index[key] = m_entries.begin();
+        m_bytes += bytes;
+        shrink();
+    }
+
+    // Set limit of memory, values are removed if it is exceeded
+    void set_max_bytes(std::size_t max_bytes)
+    {
+        m_max_bytes = max_bytes;
+        shrink();
+    }
+
+    // Remove all values, counters are reset
+    void clear()
+    {
+        m_entries.clear();
+        m_index.clear();
+        m_bytes = 0;
+        m_hits = m_misses = m_evictions = 0;
+    }
+
+    cache_stats stats() const
+    {
+        cache_stats st;
+        st.hits = m_hits;
+        st.misses = m_misses;
+        st.evictions = m_evictions;
+        st.entries = m_index.size();
+        st.bytes = m_bytes;
+        st.max_bytes = m_max_bytes;
+        return st;
+    }
+
+private:
+
+    struct entry
+    {
+        entry(const std::string & k, const V & v, std::size_t b)
+            : key(k), value(v), bytes(b)
+        {}
+
+        std::string key;
+        V value;
+        std::size_t bytes;
+    };
+    typedef typename std::list<entry>::iterator iterator;
+
+    void erase(typename std::map<std::string, iterator>::iterator it)
+    {
+        m_bytes -= it->second->bytes;
+        m_entries.erase(it->second);
+        m_index.erase(it);
+    }
+
+    // Remove least recently used values until memory is in limit
+    void shrink()
+    {
+        while(m_bytes > m_max_bytes && !m_entries.empty())
+        {
+            erase(m_index.find(m_entries.back().key));
+            m_evictions++;
+        }
+    }
+
+    // Values, most recently used first
+    std::list<entry> m_entries;
+    // Container: [key]->value in list
+    std::map<std::string, iterator> m_index;
+    std::size_t m_bytes;
+    std::size_t m_max_bytes;
+    std::size_t m_hits;
+    std::size_t m_misses;
+    std::size_t m_evictions;
+};
+
+} // namespace evaluator_internal
+
+#endif // EVALUATOR_LRU_CACHE_H
@@ -3,49 +3,13 @@
 
 #include <vector>
 #include <complex>
-#include <limits>
 #include <cstring>
+#include <algorithm>
 #include <iostream>
 #include "../evaluator.h"
 #include "../evaluator_operations.h"
 #include "type_detection.h"
-
-// Return incorrect big number (uninitialized variable)
-template<typename T>
-template<typename U>
-T evaluator<T>::incorrect_number(const std::complex<U> &) const
-{
-    static const U max_num = std::numeric_limits<U>::max();
-    return static_cast<T>(std::complex<U>(max_num, max_num));
-}
-
-template<typename T>
-template<typename U>
-T evaluator<T>::incorrect_number(const U &) const
-{
-    static const U max_num = std::numeric_limits<U>::max();
-    return static_cast<T>(max_num);
-}
-
-// Check whether a number is incorrect (uninitialized variable)
-template<typename T>
-template<typename U>
-bool evaluator<T>::is_incorrect(const std::complex<U> & val) const
-{
-    static const U max_num = std::numeric_limits<U>::max();
-    static const U lim_num = max_num * (static_cast<U>(1) - static_cast<U>(1e-3));
-    return val.real() >= lim_num && val.imag() >= lim_num;
-}
-
-template<typename T>
-template<typename U>
-bool evaluator<T>::is_incorrect(const U & val) const
-{
-    using namespace evaluator_internal;
-    static const U max_num = std::numeric_limits<U>::max();
-    static const U lim_num = is_floating<U>() ? max_num * (static_cast<U>(1) - static_cast<U>(1e-3)) : max_num;
-    return val >= lim_num;
-}
+#include "jit/code_arena.h"
 
 // Primary initialization
 template<typename T>
@@ -60,55 +24,29 @@ void evaluator<T>::init()
     m_jit_stack = NULL;
     m_jit_stack_size = 0;
     m_jit_func = NULL;
+    m_jit_batch = false;
+    m_jit_batch_size = 0;
+    m_jit_batch_result = NULL;
+    m_jit_batch_lanes = 1;
+    m_jit_kernel = false;
+    m_jit_kernel_scratch_size = 0;
+    m_jit_compiler = NULL;
+    m_jit_compiler_arg = false;
 #endif
-    init_functions(m_functions);
-    init_operators(m_operators);
-    init_constants(m_constants);
-
-    m_transition_table.resize(29);
-    m_transition_table[ 0].set_values("func var const sign (",  1, false, false, false, true );
-    m_transition_table[ 1].set_values("func var const sign (",  2, false, false, false, true );
-    m_transition_table[ 2].set_values("sign",                   4, false, false, false, false);
-    m_transition_table[ 3].set_values("func var const (",       6, false, false, false, true );
-    m_transition_table[ 4].set_values("sign",                   5, true,  false, false, true );
-    m_transition_table[ 5].set_values("func var const (",       7, false, false, false, true );
-    m_transition_table[ 6].set_values("func var const (",       7, false, false, false, true );
-    m_transition_table[ 7].set_values("var",                   11, false, false, false, false);
-    m_transition_table[ 8].set_values("const",                 13, false, false, false, false);
-    m_transition_table[ 9].set_values("(",                     15, false, false, false, false);
-    m_transition_table[10].set_values("func",                  19, false, false, false, true );
-    m_transition_table[11].set_values("var",                   12, true,  false, false, true );
-    m_transition_table[12].set_values("oper eps",              24, false, false, false, true );
-    m_transition_table[13].set_values("const",                 14, true,  false, false, true );
-    m_transition_table[14].set_values("oper eps",              24, false, false, false, true );
-    m_transition_table[15].set_values("(",                     16, true,  false, false, true );
-    m_transition_table[16].set_values("func var const sign (",  2, false, true,  false, true );
-    m_transition_table[17].set_values(")",                     18, true,  false, false, true );
-    m_transition_table[18].set_values("oper eps",              24, false, false, false, true );
-    m_transition_table[19].set_values("func",                  20, true,  false, false, true );
-    m_transition_table[20].set_values("(",                     21, true,  false, false, true );
-    m_transition_table[21].set_values("func var const sign (",  2, false, true,  false, true );
-    m_transition_table[22].set_values(")",                     23, true,  false, false, true );
-    m_transition_table[23].set_values("oper eps",              24, false, false, false, true );
-    m_transition_table[24].set_values("oper",                  27, false, false, false, false);
-    m_transition_table[25].set_values("eps",                   26, false, false, false, true );
-    m_transition_table[26].set_values("eps",                   -1, false, false, true,  true );
-    m_transition_table[27].set_values("oper",                  28, true,  false, false, true );
-    m_transition_table[28].set_values("func var const (",       7, false, false, false, true );
 }
 
 // Copying from another evaluator
 template<typename T>
 void evaluator<T>::copy_from_other(const evaluator & other)
 {
-    m_expression = other.m_expression;
-    m_functions = other.m_functions;
+    using namespace evaluator_internal;
+    m_program = other.m_program;
+    m_registry = other.m_registry;
     m_variables = other.m_variables;
-    m_constants = other.m_constants;
-    m_operators = other.m_operators;
+    m_calc_stack.resize(m_program->calc_stack_size);
+    m_cse_values.resize(m_program->cse_temps);
     m_status = other.m_status;
     m_error_string = other.m_error_string;
-    m_transition_table = other.m_transition_table;
     m_is_compiled = false;
 #if !defined(EVALUATOR_JIT_DISABLE)
     m_jit_code = NULL;
@@ -116,32 +54,123 @@ void evaluator<T>::copy_from_other(const evaluator & other)
     m_jit_stack = NULL;
     m_jit_stack_size = 0;
     m_jit_func = NULL;
+    m_jit_batch = false;
+    m_jit_batch_size = 0;
+    m_jit_batch_result = NULL;
+    m_jit_batch_lanes = 1;
+    m_jit_kernel = false;
+    m_jit_kernel_scratch_size = 0;
+    m_jit_compiler = NULL;
+    m_jit_compiler_arg = false;
+    // Reentrant kernel does not depend on evaluator, so it is shared, other compiled code
+    // uses addresses of variables and stack of 'other', so it is compiled anew by the same function,
+    // copy is not compiled if this fails
+    if(other.m_is_compiled && other.m_jit_kernel)
+        jit_share_kernel(other);
+    else if(other.m_is_compiled && other.m_jit_compiler && !(this->*other.m_jit_compiler)(other.m_jit_compiler_arg))
+        m_error_string = other.m_error_string;
 #endif
 }
 
+// Make constant object, its value is added to constant pool
+template<typename T>
+evaluator_internal::evaluator_object<T> evaluator<T>::make_constant(evaluator_internal::program<T> & prog,
+                                                                  const std::string & str, const T & value)
+{
+    using namespace evaluator_internal;
+    prog.const_values.push_back(value);
+    return evaluator_object<T>(evaluator_object<T>::OBJ_CONSTANT, prog.names.intern(str), prog.const_values.size() - 1);
+}
+
+// Make variable object, variable is created if it doesn't exist
+template<typename T>
+evaluator_internal::evaluator_object<T> evaluator<T>::make_variable(evaluator_internal::program<T> & prog,
+                                                                  const std::string & name)
+{
+    using namespace evaluator_internal;
+    return evaluator_object<T>(evaluator_object<T>::OBJ_VARIABLE, prog.names.intern(name), var_index(name));
+}
+
+// Make function object
+template<typename T>
+evaluator_internal::evaluator_object<T> evaluator<T>::make_function(evaluator_internal::program<T> & prog,
+                                                                  const std::string & name, func_type func)
+{
+    return evaluator_internal::evaluator_object<T>(prog.names.intern(name), func);
+}
+
+// Make operator object
+template<typename T>
+evaluator_internal::evaluator_object<T> evaluator<T>::make_operator(evaluator_internal::program<T> & prog,
+                                                                  const std::string & name, oper_type oper)
+{
+    return evaluator_internal::evaluator_object<T>(prog.names.intern(name), oper);
+}
+
+namespace evaluator_internal
+{
+
+// Lowercase name of function or constant, the same as in parse()
+inline std::string builtin_name(const std::string & name)
+{
+    std::string result(name);
+    for(std::size_t i = 0; i < result.size(); i++)
+        if(result[i] >= 'A' && result[i] <= 'Z')
+            result[i] = static_cast<char>(result[i] - 'A' + 'a');
+    return result;
+}
+
+} // namespace evaluator_internal
+
+// Add or replace function 'name' of own builtins, names are case insensitive
+template<typename T>
+void evaluator<T>::set_function(const std::string & name, func_type func)
+{
+    own_registry().functions.insert(evaluator_internal::builtin_name(name), func);
+}
+
+// Add or replace named constant 'name' of own builtins, names are case insensitive
+template<typename T>
+void evaluator<T>::set_constant(const std::string & name, const T & value)
+{
+    own_registry().constants.insert(evaluator_internal::builtin_name(name), value);
+}
+
+// Index of variable with name 'name', new variable is created without value,
+// compiled code with addresses of variables is reset if slot table is moved
+template<typename T>
+std::size_t evaluator<T>::var_index(const std::string & name)
+{
+    const T * const data = m_variables.data();
+    const std::size_t index = m_variables.insert(name);
+#if !defined(EVALUATOR_JIT_DISABLE)
+    // Batch and kernel modes address variables by indices
+    if(m_variables.data() != data && !m_jit_batch && !m_jit_kernel)
+        m_is_compiled = false;
+#else
+    (void)(data);
+#endif
+    return index;
+}
+
+// Get handle of variable with name 'name', variable is created if it doesn't exist
+template<typename T>
+typename evaluator<T>::var_handle evaluator<T>::get_var_handle(const std::string & name)
+{
+    return var_index(name);
+}
+
 // Reset all variables
 template<typename T>
 void evaluator<T>::reset_vars()
 {
-    using namespace evaluator_internal;
-    m_variables.clear();
-    if(is_parsed())
-    {
-        for(typename std::vector<evaluator_object<T> >::iterator
-            it = m_expression.begin(), it_end = m_expression.end(); it != it_end; ++it)
-        {
-            if(it->is_variable())
-            {
-                m_variables[it->str()].value() = incorrect_number(T());
-                *it = evaluator_object<T>(it->str(), m_variables[it->str()].pointer());
-            }
-        }
-    }
+    m_variables.reset();
 }
 
 // Constructors and destructor
 template<typename T>
 evaluator<T>::evaluator(const evaluator & other)
+    : m_program(other.m_program), m_registry(other.m_registry)
 {
     copy_from_other(other);
 }
@@ -163,8 +192,7 @@ template<typename T>
 evaluator<T>::~evaluator()
 {
 #if !defined(EVALUATOR_JIT_DISABLE)
-    if(m_jit_code && m_jit_code_size)
-        evaluator_internal_jit::exec_dealloc(m_jit_code, m_jit_code_size);
+    jit_release();
     if(m_jit_stack && m_jit_stack_size)
         delete [] m_jit_stack;
 #endif
@@ -175,7 +203,14 @@ template<typename T>
 const evaluator<T> & evaluator<T>::operator = (const evaluator & other)
 {
     if(this != &other)
+    {
+#if !defined(EVALUATOR_JIT_DISABLE)
+        jit_release();
+        if(m_jit_stack && m_jit_stack_size)
+            delete [] m_jit_stack;
+#endif
         copy_from_other(other);
+    }
     return * this;
 }
 
@@ -185,11 +220,11 @@ void evaluator<T>::debug_print() const
 {
     using namespace evaluator_internal;
     for(typename std::vector<evaluator_object<T> >::const_iterator
-        it = m_expression.begin(), it_end = m_expression.end(); it != it_end; ++it)
+        it = m_program->expression.begin(), it_end = m_program->expression.end(); it != it_end; ++it)
     {
-        std::cout << it->str();
+        std::cout << obj_str(*it);
         if(it->is_variable())
-            std::cout << "->" << it->eval() << ' ';
+            std::cout << "->" << obj_eval(*it) << ' ';
         else
             std::cout << ' ';
     }
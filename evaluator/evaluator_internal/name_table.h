@@ -0,0 +1,57 @@
+#if !defined(EVALUATOR_NAME_TABLE_H)
+#define EVALUATOR_NAME_TABLE_H
+
+#include <map>
+#include <vector>
+#include <string>
+#include <cstddef>
+
+namespace evaluator_internal
+{
+
+// Interned names of evaluator objects: each distinct name is stored once and referenced by id
+class name_table
+{
+public:
+
+    // Id of name 'name', the name is added if it is new
+    unsigned int intern(const std::string & name)
+    {
+        std::map<std::string, unsigned int>::const_iterator it = m_ids.find(name);
+        if(it != m_ids.end())
+            return it->second;
+        const unsigned int id = static_cast<unsigned int>(m_names.size());
+        m_names.push_back(name);
+        m_ids[name] = id;
+        return id;
+    }
+
+    // Name with id 'id'
+    inline const std::string & operator [] (unsigned int id) const
+    {
+        return m_names[id];
+    }
+
+    // Number of names
+    inline std::size_t size() const
+    {
+        return m_names.size();
+    }
+
+    void clear()
+    {
+        m_names.clear();
+        m_ids.clear();
+    }
+
+private:
+
+    // Names by id
+    std::vector<std::string> m_names;
+    // Container: [name]->id
+    std::map<std::string, unsigned int> m_ids;
+};
+
+} // namespace evaluator_internal
+
+#endif // EVALUATOR_NAME_TABLE_H
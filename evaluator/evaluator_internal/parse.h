@@ -79,6 +79,7 @@
 #include <stack>
 #include <map>
 #include <cstring>
+#include "token.h"
 #include "../evaluator.h"
 
 // Parse string 'str'
@@ -87,76 +88,86 @@ bool evaluator<T>::parse(const std::string & str)
 {
     using namespace evaluator_internal;
 
-    m_expression.clear();
+    program<T> & prog = m_program.write_new();
+    prog.expression.clear();
+    prog.names.clear();
+    prog.const_values.clear();
     m_error_string.clear();
     m_status = true;
     m_is_compiled = false;
+    prog.cse = false;
 
-    std::vector<std::string> tokens;
-    for(std::string::const_iterator it = str.begin(), it_end = str.end(); it != it_end;)
+    // Tokens are spans of 'str', numbers and names of functions and constants are resolved here
+    std::vector<token<T> > tokens;
+    std::string text;
+    const std::size_t len = str.size();
+    for(std::size_t pos = 0; pos < len;)
     {
-        std::string a;
-        if((*it >= '0' && *it <= '9') || *it == '.' || *it == ',')
+        const char c = str[pos];
+        token<T> tok;
+        tok.offset = pos;
+        tok.value = T();
+        tok.name = NULL;
+        tok.func = NULL;
+        tok.symbol = '\0';
+        tok.terminals = 0;
+        if((c >= '0' && c <= '9') || c == '.' || c == ',')
         {
-            while(it != str.end() && *it >= '0' && *it <= '9')
-            {
-                a.push_back(*(it++));
-            }
-            if(it != str.end() && (*it == '.' || *it == ','))
+            number_text(str, pos, text);
+            if(((text[0] >= '0' && text[0] <= '9') || (text[0] == '.' && text[1] >= '0' && text[1] <= '9')) &&
+               parse_number(text.c_str(), tok.value))
+                tok.kind = TOKEN_NUMBER;
+            else
+                tok.kind = TOKEN_UNKNOWN;
+        }
+        else if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+        {
+            text.clear();
+            while(pos < len && str[pos] != '(' && str[pos] != ')' && str[pos] != '\f' && str[pos] != '\v' &&
+                  str[pos] != ' ' && str[pos] != '\t' && str[pos] != '\0' && str[pos] != '\r' && str[pos] != '\n' &&
+                  m_registry->operators.find(str[pos]) == m_registry->operators.end())
             {
-                a.push_back('.');
-                while((++it) != str.end() && *it >= '0' && *it <= '9')
-                {
-                    a.push_back(*it);
-                }
+                const char d = str[pos++];
+                text.push_back((d >= 'A' && d <= 'Z') ? static_cast<char>(d - 'A' + 'a') : d);
             }
-            if(it != str.end() && (*it == 'e' || *it == 'E' || *it == 'd' || *it == 'D'))
+            // Names of functions and constants are case insensitive, names of variables are not
+            const typename flat_table<func_type>::entry * fu = m_registry->functions.find(text);
+            const typename flat_table<T>::entry * co = NULL;
+            if(fu)
             {
-                a.push_back('e');
-                if((++it) != str.end() && (*it == '-' || *it == '+'))
-                {
-                    a.push_back(*(it++));
-                }
-                while(it != str.end() && *it >= '0' && *it <= '9')
-                {
-                    a.push_back(*(it++));
-                }
+                tok.kind = TOKEN_FUNC;
+                tok.name = & fu->name;
+                tok.func = fu->value;
             }
-            std::transform(a.begin(), a.end(), a.begin(), ::tolower);
-            tokens.push_back(a);
-        }
-        else if((*it >= 'a' && *it <= 'z') || (*it >= 'A' && *it <= 'Z'))
-        {
-            while(it != str.end() && *it != '(' && *it != ')' && *it != '\f' && *it != '\v' &&
-                  *it != ' ' && *it != '\t' && *it != '\0' && *it != '\r' && *it != '\n' &&
-                  m_operators.find(*it) == m_operators.end())
+            else if((co = m_registry->constants.find(text)) != NULL)
             {
-                a.push_back(*(it++));
+                tok.kind = TOKEN_CONST;
+                tok.name = & co->name;
+                tok.value = co->value;
             }
-            const std::string b(a);
-            std::transform(a.begin(), a.end(), a.begin(), ::tolower);
-            if(m_functions.find(a) != m_functions.end() || m_constants.find(a) != m_constants.end())
-                tokens.push_back(a);
             else
-                tokens.push_back(b);
+                tok.kind = TOKEN_VAR;
         }
-        else if(m_operators.find(*it) != m_operators.end() || *it == '(' || *it == ')')
+        else if(m_registry->operators.find(c) != m_registry->operators.end() || c == '(' || c == ')')
         {
-            a.push_back(*(it++));
-            std::transform(a.begin(), a.end(), a.begin(), ::tolower);
-            tokens.push_back(a);
+            tok.kind = (c == '(' ? TOKEN_BR_OPEN : (c == ')' ? TOKEN_BR_CLOSE : TOKEN_OPER));
+            tok.symbol = c;
+            pos++;
         }
-        else if(*it == ' ' || *it == '\t' || *it == '\0' || *it == '\r' ||
-                *it == '\n' || *it == '\f' || *it == '\v')
+        else if(c == ' ' || c == '\t' || c == '\0' || c == '\r' ||
+                c == '\n' || c == '\f' || c == '\v')
         {
-            ++it;
+            pos++;
+            continue;
         }
         else
         {
             m_status = false;
-            m_error_string = std::string("Unexpected symbol `") + std::string().assign(1, *it) + std::string("`!");
+            m_error_string = std::string("Unexpected symbol `") + std::string().assign(1, c) + std::string("`!");
             return false;
         }
+        tok.length = pos - tok.offset;
+        tokens.push_back(tok);
     }
 
     if(tokens.size() <= 0)
@@ -166,203 +177,142 @@ bool evaluator<T>::parse(const std::string & str)
         return false;
     }
 
-    enum token_type
+    // Terminals of each token, variables and constants must be followed by operator or ")",
+    // function without arguments is a variable
+    for(std::size_t i = 0; i < tokens.size(); i++)
     {
-        TTYPE_EPS,
-        TTYPE_SIGN_MINUS,
-        TTYPE_SIGN_PLUS,
-        TTYPE_FUNC,
-        TTYPE_OPER,
-        TTYPE_VAR,
-        TTYPE_CONST,
-        TTYPE_BR_OPEN,
-        TTYPE_BR_CLOSE
-    };
-    token_type ttype_curr = TTYPE_EPS;
+        token<T> & tok = tokens[i];
+        const bool followed = i + 1 >= tokens.size() ||
+                tokens[i + 1].kind == TOKEN_OPER || tokens[i + 1].kind == TOKEN_BR_CLOSE;
+        switch(tok.kind)
+        {
+        case TOKEN_NUMBER:
+        case TOKEN_CONST:
+            if(followed)
+                tok.terminals = TERM_CONST;
+            break;
+        case TOKEN_FUNC:
+            tok.terminals = TERM_FUNC;
+            if(followed)
+                tok.terminals |= TERM_VAR;
+            break;
+        case TOKEN_VAR:
+            if(followed)
+                tok.terminals = TERM_VAR;
+            break;
+        case TOKEN_OPER:
+            tok.terminals = TERM_OPER;
+            if(tok.symbol == '-' || tok.symbol == '+')
+                tok.terminals |= TERM_SIGN;
+            break;
+        case TOKEN_BR_OPEN:
+            tok.terminals = TERM_BR_OPEN;
+            break;
+        case TOKEN_BR_CLOSE:
+            tok.terminals = TERM_BR_CLOSE | TERM_EPS;
+            break;
+        default:
+            break;
+        }
+    }
+
     bool unary_minus = false;
-    std::stack<std::string> st;
+    // Stack of operators, brackets and functions
+    std::vector<token<T> > st;
+    // Multiplication by -1 for unary minus
+    token<T> mult;
+    mult.kind = TOKEN_OPER;
+    mult.offset = mult.length = 0;
+    mult.value = T();
+    mult.name = NULL;
+    mult.func = NULL;
+    mult.symbol = '*';
+    mult.terminals = TERM_OPER;
 
     std::size_t token_pos_curr = 0;
     std::size_t table_pos_curr = 0;
     std::stack<std::size_t> table_stack;
     for(bool flag_continue = true; flag_continue;)
     {
-        bool good_token = false;
-        for(std::vector<std::string>::const_iterator it = m_transition_table[table_pos_curr].Terminals.begin(),
-            it_end = m_transition_table[table_pos_curr].Terminals.end(); !good_token && it != it_end; ++it)
-        {
-            if(token_pos_curr < tokens.size())
-            {
-                if(*it == "eps")
-                {
-                    if(tokens[token_pos_curr] == ")")
-                    {
-                        good_token = true;
-                        ttype_curr = TTYPE_EPS;
-                    }
-                }
-                else if(*it == "func")
-                {
-                    if(m_functions.find(tokens[token_pos_curr]) != m_functions.end())
-                    {
-                        good_token = true;
-                        ttype_curr = TTYPE_FUNC;
-                    }
-                }
-                else if(*it == "oper")
-                {
-                    if(m_operators.find(tokens[token_pos_curr][0]) != m_operators.end())
-                    {
-                        good_token = true;
-                        ttype_curr = TTYPE_OPER;
-                    }
-                }
-                else if(*it == "var" || *it == "const")
-                {
-                    const bool last_token = token_pos_curr + 1 >= tokens.size();
-                    const char * curr_tok = tokens[token_pos_curr].c_str();
-                    const char * next_tok = (last_token ? NULL : tokens[token_pos_curr + 1].c_str());
-
-                    const bool first_letter = (curr_tok[0] >= 'a' && curr_tok[0] <= 'z') ||
-                                              (curr_tok[0] >= 'A' && curr_tok[0] <= 'Z');
-                    const bool first_number = curr_tok[0] >= '0' && curr_tok[0] <= '9';
-                    const bool first_dot = curr_tok[0] == '.';
-                    const bool second_number = curr_tok[1] >= '0' && curr_tok[1] <= '9';
-                    const bool next_operator = !last_token && m_operators.find(next_tok[0]) != m_operators.end();
-                    const bool next_bracket = !last_token && next_tok[0] == ')';
-                    const bool is_constant = m_constants.find(curr_tok) != m_constants.end();
-
-                    if(*it == "var")
-                    {
-                        if(!is_constant && first_letter && (last_token || next_operator || next_bracket))
-                        {
-                            good_token = true;
-                            ttype_curr = TTYPE_VAR;
-                        }
-                    }
-                    else if(*it == "const")
-                    {
-                        if((is_constant || first_number || (first_dot && second_number)) &&
-                           (last_token || next_operator || next_bracket))
-                        {
-                            good_token = true;
-                            ttype_curr = TTYPE_CONST;
-                        }
-                    }
-                }
-                else if(*it == "sign")
-                {
-                    if(tokens[token_pos_curr][0] == '-' || tokens[token_pos_curr][0] == '+')
-                    {
-                        good_token = true;
-                        if(tokens[token_pos_curr][0] == '-')
-                        {
-                            ttype_curr = TTYPE_SIGN_MINUS;
-                            unary_minus = true;
-                        }
-                        else
-                            ttype_curr = TTYPE_SIGN_PLUS;
-                    }
-                }
-                else if(*it == tokens[token_pos_curr])
-                {
-                    good_token = true;
-                    if(tokens[token_pos_curr][0] == '(')
-                        ttype_curr = TTYPE_BR_OPEN;
-                    else if(tokens[token_pos_curr][0] == ')')
-                        ttype_curr = TTYPE_BR_CLOSE;
-                }
-            }
-            else if(*it == "eps")
-            {
-                good_token = true;
-                ttype_curr = TTYPE_EPS;
-            }
-        }
+        const transition_table_record & record = transition_table[table_pos_curr];
+        // End of string matches only "eps"
+        unsigned int matched = TERM_EPS;
+        if(token_pos_curr < tokens.size())
+            matched = tokens[token_pos_curr].terminals;
+        matched &= record.Terminals;
 
-        if(good_token)
+        if(matched)
         {
-            if(m_transition_table[table_pos_curr].Stack)
+            if(record.Stack)
                 table_stack.push(table_pos_curr + 1);
-            if(m_transition_table[table_pos_curr].Accept)
+            // Accepting states have one terminal
+            if(record.Accept)
             {
-                switch(ttype_curr)
+                const token<T> & tok = tokens[token_pos_curr];
+                switch(matched)
                 {
-                case TTYPE_CONST:
+                case TERM_SIGN:
+                    if(tok.symbol == '-')
+                        unary_minus = true;
+                    break;
+                case TERM_CONST:
                 {
-                    std::string a = tokens[token_pos_curr];
+                    T c = tok.value;
+                    std::string a = token_text(str, tok);
                     if(unary_minus)
                     {
                         a = "-" + a;
+                        negate_number(c);
                         unary_minus = false;
                     }
-                    T c;
-                    typename std::map<std::string, T>::const_iterator
-                            it = m_constants.find(tokens[token_pos_curr]);
-                    if(it == m_constants.end())
-                    {
-                        std::stringstream b(a);
-                        b >> c;
-                    }
-                    else
-                        c = it->second;
-                    m_expression.push_back(evaluator_object<T>(a, c));
+                    prog.expression.push_back(make_constant(prog, a, c));
                     break;
                 }
-                case TTYPE_VAR:
+                case TERM_VAR:
                 {
-                    const std::string a = tokens[token_pos_curr];
                     if(unary_minus)
                     {
                         T m_one = static_cast<T>(-1);
-                        m_expression.push_back(evaluator_object<T>("-1", m_one));
-                        st.push("*");
+                        prog.expression.push_back(make_constant(prog, "-1", m_one));
+                        st.push_back(mult);
                         unary_minus = false;
                     }
-                    typename std::map<std::string, var_container<T> >::const_iterator itc = m_variables.find(a);
-                    if(itc == m_variables.end())
-                    {
-                        m_variables[a].value() = incorrect_number(T());
-                        itc = m_variables.find(a);
-                    }
-                    m_expression.push_back(evaluator_object<T>(a, itc->second.pointer()));
+                    prog.expression.push_back(make_variable(prog, tok.name ? * tok.name : str.substr(tok.offset, tok.length)));
                     break;
                 }
-                case TTYPE_BR_OPEN:
-                case TTYPE_FUNC:
+                case TERM_BR_OPEN:
+                case TERM_FUNC:
                 {
                     if(unary_minus)
                     {
                         const T m_one = static_cast<T>(-1);
-                        m_expression.push_back(evaluator_object<T>("-1", m_one));
-                        st.push("*");
+                        prog.expression.push_back(make_constant(prog, "-1", m_one));
+                        st.push_back(mult);
                         unary_minus = false;
                     }
-                    st.push(tokens[token_pos_curr]);
+                    st.push_back(tok);
                     break;
                 }
-                case TTYPE_OPER:
+                case TERM_OPER:
                 {
-                    char op = '\0', sym = tokens[token_pos_curr][0];
-                    if(!st.empty()) op = st.top()[0];
-                    while(!st.empty() && m_operators.find(op) != m_operators.end() &&
-                          m_operators[sym].first <= m_operators[op].first)
+                    const unsigned short int priority = m_registry->operators.find(tok.symbol)->second.first;
+                    typename std::map<char, std::pair<unsigned short int, oper_type> >::const_iterator op;
+                    while(!st.empty() && st.back().kind == TOKEN_OPER &&
+                          priority <= (op = m_registry->operators.find(st.back().symbol))->second.first)
                     {
-                        m_expression.push_back(evaluator_object<T>(st.top(),
-                                                     m_operators.find(st.top()[0])->second.second));
-                        st.pop();
-                        if(!st.empty()) op = st.top()[0];
+                        prog.expression.push_back(make_operator(prog, std::string(1, op->first), op->second.second));
+                        st.pop_back();
                     }
-                    st.push(tokens[token_pos_curr]);
+                    st.push_back(tok);
                     break;
                 }
-                case TTYPE_BR_CLOSE:
+                case TERM_BR_CLOSE:
                 {
-                    while(!st.empty() && st.top() != "(")
+                    while(!st.empty() && st.back().kind != TOKEN_BR_OPEN)
                     {
-                        m_expression.push_back(evaluator_object<T>(st.top(),
-                                                     m_operators.find(st.top()[0])->second.second));
-                        st.pop();
+                        prog.expression.push_back(make_operator(prog, std::string(1, st.back().symbol),
+                                                     m_registry->operators.find(st.back().symbol)->second.second));
+                        st.pop_back();
                     }
                     if(st.empty())
                     {
@@ -370,12 +320,11 @@ bool evaluator<T>::parse(const std::string & str)
                         m_error_string = "Wrong brackets balance!";
                         return false;
                     }
-                    st.pop();
-                    if(!st.empty() && m_functions.find(st.top()) != m_functions.end())
+                    st.pop_back();
+                    if(!st.empty() && st.back().kind == TOKEN_FUNC)
                     {
-                        m_expression.push_back(evaluator_object<T>(st.top(),
-                                                     m_functions.find(st.top())->second));
-                        st.pop();
+                        prog.expression.push_back(make_function(prog, * st.back().name, st.back().func));
+                        st.pop_back();
                     }
                     break;
                 }
@@ -384,7 +333,7 @@ bool evaluator<T>::parse(const std::string & str)
                 }
                 token_pos_curr++;
             }
-            if(m_transition_table[table_pos_curr].Return)
+            if(record.Return)
             {
                 if(table_stack.size() > 0)
                 {
@@ -395,15 +344,15 @@ bool evaluator<T>::parse(const std::string & str)
                     flag_continue = false;
             }
             else
-                table_pos_curr = static_cast<std::size_t>(m_transition_table[table_pos_curr].Jump);
+                table_pos_curr = static_cast<std::size_t>(record.Jump);
         }
         else
         {
-            if(m_transition_table[table_pos_curr].Error)
+            if(record.Error)
             {
                 m_status = false;
                 if(token_pos_curr < tokens.size())
-                    m_error_string = std::string("Bad token `") + tokens[token_pos_curr] + std::string("`!");
+                    m_error_string = std::string("Bad token `") + token_text(str, tokens[token_pos_curr]) + std::string("`!");
                 else
                     m_error_string = "Unexpected end of string!";
                 return false;
@@ -417,17 +366,18 @@ bool evaluator<T>::parse(const std::string & str)
 
     while(m_status && !st.empty())
     {
-        if(m_operators.find(st.top()[0]) == m_operators.end())
+        if(st.back().kind != TOKEN_OPER)
         {
             m_status = false;
             m_error_string = "Wrong expression!";
             break;
         }
-        m_expression.push_back(evaluator_object<T>(st.top(),
-                                     m_operators.find(st.top()[0])->second.second));
-        st.pop();
+        prog.expression.push_back(make_operator(prog, std::string(1, st.back().symbol),
+                                     m_registry->operators.find(st.back().symbol)->second.second));
+        st.pop_back();
     }
 
+    calc_init();
     return m_status;
 }
 
@@ -0,0 +1,250 @@
+#if !defined(EVALUATOR_PARSE_CACHE_H)
+#define EVALUATOR_PARSE_CACHE_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include "lru_cache.h"
+#include "../evaluator.h"
+
+namespace evaluator_internal
+{
+
+// Suffix of keys of cache of parse_cached() for steps after parsing,
+// expression has no "\0" after normalization, so steps are separated by it
+inline std::string parse_cache_steps(bool simplify, bool kernel)
+{
+    std::string steps(1, '\0');
+    steps.push_back(static_cast<char>('0' + (simplify ? 1 : 0) + (kernel ? 2 : 0)));
+    return steps;
+}
+
+// Key of expression 'str' in cache of parse_cached(): runs of spaces are replaced by one space,
+// spaces around brackets and "*", "/", "^" and at the ends are removed, steps after parsing are appended
+inline std::string parse_cache_key(const std::string & str, bool simplify, bool kernel)
+{
+    std::string key;
+    key.reserve(str.size() + 2);
+    bool space = false;
+    for(std::size_t i = 0; i < str.size(); i++)
+    {
+        const char c = str[i];
+        if(c == ' ' || c == '\t' || c == '\0' || c == '\r' || c == '\n' || c == '\f' || c == '\v')
+        {
+            space = true;
+            continue;
+        }
+        const bool separator = (c == '(' || c == ')' || c == '*' || c == '/' || c == '^');
+        if(space && !key.empty() && !separator)
+        {
+            const char p = key[key.size() - 1];
+            if(p != '(' && p != ')' && p != '*' && p != '/' && p != '^')
+                key.push_back(' ');
+        }
+        space = false;
+        key.push_back(c);
+    }
+    return key + parse_cache_steps(simplify, kernel);
+}
+
+} // namespace evaluator_internal
+
+// Process-wide cache of parse_cached(), created on first use and never destroyed,
+// so it may be used by static evaluators, 16 MiB by default
+template<typename T>
+evaluator_internal::lru_cache<evaluator<T> > & evaluator<T>::parse_cache()
+{
+    static evaluator_internal::lru_cache<evaluator> * const instance =
+            new evaluator_internal::lru_cache<evaluator>(16 * 1024 * 1024);
+    return * instance;
+}
+
+// Process-wide cache of parse_cached() for texts of expressions, their canonical forms are usually
+// much fewer, created on first use and never destroyed, 16 MiB by default
+template<typename T>
+evaluator_internal::lru_cache<std::string> & evaluator<T>::parse_cache_aliases()
+{
+    static evaluator_internal::lru_cache<std::string> * const instance =
+            new evaluator_internal::lru_cache<std::string>(16 * 1024 * 1024);
+    return * instance;
+}
+
+// Memory of parsed expression in bytes, estimated
+template<typename T>
+std::size_t evaluator<T>::program_bytes() const
+{
+    using namespace evaluator_internal;
+    const program<T> & prog = * m_program;
+    std::size_t bytes = sizeof(evaluator) + sizeof(program<T>) +
+            prog.expression.size() * sizeof(evaluator_object<T>) +
+            prog.const_values.size() * sizeof(T) +
+            m_calc_stack.size() * sizeof(T) +
+            prog.bytecode.size() * sizeof(bc_instr<T>) +
+            prog.cse_plan.size() * sizeof(cse_action) +
+            m_cse_values.size() * sizeof(T);
+    for(std::size_t i = 0; i < prog.names.size(); i++)
+        bytes += prog.names[static_cast<unsigned int>(i)].size() * 2 + sizeof(std::string) * 2;
+    for(std::size_t i = 0; i < m_variables.size(); i++)
+        bytes += m_variables.name(i).size() * 2 + sizeof(std::string) * 2 + sizeof(T);
+#if !defined(EVALUATOR_JIT_DISABLE)
+    if(m_is_compiled && m_jit_kernel)
+        bytes += m_jit_code_size;
+#endif
+    return bytes;
+}
+
+// Copy parsed expression of 'other', its variables are found by names among variables of this evaluator,
+// reentrant kernel of 'other' is shared
+template<typename T>
+void evaluator<T>::copy_program(const evaluator & other)
+{
+    using namespace evaluator_internal;
+
+    // Indices of variables of 'other' in this evaluator, usually the same ones
+    std::vector<std::size_t> vars(other.m_variables.size());
+    bool same_vars = true;
+    for(std::size_t i = 0; i < vars.size(); i++)
+    {
+        vars[i] = var_index(other.m_variables.name(i));
+        if(vars[i] != i)
+            same_vars = false;
+    }
+
+    // Program is shared, it is copied only if variables must be renumbered
+    m_program = other.m_program;
+    m_status = other.m_status;
+    m_error_string = other.m_error_string;
+    if(same_vars)
+    {
+        m_calc_stack.resize(m_program->calc_stack_size);
+        m_cse_values.resize(m_program->cse_temps);
+    }
+    else
+    {
+        program<T> & prog = m_program.write();
+        for(typename std::vector<evaluator_object<T> >::iterator
+            it = prog.expression.begin(), it_end = prog.expression.end(); it != it_end; ++it)
+        {
+            if(it->is_variable())
+                * it = evaluator_object<T>(evaluator_object<T>::OBJ_VARIABLE, it->name(), vars[it->index()]);
+        }
+        calc_init();
+    }
+
+    m_is_compiled = false;
+#if !defined(EVALUATOR_JIT_DISABLE)
+    jit_release();
+    m_jit_batch = false;
+    m_jit_kernel = false;
+    if(other.m_is_compiled && other.m_jit_kernel)
+    {
+        jit_share_kernel(other);
+        for(std::size_t i = 0; i < m_jit_kernel_slots.size(); i++)
+            m_jit_kernel_slots[i] = vars[m_jit_kernel_slots[i]];
+    }
+#endif
+}
+
+// Parse string 'str' by process-wide cache of parsed expressions, the cache keeps the result of
+// simplify() if 'simplify' is true and of compile_kernel() if 'kernel' is true. Cached expressions
+// are found by canonical text, its constants have all digits of their values, so a hit is the same
+// program as cold parse
+template<typename T>
+bool evaluator<T>::parse_cached(const std::string & str, bool simplify, bool kernel)
+{
+    using namespace evaluator_internal;
+
+    // Cached programs are parsed with shared builtins
+    if(!m_registry.is_shared())
+    {
+        bool status = parse(str);
+        if(status && simplify)
+            status = this->simplify();
+        if(status && kernel)
+            status = compile_kernel();
+        return status;
+    }
+
+    // Text of expression is looked up first, then its canonical form
+    const std::string key = parse_cache_key(str, simplify, kernel);
+    std::string canonical_key;
+    {
+        scoped_lock lock(LOCK_CACHE);
+        const std::string * alias = parse_cache_aliases().find(key);
+        if(alias)
+        {
+            canonical_key = * alias;
+            const evaluator * cached = parse_cache().find(canonical_key);
+            if(cached)
+            {
+                copy_program(* cached);
+                return true;
+            }
+        }
+    }
+
+    // Expression is prepared by separate evaluator, so it has only its own variables,
+    // failed expressions are not cached
+    evaluator fresh;
+    bool status = fresh.parse(str);
+    if(status && simplify)
+        status = fresh.simplify();
+    if(status)
+        status = fresh.canonicalize();
+    if(!status)
+    {
+        copy_program(fresh);
+        return false;
+    }
+    const bool looked_up = !canonical_key.empty();
+    canonical_key = fresh.canonical_text() + parse_cache_steps(simplify, kernel);
+    {
+        scoped_lock lock(LOCK_CACHE);
+        parse_cache_aliases().insert(key, canonical_key, key.size() + canonical_key.size() + sizeof(std::string) * 2);
+        const evaluator * cached = looked_up ? NULL : parse_cache().find(canonical_key);
+        if(cached)
+        {
+            copy_program(* cached);
+            return true;
+        }
+    }
+    if(kernel && !fresh.compile_kernel())
+    {
+        copy_program(fresh);
+        return false;
+    }
+    {
+        scoped_lock lock(LOCK_CACHE);
+        parse_cache().insert(canonical_key, fresh, fresh.program_bytes() + canonical_key.size());
+    }
+    copy_program(fresh);
+    return true;
+}
+
+// Limit of memory of cache of parse_cached() in bytes, least recently used expressions are removed
+template<typename T>
+void evaluator<T>::set_parse_cache_limit(std::size_t max_bytes)
+{
+    evaluator_internal::scoped_lock lock(evaluator_internal::LOCK_CACHE);
+    parse_cache().set_max_bytes(max_bytes);
+    parse_cache_aliases().set_max_bytes(max_bytes);
+}
+
+// Statistics of cache of parse_cached()
+template<typename T>
+evaluator_internal::cache_stats evaluator<T>::get_parse_cache_stats()
+{
+    evaluator_internal::scoped_lock lock(evaluator_internal::LOCK_CACHE);
+    return parse_cache().stats();
+}
+
+// Remove all expressions from cache of parse_cached()
+template<typename T>
+void evaluator<T>::clear_parse_cache()
+{
+    evaluator_internal::scoped_lock lock(evaluator_internal::LOCK_CACHE);
+    parse_cache().clear();
+    parse_cache_aliases().clear();
+}
+
+#endif // EVALUATOR_PARSE_CACHE_H
@@ -0,0 +1,59 @@
+#if !defined(EVALUATOR_PROGRAM_H)
+#define EVALUATOR_PROGRAM_H
+
+#include <vector>
+#include <cstddef>
+#include "evaluator_object.h"
+#include "name_table.h"
+#include "bytecode.h"
+#include "cse.h"
+#include "var_table.h"
+#include "cow_ref.h"
+
+namespace evaluator_internal
+{
+
+// Parsed expression and everything which is built from it, but not values of variables,
+// so copies of evaluator share it by cow_ref
+template<typename T> struct program
+{
+    program()
+        : calc_stack_size(0), calc_stack_end(0), cse(false), cse_temps(0), cse_removed(0), refs(1)
+    {}
+
+    // Expression, Reverse Polish notation
+    std::vector<evaluator_object<T> > expression;
+    // Interned names of objects of expression
+    name_table names;
+    // Values of constants of expression: [constant index]->value
+    std::vector<T> const_values;
+    // Maximum depth of evaluation stack of interpreter
+    std::size_t calc_stack_size;
+    // Depth of evaluation stack after evaluation, 1 for correct expression
+    std::size_t calc_stack_end;
+    // Bytecode of interpreter, handlers are linked by calc_init()
+    std::vector<bc_instr<T> > bytecode;
+    // Bitmask of variables of expression, see var_table
+    std::vector<typename var_table<T>::mask_word> vars_mask;
+    // Common subexpressions are evaluated once, set by simplify()
+    bool cse;
+    // Actions for objects of expression, empty if there are no common subexpressions
+    std::vector<cse_action> cse_plan;
+    // Number of values of common subexpressions
+    std::size_t cse_temps;
+    // Number of objects which are not evaluated because of common subexpressions
+    std::size_t cse_removed;
+    // Number of cow_ref which share this program, changed under LOCK_REFS
+    std::size_t refs;
+
+    // Empty program of unparsed evaluator
+    static const program & shared()
+    {
+        static const program instance;
+        return instance;
+    }
+};
+
+} // namespace evaluator_internal
+
+#endif // EVALUATOR_PROGRAM_H
@@ -0,0 +1,59 @@
+#if !defined(EVALUATOR_REGISTRY_H)
+#define EVALUATOR_REGISTRY_H
+
+#include <map>
+#include <string>
+#include <utility>
+#include <cstddef>
+#include "flat_table.h"
+#include "cow_ref.h"
+#include "../evaluator_operations.h"
+
+namespace evaluator_internal
+{
+
+// Builtin functions, operators and constants of type T, one immutable instance per type
+// is shared by all evaluators, so construction of evaluator doesn't fill containers,
+// evaluator with customized builtins has own copy, see cow_ref
+template<typename T> struct registry
+{
+    // Table: [function name]->function pointer
+    flat_table<T(*)(const T &)> functions;
+    // Container: [operator name]->pair(priority, operator pointer)
+    std::map<char, std::pair<unsigned short int, T(*)(const T &, const T &)> > operators;
+    // Table: [constant name]->constant value
+    flat_table<T> constants;
+    // Number of cow_ref which share this registry, changed under LOCK_REFS
+    std::size_t refs;
+
+    registry()
+        : refs(1)
+    {
+        init_functions(functions);
+        init_operators(operators);
+        init_constants(constants);
+    }
+
+    // Shared instance of builtins, created on first use and never destroyed, so it may be used
+    // by static evaluators. It is created once under lock, published after memory barrier
+    // and then read without lock, the pointer is zero-initialized before any code runs
+    static const registry & shared()
+    {
+        static const registry * volatile instance = NULL;
+        if(!instance)
+        {
+            scoped_lock lock(LOCK_REGISTRY);
+            if(!instance)
+            {
+                const registry * created = new registry;
+                memory_barrier();
+                instance = created;
+            }
+        }
+        return * instance;
+    }
+};
+
+} // namespace evaluator_internal
+
+#endif // EVALUATOR_REGISTRY_H
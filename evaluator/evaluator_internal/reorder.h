@@ -0,0 +1,130 @@
+#if !defined(EVALUATOR_REORDER_H)
+#define EVALUATOR_REORDER_H
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <algorithm>
+#include <sstream>
+#include "../evaluator.h"
+
+// Get maximum depth of evaluation stack for current expression
+template<typename T>
+std::size_t evaluator<T>::stack_depth() const
+{
+    using namespace evaluator_internal;
+
+    std::size_t depth = 0, max_depth = 0;
+    for(typename std::vector<evaluator_object<T> >::const_iterator
+        it = m_program->expression.begin(), it_end = m_program->expression.end(); it != it_end; ++it)
+    {
+        if(it->is_constant() || it->is_variable())
+            max_depth = std::max(max_depth, ++depth);
+        else if(it->is_operator())
+            depth--;
+    }
+    return max_depth;
+}
+
+// Reorder operands of commutative operators to minimize depth of evaluation stack
+template<typename T>
+bool evaluator<T>::minimize_stack()
+{
+    using namespace evaluator_internal;
+
+    if(!is_parsed())
+    {
+        m_error_string = "Not parsed!";
+        return false;
+    }
+
+    // Subtree of i-th object is [begin[i], i], its stack depth is need[i]
+    program<T> & prog = m_program.write();
+    const std::size_t size = prog.expression.size();
+    std::vector<std::size_t> begin(size), need(size), st;
+    for(std::size_t i = 0; i < size; i++)
+    {
+        const evaluator_object<T> & obj = prog.expression[i];
+        if(obj.is_operator())
+        {
+            const std::size_t right = st.back();
+            st.pop_back();
+            const std::size_t left = st.back();
+            st.pop_back();
+            begin[i] = begin[left];
+            // Operand with deeper subtree is evaluated first, while nothing is on the stack
+            if(obj_str(obj) == "+" || obj_str(obj) == "*")
+                need[i] = std::max(std::max(need[left], need[right]), std::min(need[left], need[right]) + 1);
+            else
+                need[i] = std::max(need[left], need[right] + 1);
+        }
+        else if(obj.is_function())
+        {
+            const std::size_t arg = st.back();
+            st.pop_back();
+            begin[i] = begin[arg];
+            need[i] = need[arg];
+        }
+        else
+        {
+            begin[i] = i;
+            need[i] = 1;
+        }
+        st.push_back(i);
+    }
+
+    if(st.size() != 1)
+    {
+        std::stringstream sst;
+        sst << "Stack size equal " << st.size();
+        m_error_string = sst.str();
+        return false;
+    }
+
+    // Emit subtrees from the root, pair(i, true) emits i-th object itself,
+    // pair(i, false) emits its operands first
+    std::vector<evaluator_object<T> > expression;
+    expression.reserve(size);
+    std::vector<std::pair<std::size_t, bool> > todo;
+    todo.push_back(std::make_pair(size - 1, false));
+    while(!todo.empty())
+    {
+        const std::size_t i = todo.back().first;
+        const bool ready = todo.back().second;
+        todo.pop_back();
+        const evaluator_object<T> & obj = prog.expression[i];
+        if(ready || obj.is_constant() || obj.is_variable())
+        {
+            expression.push_back(obj);
+        }
+        else if(obj.is_function())
+        {
+            todo.push_back(std::make_pair(i, true));
+            todo.push_back(std::make_pair(i - 1, false));
+        }
+        else
+        {
+            const std::size_t right = i - 1;
+            const std::size_t left = begin[right] - 1;
+            todo.push_back(std::make_pair(i, true));
+            // Stack of todo is reversed, so the first operand is pushed last
+            if((obj_str(obj) == "+" || obj_str(obj) == "*") && need[right] > need[left])
+            {
+                todo.push_back(std::make_pair(left, false));
+                todo.push_back(std::make_pair(right, false));
+            }
+            else
+            {
+                todo.push_back(std::make_pair(right, false));
+                todo.push_back(std::make_pair(left, false));
+            }
+        }
+    }
+
+    prog.expression.swap(expression);
+    m_is_compiled = false;
+    calc_init();
+    return true;
+}
+
+#endif // EVALUATOR_REORDER_H
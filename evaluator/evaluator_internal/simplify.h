@@ -1,12 +1,118 @@
 #if !defined(EVALUATOR_SIMPLIFY_H)
 #define EVALUATOR_SIMPLIFY_H
 
-#include <deque>
 #include <sstream>
 #include <vector>
 #include <string>
+#include <map>
+#include <cmath>
+#include <complex>
+#include <limits>
+#include "type_detection.h"
 #include "../evaluator.h"
 
+namespace evaluator_internal
+{
+
+// Significant digits which distinguish all values of type T, max_digits10 of C++11
+template<typename T>
+int canonical_digits(const T &)
+{
+    return 2 + std::numeric_limits<T>::digits * 30103 / 100000;
+}
+
+template<typename T>
+int canonical_digits(const std::complex<T> &)
+{
+    return canonical_digits(T());
+}
+
+// Text of number in canonical form, constants made by simplify() are named so,
+// different values have different texts
+template<typename T>
+std::string canonical_number(const T & value)
+{
+    std::stringstream sst;
+    sst.precision(canonical_digits(value) - 1);
+    sst.setf(std::ios::scientific);
+    sst << value;
+    return sst.str();
+}
+
+// Order of values of constants: -1, 0 or 1, zeros of different signs differ, all NaNs are equal
+template<typename T>
+int number_compare(const T & a, const T & b)
+{
+    const bool a_nan = (a != a), b_nan = (b != b);
+    if(a_nan || b_nan)
+        return static_cast<int>(a_nan) - static_cast<int>(b_nan);
+    if(a < b)
+        return -1;
+    if(b < a)
+        return 1;
+    if(!is_floating<T>() || a != static_cast<T>(0))
+        return 0;
+    const bool a_neg = (static_cast<T>(1) / a < static_cast<T>(0));
+    const bool b_neg = (static_cast<T>(1) / b < static_cast<T>(0));
+    return static_cast<int>(b_neg) - static_cast<int>(a_neg);
+}
+
+template<typename T>
+int number_compare(const std::complex<T> & a, const std::complex<T> & b)
+{
+    const int re = number_compare(a.real(), b.real());
+    return re != 0 ? re : number_compare(a.imag(), b.imag());
+}
+
+// Comparator of values of constants for std::map, see number_compare()
+template<typename T> struct number_less
+{
+    bool operator () (const T & a, const T & b) const
+    {
+        return number_compare(a, b) < 0;
+    }
+};
+
+// Number is a power of two, so division by it is exact, complex number must be real
+template<typename T>
+bool is_power_of_two(const T & value)
+{
+    int exp;
+    return std::abs(std::frexp(value, & exp)) == static_cast<T>(0.5);
+}
+
+template<typename T>
+bool is_power_of_two(const std::complex<T> & value)
+{
+    return value.imag() == static_cast<T>(0) && is_power_of_two(value.real());
+}
+
+// Append 'base' to the power 'n' >= 1 to RPN expression 'dq' as product of copies of 'base', by squaring,
+// so equal halves of product are common subexpressions and are evaluated once, see cse_init()
+template<typename T>
+void append_power(std::vector<evaluator_object<T> > & dq, const std::vector<evaluator_object<T> > & base,
+                  unsigned int n, const evaluator_object<T> & mult)
+{
+    if(n == 1)
+    {
+        dq.insert(dq.end(), base.begin(), base.end());
+        return;
+    }
+    if(n % 2 == 0)
+    {
+        append_power(dq, base, n / 2, mult);
+        append_power(dq, base, n / 2, mult);
+    }
+    else
+    {
+        append_power(dq, base, n - 1, mult);
+        dq.insert(dq.end(), base.begin(), base.end());
+    }
+    dq.push_back(mult);
+}
+
+} // namespace evaluator_internal
+
 // Simplify current expression
 template<typename T>
 bool evaluator<T>::simplify()
@@ -19,14 +125,18 @@ bool evaluator<T>::simplify()
         return false;
     }
 
+    m_is_compiled = false;
+    program<T> & prog = m_program.write();
     bool was_changed;
     do
     {
-        std::deque<evaluator_object<T> > dq;
+        // Objects are small, so output is built in vector and swapped with expression
+        std::vector<evaluator_object<T> > dq;
+        dq.reserve(prog.expression.size());
         was_changed = false;
 
         for(typename std::vector<evaluator_object<T> >::iterator
-            it = m_expression.begin(), it_end = m_expression.end(); it != it_end; ++it)
+            it = prog.expression.begin(), it_end = prog.expression.end(); it != it_end; ++it)
         {
             if(it->is_operator())
             {
@@ -38,15 +148,10 @@ bool evaluator<T>::simplify()
                     if(arg1.is_constant())
                     {
                         dq.pop_back();
-                        const T varg1 = arg1.eval();
-                        const T varg2 = arg2.eval();
+                        const T varg1 = obj_eval(arg1);
+                        const T varg2 = obj_eval(arg2);
                         const T val = it->eval(varg1, varg2);
-                        std::stringstream sst;
-                        sst.precision(17);
-                        sst.setf(std::ios::scientific);
-                        sst << val;
-                        const std::string sst_st = sst.str();
-                        dq.push_back(evaluator_object<T>(sst_st, val));
+                        dq.push_back(make_constant(prog, canonical_number(val), val));
                     }
                     else
                     {
@@ -65,14 +170,9 @@ bool evaluator<T>::simplify()
                 if(arg.is_constant())
                 {
                     dq.pop_back();
-                    const T varg = arg.eval();
+                    const T varg = obj_eval(arg);
                     const T val = it->eval(varg);
-                    std::stringstream sst;
-                    sst.precision(17);
-                    sst.setf(std::ios::scientific);
-                    sst << val;
-                    const std::string sst_st = sst.str();
-                    dq.push_back(evaluator_object<T>(sst_st, val));
+                    dq.push_back(make_constant(prog, canonical_number(val), val));
                 }
                 else
                 {
@@ -85,24 +185,15 @@ bool evaluator<T>::simplify()
             }
         }
 
-        if(m_expression.size() > dq.size())
+        if(prog.expression.size() > dq.size())
         {
-            m_expression.clear();
-            m_expression.reserve(dq.size());
-            while(!dq.empty())
-            {
-                m_expression.push_back(dq.front());
-                dq.pop_front();
-            }
+            prog.expression.swap(dq);
             was_changed = true;
         }
-        else
-        {
-            dq.clear();
-        }
+        dq.clear();
 
         for(typename std::vector<evaluator_object<T> >::iterator
-            it = m_expression.begin(), it_end = m_expression.end(); it != it_end; ++it)
+            it = prog.expression.begin(), it_end = prog.expression.end(); it != it_end; ++it)
         {
             if(it->is_operator())
             {
@@ -110,40 +201,40 @@ bool evaluator<T>::simplify()
                 dq.pop_back();
                 const evaluator_object<T> arg1 = dq.back();
                 // Such things as a*0 or 0*a
-                if(it->str() == "*" && ((arg2.is_constant() && arg2.eval() == static_cast<T>(0)) ||
-                                        (arg1.is_constant() && arg1.eval() == static_cast<T>(0) &&
+                if(obj_str(*it) == "*" && ((arg2.is_constant() && obj_eval(arg2) == static_cast<T>(0)) ||
+                                        (arg1.is_constant() && obj_eval(arg1) == static_cast<T>(0) &&
                                          !arg2.is_operator() && !arg2.is_function())))
                 {
                     dq.pop_back();
-                    if(arg2.is_constant() && arg2.eval() == static_cast<T>(0))
+                    if(arg2.is_constant() && obj_eval(arg2) == static_cast<T>(0))
                         dq.push_back(arg2);
                     else
                         dq.push_back(arg1);
                 }
                 // Such things as a*1 or 1*a
-                else if(it->str() == "*" && ((arg2.is_constant() && arg2.eval() == static_cast<T>(1)) ||
-                                             (arg1.is_constant() && arg1.eval() == static_cast<T>(1) &&
+                else if(obj_str(*it) == "*" && ((arg2.is_constant() && obj_eval(arg2) == static_cast<T>(1)) ||
+                                             (arg1.is_constant() && obj_eval(arg1) == static_cast<T>(1) &&
                                               !arg2.is_operator() && !arg2.is_function())))
                 {
                     dq.pop_back();
-                    if(arg2.is_constant() && arg2.eval() == static_cast<T>(1))
+                    if(arg2.is_constant() && obj_eval(arg2) == static_cast<T>(1))
                         dq.push_back(arg1);
                     else
                         dq.push_back(arg2);
                 }
                 // Such things as a+0 or 0+a
-                else if(it->str() == "+" && ((arg2.is_constant() && arg2.eval() == static_cast<T>(0)) ||
-                                             (arg1.is_constant() && arg1.eval() == static_cast<T>(0) &&
+                else if(obj_str(*it) == "+" && ((arg2.is_constant() && obj_eval(arg2) == static_cast<T>(0)) ||
+                                             (arg1.is_constant() && obj_eval(arg1) == static_cast<T>(0) &&
                                               !arg2.is_operator() && !arg2.is_function())))
                 {
                     dq.pop_back();
-                    if(arg2.is_constant() && arg2.eval() == static_cast<T>(0))
+                    if(arg2.is_constant() && obj_eval(arg2) == static_cast<T>(0))
                         dq.push_back(arg1);
                     else
                         dq.push_back(arg2);
                 }
                 // Such things as a-0
-                else if(it->str() == "-" && arg2.is_constant() && arg2.eval() == static_cast<T>(0))
+                else if(obj_str(*it) == "-" && arg2.is_constant() && obj_eval(arg2) == static_cast<T>(0))
                 {
                     dq.pop_back();
                     dq.push_back(arg1);
@@ -161,24 +252,192 @@ bool evaluator<T>::simplify()
             }
         }
 
-        if(m_expression.size() > dq.size())
+        if(prog.expression.size() > dq.size())
+        {
+            prog.expression.swap(dq);
+            was_changed = true;
+        }
+        dq.clear();
+    }
+    while(was_changed);
+    reduce_strength();
+    prog.cse = true;
+    calc_init();
+    return true;
+}
+
+// Strength reduction: x^n for small integer n becomes multiplications, complex x^0.5 becomes sqrt(x),
+// x^-1 becomes 1/x, x/c becomes x*(1/c) if it is exact
+template<typename T>
+void evaluator<T>::reduce_strength()
+{
+    using namespace evaluator_internal;
+
+    // Power is expanded if product has at most 'max_objects' objects of copies of base
+    const int max_power = 16;
+    const std::size_t max_objects = 64;
+    program<T> & prog = m_program.write();
+    const evaluator_object<T> mult = make_operator(prog, "*", m_registry->operators.find('*')->second.second);
+    const evaluator_object<T> div = make_operator(prog, "/", m_registry->operators.find('/')->second.second);
+
+    // Output is built in vector, begins are beginnings of subtrees of values of evaluation stack in it
+    std::vector<evaluator_object<T> > dq;
+    std::vector<std::size_t> begins;
+    dq.reserve(prog.expression.size());
+    for(typename std::vector<evaluator_object<T> >::const_iterator
+        it = prog.expression.begin(), it_end = prog.expression.end(); it != it_end; ++it)
+    {
+        if(it->is_operator() && begins.size() >= 2 && dq.back().is_constant())
         {
-            m_expression.clear();
-            m_expression.reserve(dq.size());
-            while(!dq.empty())
+            const T c = obj_eval(dq.back());
+            const std::size_t base_begin = begins[begins.size() - 2];
+            const std::size_t base_size = dq.size() - 1 - base_begin;
+            // Integer exponent, except 0, max_power + 1 if there is no such one
+            int n = -max_power;
+            while(n <= max_power && (n == 0 || c != static_cast<T>(n)))
+                n++;
+            const unsigned int n_abs = static_cast<unsigned int>(n < 0 ? -n : n);
+            if(obj_str(*it) == "/" && is_power_of_two(c) && is_power_of_two(static_cast<T>(1) / c))
             {
-                m_expression.push_back(dq.front());
-                dq.pop_front();
+                const T r = static_cast<T>(1) / c;
+                dq.back() = make_constant(prog, canonical_number(r), r);
+                dq.push_back(mult);
+                begins.pop_back();
+                continue;
+            }
+            if(obj_str(*it) == "^" && n <= max_power && n_abs * base_size <= max_objects)
+            {
+                const std::vector<evaluator_object<T> > base(dq.begin() + base_begin, dq.end() - 1);
+                dq.erase(dq.begin() + base_begin, dq.end());
+                if(n < 0)
+                    dq.push_back(make_constant(prog, canonical_number(static_cast<T>(1)), static_cast<T>(1)));
+                append_power(dq, base, n_abs, mult);
+                if(n < 0)
+                    dq.push_back(div);
+                begins.pop_back();
+                continue;
+            }
+            // Real pow() and sqrt() differ for -0 and -inf, complex ones agree, so only complex x^0.5 is reduced
+            if(obj_str(*it) == "^" && c == static_cast<T>(0.5) && is_complex<T>())
+            {
+                dq.back() = make_function(prog, "sqrt", m_registry->functions.find("sqrt")->value);
+                begins.pop_back();
+                continue;
             }
-            was_changed = true;
+        }
+        if(it->is_operator() && begins.size() >= 2)
+            begins.pop_back();
+        else if(!it->is_operator() && !it->is_function())
+            begins.push_back(dq.size());
+        dq.push_back(*it);
+    }
+    prog.expression.swap(dq);
+}
+
+// Find common subexpressions of current expression and make its plan: equal subtrees have the same
+// node of expression DAG, the first one stores its value, outermost of the others load it
+template<typename T>
+void evaluator<T>::cse_init()
+{
+    using namespace evaluator_internal;
+
+    program<T> & prog = m_program.write();
+    prog.cse_plan.clear();
+    prog.cse_temps = 0;
+    prog.cse_removed = 0;
+    m_cse_values.clear();
+    if(!prog.cse)
+        return;
+
+    // Hash-consing: node[i] is node of i-th object, first[n] is the first object of node n,
+    // subtree of i-th object is [begin[i], i], operands of "+" and "*" are sorted,
+    // constants are keyed by value, as names of close constants may be the same
+    const std::size_t size = prog.expression.size(), none = static_cast<std::size_t>(-1);
+    std::map<cse_node, std::size_t> nodes;
+    std::map<T, std::size_t, number_less<T> > consts;
+    std::vector<std::size_t> node(size), begin(size), first, st;
+    for(std::size_t i = 0; i < size; i++)
+    {
+        const evaluator_object<T> & obj = prog.expression[i];
+        cse_node key;
+        key.left = key.right = none;
+        begin[i] = i;
+        if(obj.is_operator())
+        {
+            if(st.size() < 2)
+                return;
+            key.type = 3;
+            key.id = obj.name();
+            key.right = node[st.back()];
+            st.pop_back();
+            key.left = node[st.back()];
+            begin[i] = begin[st.back()];
+            st.pop_back();
+            if((obj_str(obj) == "+" || obj_str(obj) == "*") && key.left > key.right)
+                std::swap(key.left, key.right);
+        }
+        else if(obj.is_function())
+        {
+            if(st.empty())
+                return;
+            key.type = 2;
+            key.id = obj.name();
+            key.left = node[st.back()];
+            begin[i] = begin[st.back()];
+            st.pop_back();
         }
         else
         {
-            dq.clear();
+            key.type = obj.is_variable() ? 1 : 0;
+            if(obj.is_variable())
+                key.id = obj.index();
+            else
+                key.id = consts.insert(std::make_pair(prog.const_values[obj.index()], consts.size())).first->second;
         }
+        std::map<cse_node, std::size_t>::const_iterator it = nodes.find(key);
+        if(it == nodes.end())
+        {
+            it = nodes.insert(std::make_pair(key, first.size())).first;
+            first.push_back(i);
+        }
+        node[i] = it->second;
+        st.push_back(i);
     }
-    while(was_changed);
-    return true;
+    if(st.size() != 1)
+        return;
+
+    // Repeated subtrees are loaded, from the root, so inner ones of loaded subtrees are skipped,
+    // constants and variables are loaded by themselves
+    std::vector<cse_action> plan(size);
+    std::vector<std::size_t> temps(first.size(), none);
+    for(std::size_t i = size; i-- > 0;)
+    {
+        if(begin[i] == i || first[node[i]] == i)
+            continue;
+        plan[begin[i]].kind = CSE_LOAD;
+        plan[begin[i]].end = i;
+        temps[node[i]] = 0;
+        prog.cse_removed += i - begin[i];
+        i = begin[i];
+    }
+    if(prog.cse_removed == 0)
+        return;
+
+    // Temporaries are numbered in order of evaluation
+    std::size_t temps_num = 0;
+    for(std::size_t i = 0; i < size; i++)
+    {
+        if(first[node[i]] == i && temps[node[i]] != none)
+        {
+            plan[i].kind = CSE_STORE;
+            plan[i].temp = temps[node[i]] = temps_num++;
+        }
+        else if(plan[i].kind == CSE_LOAD)
+            plan[i].temp = temps[node[plan[i].end]];
+    }
+    prog.cse_plan.swap(plan);
+    prog.cse_temps = temps_num;
+    m_cse_values.resize(temps_num);
 }
 
 #endif // EVALUATOR_SIMPLIFY_H
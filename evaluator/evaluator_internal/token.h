@@ -0,0 +1,206 @@
+#if !defined(EVALUATOR_TOKEN_H)
+#define EVALUATOR_TOKEN_H
+
+#include <string>
+#include <sstream>
+#include <locale>
+#include <complex>
+#include <cstddef>
+
+namespace evaluator_internal
+{
+
+// Kinds of tokens
+enum token_kind
+{
+    TOKEN_NUMBER,   // number
+    TOKEN_CONST,    // named constant
+    TOKEN_FUNC,     // function
+    TOKEN_VAR,      // variable
+    TOKEN_OPER,     // operator
+    TOKEN_BR_OPEN,  // "("
+    TOKEN_BR_CLOSE, // ")"
+    TOKEN_UNKNOWN   // malformed number, matches nothing
+};
+
+// Token of expression: span of source string, without copy of its text
+template<typename T> struct token
+{
+    token_kind kind;
+    // Position and length in source string
+    std::size_t offset;
+    std::size_t length;
+    // Value of number or named constant
+    T value;
+    // Lowercase name of function or named constant, key of its container
+    const std::string * name;
+    // Function pointer for TOKEN_FUNC
+    T(* func)(const T &);
+    // Character of operator or bracket
+    char symbol;
+    // Mask of terminals of state transition table which the token matches
+    unsigned int terminals;
+};
+
+// Value of number 's' by stream with classic locale, so decimal point doesn't depend on locale
+template<typename U>
+bool parse_number_stream(const char * s, U & value)
+{
+    std::istringstream sst(s);
+    sst.imbue(std::locale::classic());
+    return (sst >> value) && sst.peek() == std::char_traits<char>::eof();
+}
+
+// Value of number 's' in normalized notation, see token_text(), false if 's' is not a number.
+// Up to 15 significant digits and power of ten up to 22 are exact doubles, so their product
+// or quotient is correctly rounded, other numbers are converted by parse_number_stream()
+inline bool parse_number(const char * s, double & value)
+{
+    static const double pow10[] =
+    {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const int max_digits = 15, max_pow10 = 22;
+    double mantissa = 0.0;
+    int digits = 0, scale = 0, exponent = 0;
+    bool has_digits = false;
+    const char * p = s;
+    for(; * p >= '0' && * p <= '9'; ++p)
+    {
+        has_digits = true;
+        if(digits > 0 || * p != '0')
+        {
+            if(digits++ < max_digits)
+                mantissa = mantissa * 10.0 + (* p - '0');
+            else
+                scale++;
+        }
+    }
+    if(* p == '.')
+    {
+        for(++p; * p >= '0' && * p <= '9'; ++p)
+        {
+            has_digits = true;
+            if(digits > 0 || * p != '0')
+            {
+                if(digits++ < max_digits)
+                {
+                    mantissa = mantissa * 10.0 + (* p - '0');
+                    scale--;
+                }
+            }
+            else
+                scale--;
+        }
+    }
+    if(!has_digits)
+        return false;
+    if(* p == 'e')
+    {
+        const bool negative = (* ++p == '-');
+        if(* p == '-' || * p == '+')
+            ++p;
+        if(* p < '0' || * p > '9')
+            return false;
+        for(; * p >= '0' && * p <= '9'; ++p)
+            if(exponent < 100000)
+                exponent = exponent * 10 + (* p - '0');
+        if(negative)
+            exponent = -exponent;
+    }
+    if(* p != '\0')
+        return false;
+    if(mantissa == 0.0)
+    {
+        value = 0.0;
+        return true;
+    }
+    scale += exponent;
+    if(digits > max_digits || scale < -max_pow10 || scale > max_pow10)
+        return parse_number_stream(s, value);
+    value = (scale < 0) ? mantissa / pow10[-scale] : mantissa * pow10[scale];
+    return true;
+}
+
+inline bool parse_number(const char * s, float & value)
+{
+    double real;
+    const bool status = parse_number(s, real);
+    value = static_cast<float>(real);
+    return status;
+}
+
+template<typename U>
+bool parse_number(const char * s, std::complex<U> & value)
+{
+    U real;
+    const bool status = parse_number(s, real);
+    value = std::complex<U>(real, static_cast<U>(0));
+    return status;
+}
+
+template<typename U>
+bool parse_number(const char * s, U & value)
+{
+    return parse_number_stream(s, value);
+}
+
+// Number with unary minus, the same as parsed text with "-", imaginary part of complex number is kept
+template<typename U>
+void negate_number(U & value)
+{
+    value = -value;
+}
+
+template<typename U>
+void negate_number(std::complex<U> & value)
+{
+    value = std::complex<U>(-value.real(), value.imag());
+}
+
+// Normalized text of number at position 'pos' of 'str': "," is replaced by "." and exponent by "e",
+// 'pos' is moved to the end of number
+inline void number_text(const std::string & str, std::size_t & pos, std::string & text)
+{
+    const std::size_t len = str.size();
+    text.clear();
+    while(pos < len && str[pos] >= '0' && str[pos] <= '9')
+        text.push_back(str[pos++]);
+    if(pos < len && (str[pos] == '.' || str[pos] == ','))
+    {
+        text.push_back('.');
+        while(++pos < len && str[pos] >= '0' && str[pos] <= '9')
+            text.push_back(str[pos]);
+    }
+    if(pos < len && (str[pos] == 'e' || str[pos] == 'E' || str[pos] == 'd' || str[pos] == 'D'))
+    {
+        text.push_back('e');
+        if(++pos < len && (str[pos] == '-' || str[pos] == '+'))
+            text.push_back(str[pos++]);
+        while(pos < len && str[pos] >= '0' && str[pos] <= '9')
+            text.push_back(str[pos++]);
+    }
+}
+
+// Text of token 'tok' of source string 'str', numbers are normalized
+template<typename T>
+std::string token_text(const std::string & str, const token<T> & tok)
+{
+    if(tok.name)
+        return * tok.name;
+    if(tok.kind == TOKEN_NUMBER || tok.kind == TOKEN_UNKNOWN)
+    {
+        std::string text;
+        std::size_t pos = tok.offset;
+        number_text(str, pos, text);
+        return text;
+    }
+    if(tok.symbol)
+        return std::string(1, tok.symbol);
+    return str.substr(tok.offset, tok.length);
+}
+
+} // namespace evaluator_internal
+
+#endif // EVALUATOR_TOKEN_H
@@ -3,23 +3,49 @@
 namespace evaluator_internal
 {
 
-void transition_table_record::set_values(const std::string & T, int J, bool A, bool S, bool R, bool E)
+namespace
 {
-    Jump = J;
-    Accept = A;
-    Stack = S;
-    Return = R;
-    Error = E;
 
-    std::size_t beg = 0, end = T.find_first_of(" \t\r\n");
-    while(end != std::string::npos)
-    {
-        Terminals.push_back(T.substr(beg, end - beg));
-        beg = end + 1;
-        end = T.find_first_of(" \t\r\n", beg);
-    }
-    Terminals.push_back(T.substr(beg));
+// Terminals which begin expression
+const unsigned int TERM_EXPR = TERM_FUNC | TERM_VAR | TERM_CONST | TERM_SIGN | TERM_BR_OPEN;
+// Terminals which begin expression without sign
+const unsigned int TERM_E1 = TERM_FUNC | TERM_VAR | TERM_CONST | TERM_BR_OPEN;
+
 }
 
+const transition_table_record transition_table[] =
+{
+    //   Terminals              Jump  Accept Stack  Return Error
+    { TERM_EXPR,                  1,  false, false, false, true  }, // 00
+    { TERM_EXPR,                  2,  false, false, false, true  }, // 01
+    { TERM_SIGN,                  4,  false, false, false, false }, // 02
+    { TERM_E1,                    6,  false, false, false, true  }, // 03
+    { TERM_SIGN,                  5,  true,  false, false, true  }, // 04
+    { TERM_E1,                    7,  false, false, false, true  }, // 05
+    { TERM_E1,                    7,  false, false, false, true  }, // 06
+    { TERM_VAR,                  11,  false, false, false, false }, // 07
+    { TERM_CONST,                13,  false, false, false, false }, // 08
+    { TERM_BR_OPEN,              15,  false, false, false, false }, // 09
+    { TERM_FUNC,                 19,  false, false, false, true  }, // 10
+    { TERM_VAR,                  12,  true,  false, false, true  }, // 11
+    { TERM_OPER | TERM_EPS,      24,  false, false, false, true  }, // 12
+    { TERM_CONST,                14,  true,  false, false, true  }, // 13
+    { TERM_OPER | TERM_EPS,      24,  false, false, false, true  }, // 14
+    { TERM_BR_OPEN,              16,  true,  false, false, true  }, // 15
+    { TERM_EXPR,                  2,  false, true,  false, true  }, // 16
+    { TERM_BR_CLOSE,             18,  true,  false, false, true  }, // 17
+    { TERM_OPER | TERM_EPS,      24,  false, false, false, true  }, // 18
+    { TERM_FUNC,                 20,  true,  false, false, true  }, // 19
+    { TERM_BR_OPEN,              21,  true,  false, false, true  }, // 20
+    { TERM_EXPR,                  2,  false, true,  false, true  }, // 21
+    { TERM_BR_CLOSE,             23,  true,  false, false, true  }, // 22
+    { TERM_OPER | TERM_EPS,      24,  false, false, false, true  }, // 23
+    { TERM_OPER,                 27,  false, false, false, false }, // 24
+    { TERM_EPS,                  26,  false, false, false, true  }, // 25
+    { TERM_EPS,                  -1,  false, false, true,  true  }, // 26
+    { TERM_OPER,                 28,  true,  false, false, true  }, // 27
+    { TERM_E1,                    7,  false, false, false, true  }  // 28
+};
+
 }
 
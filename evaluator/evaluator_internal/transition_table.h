@@ -1,25 +1,37 @@
 #if !defined(TRANSITION_TABLE_H)
 #define TRANSITION_TABLE_H
 
-#include <vector>
-#include <string>
-
 namespace evaluator_internal
 {
 
+// Terminals of state transition table, bits of masks
+enum transition_terminal
+{
+    TERM_FUNC     = 1 << 0, // "func"
+    TERM_VAR      = 1 << 1, // "var"
+    TERM_CONST    = 1 << 2, // "const"
+    TERM_SIGN     = 1 << 3, // "sign"
+    TERM_OPER     = 1 << 4, // "oper"
+    TERM_BR_OPEN  = 1 << 5, // "("
+    TERM_BR_CLOSE = 1 << 6, // ")"
+    TERM_EPS      = 1 << 7  // "eps"
+};
+
 // State transition table record
 struct transition_table_record
 {
-    std::vector<std::string> Terminals;
+    // Mask of terminals, see transition_terminal
+    unsigned int Terminals;
     int Jump;
     bool Accept;
     bool Stack;
     bool Return;
     bool Error;
-    void set_values(const std::string & T, int J, bool A, bool S, bool R, bool E);
 };
 
+// State transition table of parser, see parse.h, initialized statically and shared by all evaluators
+extern const transition_table_record transition_table[];
+
 }
 
 #endif // TRANSITION_TABLE_H
-
@@ -0,0 +1,205 @@
+#if !defined(EVALUATOR_VAR_TABLE_H)
+#define EVALUATOR_VAR_TABLE_H
+
+#include <map>
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <new>
+#include <algorithm>
+
+namespace evaluator_internal
+{
+
+// Values of all variables of evaluator in one contiguous array of slots, slot index is
+// the variable id. Array is aligned by cache line and occupies whole lines, so variables
+// of different evaluators never share a cache line. New variable may move the array.
+// Variables which have values are marked in bitmask, new variable has no value.
+template<typename T> class var_table
+{
+public:
+
+    // Size of cache line
+    static const std::size_t line_size = 64;
+    // Word of bitmask of variables, bit 'i % mask_bits' of word 'i / mask_bits' is variable 'i'
+    typedef unsigned int mask_word;
+    static const std::size_t mask_bits = sizeof(mask_word) * 8;
+
+    // Set bit of variable 'i' in bitmask 'mask'
+    static void mask_set(std::vector<mask_word> & mask, std::size_t i)
+    {
+        if(mask.size() <= i / mask_bits)
+            mask.resize(i / mask_bits + 1, 0);
+        mask[i / mask_bits] |= static_cast<mask_word>(1) << (i % mask_bits);
+    }
+
+    var_table()
+        : m_memory(NULL), m_data(NULL), m_capacity(0)
+    {}
+
+    var_table(const var_table & other)
+        : m_memory(NULL), m_data(NULL), m_capacity(0)
+    {
+        copy_from_other(other);
+    }
+
+    const var_table & operator = (const var_table & other)
+    {
+        if(this != & other)
+            copy_from_other(other);
+        return * this;
+    }
+
+    ~var_table()
+    {
+        release();
+    }
+
+    // Number of variables
+    inline std::size_t size() const
+    {
+        return m_names.size();
+    }
+
+    // Array of values
+    inline T * data()
+    {
+        return m_data;
+    }
+
+    inline const T * data() const
+    {
+        return m_data;
+    }
+
+    // Value of variable with index 'i'
+    inline const T & operator [] (std::size_t i) const
+    {
+        return m_data[i];
+    }
+
+    // Set value 'value' for variable with index 'i'
+    inline void set(std::size_t i, const T & value)
+    {
+        m_data[i] = value;
+        m_defined[i / mask_bits] |= static_cast<mask_word>(1) << (i % mask_bits);
+    }
+
+    // Index of the first variable of bitmask 'mask' which has no value, size() if all have values
+    std::size_t find_undefined(const std::vector<mask_word> & mask) const
+    {
+        for(std::size_t w = 0; w < mask.size(); w++)
+        {
+            const mask_word undefined = mask[w] & ~m_defined[w];
+            if(undefined)
+            {
+                std::size_t i = w * mask_bits;
+                while(!(undefined & (static_cast<mask_word>(1) << (i % mask_bits))))
+                    i++;
+                return i;
+            }
+        }
+        return size();
+    }
+
+    // Name of variable with index 'i'
+    inline const std::string & name(std::size_t i) const
+    {
+        return m_names[i];
+    }
+
+    // Index of variable with name 'name', size() if there is no such variable
+    std::size_t find(const std::string & name) const
+    {
+        std::map<std::string, std::size_t>::const_iterator it = m_index.find(name);
+        return it == m_index.end() ? size() : it->second;
+    }
+
+    // Index of variable with name 'name', new variable has no value
+    std::size_t insert(const std::string & name)
+    {
+        std::map<std::string, std::size_t>::const_iterator it = m_index.find(name);
+        if(it != m_index.end())
+            return it->second;
+        const std::size_t i = size();
+        if(i == m_capacity)
+            reserve(i + 1);
+        new(m_data + i) T();
+        if(i % mask_bits == 0)
+            m_defined.push_back(0);
+        m_names.push_back(name);
+        m_index[name] = i;
+        return i;
+    }
+
+    // Remove values of all variables
+    void reset()
+    {
+        for(std::size_t i = 0; i < size(); i++)
+            m_data[i] = T();
+        std::fill(m_defined.begin(), m_defined.end(), 0);
+    }
+
+private:
+
+    // Grow array to at least 'capacity' values, by whole cache lines
+    void reserve(std::size_t capacity)
+    {
+        const std::size_t per_line = sizeof(T) < line_size ? line_size / sizeof(T) : 1;
+        std::size_t new_capacity = m_capacity ? m_capacity : per_line;
+        while(new_capacity < capacity)
+            new_capacity *= 2;
+        char * memory = new char [new_capacity * sizeof(T) + line_size];
+        std::size_t offset = reinterpret_cast<std::size_t>(memory) % line_size;
+        T * data = reinterpret_cast<T *>(memory + (offset ? line_size - offset : 0));
+        for(std::size_t i = 0; i < size(); i++)
+        {
+            new(data + i) T(m_data[i]);
+            m_data[i].~T();
+        }
+        delete [] m_memory;
+        m_memory = memory;
+        m_data = data;
+        m_capacity = new_capacity;
+    }
+
+    void release()
+    {
+        for(std::size_t i = 0; i < size(); i++)
+            m_data[i].~T();
+        delete [] m_memory;
+        m_memory = NULL;
+        m_data = NULL;
+        m_capacity = 0;
+        m_names.clear();
+        m_index.clear();
+        m_defined.clear();
+    }
+
+    void copy_from_other(const var_table & other)
+    {
+        release();
+        if(other.size())
+            reserve(other.size());
+        for(std::size_t i = 0; i < other.size(); i++)
+            new(m_data + i) T(other.m_data[i]);
+        m_names = other.m_names;
+        m_index = other.m_index;
+        m_defined = other.m_defined;
+    }
+
+    // Allocated memory and aligned array in it
+    char * m_memory;
+    T * m_data;
+    std::size_t m_capacity;
+    // Names of variables by index
+    std::vector<std::string> m_names;
+    // Container: [variable name]->index
+    std::map<std::string, std::size_t> m_index;
+    // Bitmask of variables which have values
+    std::vector<mask_word> m_defined;
+};
+
+} // namespace evaluator_internal
+
+#endif // EVALUATOR_VAR_TABLE_H
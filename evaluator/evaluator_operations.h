@@ -6,7 +6,8 @@
 #include <utility>
 #include <map>
 #include <string>
-#include "evaluator_internal/var_container.h"
+#include "evaluator_internal/var_table.h"
+#include "evaluator_internal/flat_table.h"
 #include "evaluator_internal/type_detection.h"
 
 namespace evaluator_internal
@@ -190,30 +191,30 @@ namespace evaluator_internal
 
     // Add function pointers into container.
     template<typename T>
-    void init_functions(std::map<std::string, T(*)(const T &)> & funcs_map)
-    {
-        funcs_map["imag"]  = eval_imag;
-        funcs_map["real"]  = eval_real;
-        funcs_map["conj"]  = eval_conj;
-        funcs_map["arg"]   = eval_arg;
-        funcs_map["sin"]   = eval_sin;
-        funcs_map["cos"]   = eval_cos;
-        funcs_map["tan"]   = eval_tan;
-        funcs_map["asin"]  = eval_asin;
-        funcs_map["acos"]  = eval_acos;
-        funcs_map["atan"]  = eval_atan;
-        funcs_map["sinh"]  = eval_sinh;
-        funcs_map["cosh"]  = eval_cosh;
-        funcs_map["tanh"]  = eval_tanh;
-        funcs_map["asinh"] = eval_asinh;
-        funcs_map["acosh"] = eval_acosh;
-        funcs_map["atanh"] = eval_atanh;
-        funcs_map["log"]   = eval_log;
-        funcs_map["log2"]  = eval_log2;
-        funcs_map["log10"] = eval_log10;
-        funcs_map["abs"]   = eval_abs;
-        funcs_map["exp"]   = eval_exp;
-        funcs_map["sqrt"]  = eval_sqrt;
+    void init_functions(flat_table<T(*)(const T &)> & funcs_map)
+    {
+        funcs_map.insert("imag",   eval_imag);
+        funcs_map.insert("real",   eval_real);
+        funcs_map.insert("conj",   eval_conj);
+        funcs_map.insert("arg",    eval_arg);
+        funcs_map.insert("sin",    eval_sin);
+        funcs_map.insert("cos",    eval_cos);
+        funcs_map.insert("tan",    eval_tan);
+        funcs_map.insert("asin",   eval_asin);
+        funcs_map.insert("acos",   eval_acos);
+        funcs_map.insert("atan",   eval_atan);
+        funcs_map.insert("sinh",   eval_sinh);
+        funcs_map.insert("cosh",   eval_cosh);
+        funcs_map.insert("tanh",   eval_tanh);
+        funcs_map.insert("asinh",  eval_asinh);
+        funcs_map.insert("acosh",  eval_acosh);
+        funcs_map.insert("atanh",  eval_atanh);
+        funcs_map.insert("log",    eval_log);
+        funcs_map.insert("log2",   eval_log2);
+        funcs_map.insert("log10",  eval_log10);
+        funcs_map.insert("abs",    eval_abs);
+        funcs_map.insert("exp",    eval_exp);
+        funcs_map.insert("sqrt",   eval_sqrt);
     }
 
     // =============================================================================================
@@ -263,18 +264,18 @@ namespace evaluator_internal
 
     // Init default constant values.
     template<typename T>
-    void init_constants(std::map<std::string, T> & consts_map)
+    void init_constants(flat_table<T> & consts_map)
     {
         if(is_floating<T>() || is_floating_complex<T>())
         {
-            consts_map["pi"] = static_cast<T>(4) * eval_atan(static_cast<T>(1));
-            consts_map["e"] = eval_exp(static_cast<T>(1));
+            consts_map.insert("pi",  static_cast<T>(4) * eval_atan(static_cast<T>(1)));
+            consts_map.insert("e",   eval_exp(static_cast<T>(1)));
         }
         if(is_floating_complex<T>())
         {
             T complex_I = eval_sqrt(static_cast<T>(-1));
-            consts_map["i"] = complex_I;
-            consts_map["j"] = complex_I;
+            consts_map.insert("i",   complex_I);
+            consts_map.insert("j",   complex_I);
         }
     }
 
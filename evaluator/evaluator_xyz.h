@@ -48,10 +48,10 @@ public:
         update_cache();
     }
 
-    // Copying from another evaluator
+    // Copying from another evaluator, compiled code is released by evaluator<T>
     const evaluator_xyz & operator = (const evaluator_xyz & other)
     {
-        evaluator<T>::copy_from_other(other);
+        evaluator<T>::operator = (other);
         update_cache();
         return * this;
     }
@@ -59,32 +59,32 @@ public:
     // Set new value 'x' for variable with name 'x'
     void set_x(const T & x)
     {
-        * m_x = x;
+        evaluator<T>::set(m_x, x);
     }
 
     // Set new value 'y' for variable with name 'y'
     void set_y(const T & y)
     {
-        * m_y = y;
+        evaluator<T>::set(m_y, y);
     }
 
     // Set new value 'z' for variable with name 'z'
     void set_z(const T & z)
     {
-        * m_z = z;
+        evaluator<T>::set(m_z, z);
     }
 
 private:
 
-    // Cached pointers for x, y and z
-    T * m_x, * m_y, * m_z;
+    // Handles of x, y and z
+    typename evaluator<T>::var_handle m_x, m_y, m_z;
 
-    // Update cached pointers
+    // Get handles, they are the same for copies of evaluator
     void update_cache()
     {
-        m_x = evaluator<T>::m_variables["x"].pointer();
-        m_y = evaluator<T>::m_variables["y"].pointer();
-        m_z = evaluator<T>::m_variables["z"].pointer();
+        m_x = evaluator<T>::get_var_handle("x");
+        m_y = evaluator<T>::get_var_handle("y");
+        m_z = evaluator<T>::get_var_handle("z");
     }
 };
 